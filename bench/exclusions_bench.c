@@ -0,0 +1,63 @@
+//
+// Created by loumouli on 4/30/24.
+//
+
+// Times exclusions_contains against a blocklist the size of the public ones: hundreds of thousands of random CIDR
+// blocks, looked up by random addresses. The generator calls it once per address of a range crossing the list, so it
+// has to stay well above the rate the scan can send at.
+
+#include "ft_nmap.h"
+
+#define BENCH_BLOCKS 300'000
+#define BENCH_LOOKUPS 10'000'000
+#define BENCH_MIN_PREFIX 20
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t xorshift(uint64_t* state) {
+  *state ^= *state << 13;
+  *state ^= *state >> 7;
+  *state ^= *state << 17;
+  return *state;
+}
+
+int main(void) {
+  NMAP_Exclusions* exclusions = exclusions_create();
+  uint32_t* ips = malloc(BENCH_LOOKUPS * sizeof(uint32_t));
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  uint64_t hits = 0;
+
+  if (exclusions == NULL || ips == NULL)
+    return 1;
+  for (uint32_t i = 0; i < BENCH_BLOCKS; ++i) {
+    const uint32_t bits = BENCH_MIN_PREFIX + xorshift(&state) % (33 - BENCH_MIN_PREFIX);
+    const uint32_t mask = bits == 32 ? UINT32_MAX : ~(UINT32_MAX >> bits);
+    const uint32_t first = xorshift(&state) & mask;
+    if (exclusions_add(exclusions, first, first | ~mask))
+      return 1;
+  }
+  const double sealStart = now();
+  if (exclusions_seal(exclusions))
+    return 1;
+  const double sealTime = now() - sealStart;
+  for (uint32_t i = 0; i < BENCH_LOOKUPS; ++i)
+    ips[i] = xorshift(&state);
+
+  const double start = now();
+  for (uint32_t i = 0; i < BENCH_LOOKUPS; ++i)
+    hits += exclusions_contains(exclusions, ips[i]);
+  const double elapsed = now() - start;
+
+  printf("blocks:            %u CIDR, %zu intervals once merged, %.1f%% of the space\n", BENCH_BLOCKS,
+         array_size(exclusions->intervals), exclusions->excluded * 100.0 / (UINT32_MAX + 1.0));
+  printf("seal:              %6.2f ms\n", sealTime * 1e3);
+  printf("lookup:            %6.2f ns/address, %.1fM addresses/s (%lu excluded)\n", elapsed / BENCH_LOOKUPS * 1e9,
+         BENCH_LOOKUPS / elapsed / 1e6, hits);
+  exclusions_destroy(exclusions);
+  free(ips);
+  return 0;
+}
@@ -0,0 +1,118 @@
+//
+// Created by loumouli on 4/19/24.
+//
+
+// Times the two passes ultra_scan runs over the probe state on every loop iteration: the timeout sweep and the
+// completion check. The packed t_port layout the engine used before is rebuilt here so both can be compared on the
+// same state: late in a scan, most ports are done and a few are in flight, none of them timed out yet. The engine
+// only keeps the probes in flight in a slab, so its sweep does not depend on the number of finished ports.
+
+#include "ft_nmap.h"
+
+#define BENCH_HOSTS 256
+#define BENCH_PORTS 1024
+#define BENCH_ROUNDS 200
+#define BENCH_TIMEOUT_US 1'000'000
+
+typedef enum { PROBE_PENDING, PROBE_SENT, PROBE_RECV } LegacyStatus;
+
+typedef struct {
+  uint16_t port;
+  NMAP_PortStatus result;
+  LegacyStatus probeStatus;
+  struct timeval sendTime;
+  struct timeval recvTime;
+  uint32_t nprobes_sent;
+  unused uint8_t _padding[18];
+} __attribute__((packed)) LegacyPort;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static LegacyStatus benchState(const uint32_t port) { return port < BENCH_PORTS * 9 / 10 ? PROBE_RECV : PROBE_SENT; }
+
+static bool ArrayFn_legacyIsLeft(unused const Array* arr, unused size_t i, const void* value, unused void* param) {
+  const LegacyPort* const port = value;
+  return port->probeStatus == PROBE_PENDING || port->probeStatus == PROBE_SENT;
+}
+
+static double benchLegacy(Array** hosts, const struct timeval sent) {
+  const struct timeval tnow = {.tv_sec = sent.tv_sec, .tv_usec = sent.tv_usec + 10};
+  uint64_t expired = 0, left = 0;
+  const double start = now();
+
+  for (uint32_t round = 0; round < BENCH_ROUNDS; ++round) {
+    for (uint32_t i = 0; i < BENCH_HOSTS; ++i) {
+      for (uint64_t j = 0; j < array_size(hosts[i]); ++j) {
+        const LegacyPort* port = array_get(hosts[i], j);
+        if (port->probeStatus == PROBE_SENT && TIMEVAL_SUBTRACT(tnow, port->sendTime) > BENCH_TIMEOUT_US)
+          ++expired;
+      }
+      left += array_anyIf(hosts[i], ArrayFn_legacyIsLeft, NULL);
+    }
+  }
+  const double elapsed = now() - start;
+  if (expired || left != BENCH_ROUNDS * BENCH_HOSTS)
+    fprintf(stderr, "legacy: unexpected result\n");
+  return elapsed;
+}
+
+static double benchSlab(const NMAP_ProbeSlab* slab, const t_host* hosts, const uint64_t sentNs) {
+  const uint64_t nowNs = sentNs + 10'000;
+  uint64_t expired = 0, left = 0;
+  const double start = now();
+
+  for (uint32_t round = 0; round < BENCH_ROUNDS; ++round) {
+    expired += probeSlab_hasExpired(slab, nowNs, BENCH_TIMEOUT_US * 1000ULL);
+    for (uint32_t i = 0; i < BENCH_HOSTS; ++i)
+      left += host_hasPortLeft(hosts + i);
+  }
+  const double elapsed = now() - start;
+  if (expired || left != BENCH_ROUNDS * BENCH_HOSTS)
+    fprintf(stderr, "slab: unexpected result\n");
+  return elapsed;
+}
+
+int main(void) {
+  Array* legacy[BENCH_HOSTS];
+  t_host* hosts = calloc(BENCH_HOSTS, sizeof(t_host));
+  NMAP_ProbeSlab slab;
+  struct timeval sent;
+
+  gettimeofday(&sent, NULL);
+  if (hosts == NULL || probeSlab_init(&slab, BENCH_HOSTS * BENCH_PORTS / 10))
+    return 1;
+  for (uint32_t i = 0; i < BENCH_HOSTS; ++i) {
+    legacy[i] = array(sizeof(LegacyPort), BENCH_PORTS, 0, NULL, NULL);
+    if (legacy[i] == NULL)
+      return 1;
+    hosts[i].results.count = BENCH_PORTS;
+    hosts[i].idx_ports = BENCH_PORTS;
+    hosts[i].portEnd = BENCH_PORTS;
+    for (uint32_t j = 0; j < BENCH_PORTS; ++j) {
+      const LegacyPort port = {.port = j, .probeStatus = benchState(j), .sendTime = sent};
+      array_pushBack(legacy[i], &port, 1);
+      if (benchState(j) != PROBE_SENT)
+        continue;
+      const int64_t slot = probeSlab_insert(&slab, i, j, j);
+      if (slot < 0)
+        return 1;
+      slab.sendNs[slot] = TIMEVAL_TO_MICROSC(sent) * 1000ULL;
+      hosts[i].inSlab += 1;
+    }
+  }
+  const double legacyTime = benchLegacy(legacy, sent);
+  const double slabTime = benchSlab(&slab, hosts, TIMEVAL_TO_MICROSC(sent) * 1000ULL);
+  const double probes = (double)BENCH_ROUNDS * BENCH_HOSTS * BENCH_PORTS;
+  printf("packed t_port:     %6.2f ns/port\n", legacyTime / probes * 1e9);
+  printf("probe slab:        %6.2f ns/port (x%.1f)\n", slabTime / probes * 1e9, legacyTime / slabTime);
+  printf("slab:              %u slots for %u ports\n", slab.capacity, BENCH_HOSTS * BENCH_PORTS);
+  for (uint32_t i = 0; i < BENCH_HOSTS; ++i)
+    array_destroy(legacy[i]);
+  probeSlab_destroy(&slab);
+  free(hosts);
+  return 0;
+}
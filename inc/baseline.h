@@ -0,0 +1,51 @@
+//
+// Created by loumouli on 4/25/24.
+//
+
+#ifndef BASELINE_H
+#define BASELINE_H
+
+#include "ft_nmap.h"
+
+/**
+ * @brief Results of a previous scan, read from its result file, the scan is run and reported against: the ports open
+ * in the baseline are probed first, the ports closed or filtered in it get a smaller retry budget, and every host is
+ * reported with what changed since.
+ * @param {bool} open - true between baseline_open and baseline_close.
+ * @param {NMAP_ResultFile} file - Mapping of the result file.
+ * @param {uint32_t*} position - Result index in the scan of every port number, UINT32_MAX for the ports not scanned.
+ * @param {NMAP_PortMap} scratch - Baseline of the host being reported.
+ */
+typedef struct {
+  bool open;
+  NMAP_ResultFile file;
+  uint32_t* position;
+  NMAP_PortMap scratch;
+} NMAP_Baseline;
+
+/**
+ * @brief map the result file of a previous scan.
+ * @param baseline {NMAP_Baseline*} - Baseline to initialize.
+ * @param path {const char*} - Result file.
+ * @param ports {const Array<uint16_t>*} - Ports of the scan, in result index order.
+ * @return {int64_t} - 0 if success, 1 otherwise (an error is printed, the baseline must still be closed).
+ */
+int64_t baseline_open(NMAP_Baseline* baseline, const char* path, const Array* ports);
+
+/**
+ * @brief unmap and free a baseline.
+ * @param baseline {NMAP_Baseline*} - Baseline (can be zeroed or already closed).
+ */
+void baseline_close(NMAP_Baseline* baseline);
+
+/**
+ * @brief read the results of an address in the baseline (the first host of the address if it was listed twice).
+ * @param baseline {const NMAP_Baseline*} - Baseline.
+ * @param ip {struct in_addr} - Address.
+ * @param map {NMAP_PortMap*} - Set to the status of every port of the scan in the baseline, NMAP_UNKNOWN for the
+ * ports it did not scan (all of them if the address is not in the baseline).
+ * @return {bool} - false if the address is not in the baseline.
+ */
+bool baseline_load(const NMAP_Baseline* baseline, struct in_addr ip, NMAP_PortMap* map);
+
+#endif // BASELINE_H
@@ -0,0 +1,146 @@
+//
+// Created by loumouli on 4/24/24.
+//
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include "ft_nmap.h"
+
+#define CHECKPOINT_MAGIC "NMAPCKP"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_PERIOD_US 1'000'000
+#define CHECKPOINT_POLL_US 50'000
+
+/*
+** A checkpoint file is a header followed by one record per host group scanned to the end, appended in target order.
+** A record is only trusted if its checksum matches: a record torn by a crash is dropped (and overwritten) on resume.
+**
+**   NMAP_CheckpointHeader
+**   NMAP_CheckpointRecord, then per host of the group: struct in_addr ip, uint32_t size, size bytes of runs
+**   ...
+**
+** The runs are encoded like in a result file.
+*/
+
+/**
+ * @brief Header of a checkpoint file, written once when the scan starts.
+ * @param {char[8]} magic - CHECKPOINT_MAGIC.
+ * @param {uint32_t} version - CHECKPOINT_VERSION.
+ * @param {uint32_t} randomize - 1 if the scan walks the targets in a pseudo-random order.
+ * @param {uint64_t} seed - Seed of the order, adopted by a resumed scan given no --seed.
+ * @param {uint64_t} fingerprint - Hash of everything that decides the order of the work (targets, ports, scan
+ * types, order, shard): a scan only resumes from a checkpoint of the same work.
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t randomize;
+  uint64_t seed;
+  uint64_t fingerprint;
+} NMAP_CheckpointHeader;
+
+/**
+ * @brief Header of a record.
+ * @param {uint32_t} size - Size of the hosts following the record header.
+ * @param {uint32_t} checksum - FNV-1a of the fields below and of the hosts.
+ * @param {uint64_t} targets - Targets scanned to the end, this group included: the cursor of the generator.
+ * @param {uint32_t} hosts - Number of hosts of the group.
+ */
+typedef struct {
+  uint32_t size;
+  uint32_t checksum;
+  uint64_t targets;
+  uint32_t hosts;
+  uint32_t _padding;
+} NMAP_CheckpointRecord;
+
+/**
+ * @brief Checkpoint writer. The pool serializes every host group it completes into the active buffer, a background
+ * thread swaps the buffers every CHECKPOINT_PERIOD_US and appends the other one to the file, then syncs it: the
+ * workers never wait for the disk.
+ * @param {bool} open - true between checkpoint_open and checkpoint_close.
+ * @param {int32_t} fd - Checkpoint file, open for appending.
+ * @param {const Array<uint16_t>*} ports - Ports of the scan, in result index order.
+ * @param {uint32_t*} byPort - Result indices of the ports, sorted by port.
+ * @param {uint8_t*} runs - Scratch buffer holding the runs of one host.
+ * @param {pthread_mutex_t} lock - Lock protecting buffers, active and targets.
+ * @param {Array<uint8_t>[2]} buffers - Serialized records: the active one is filled, the other one is written.
+ * @param {uint32_t} active - Index of the active buffer.
+ * @param {uint64_t} targets - Targets scanned to the end so far.
+ * @param {uint64_t} resumed - Targets recovered from the file on resume.
+ * @param {uint64_t} records - Records appended since the scan started.
+ * @param {pthread_t} thread - Writer thread, running between checkpoint_start and checkpoint_close.
+ * @param {bool} running - true between checkpoint_start and checkpoint_close.
+ * @param {_Atomic bool} stop - Set by checkpoint_close, the thread writes what is left and exits.
+ * @param {_Atomic bool} failed - Set when a write failed, nothing more is checkpointed.
+ */
+typedef struct {
+  bool open;
+  int32_t fd;
+  const Array* ports;
+  uint32_t* byPort;
+  uint8_t* runs;
+  pthread_mutex_t lock;
+  Array* buffers[2];
+  uint32_t active;
+  uint64_t targets;
+  uint64_t resumed;
+  uint64_t records;
+  pthread_t thread;
+  bool running;
+  _Atomic bool stop;
+  _Atomic bool failed;
+} NMAP_Checkpoint;
+
+/**
+ * @brief Callback replaying a group recovered from a checkpoint.
+ * @param hosts {const Array<t_host>*} - Hosts of the group, with their results.
+ * @param param {void*} - Parameter given to checkpoint_open.
+ */
+typedef void NMAP_CheckpointReplayFunction(const Array* hosts, void* param);
+
+/**
+ * @brief read the order of the scan saved in a checkpoint file, so that a resumed scan walks the same targets.
+ * @param path {const char*} - Checkpoint file.
+ * @param randomize {bool*} - Set to the randomize option of the checkpointed scan.
+ * @param seed {uint64_t*} - Set to its seed.
+ * @return {int64_t} - 0 if success, -1 if there is no checkpoint yet, 1 otherwise (an error is printed).
+ */
+int64_t checkpoint_readOrder(const char* path, bool* randomize, uint64_t* seed);
+
+/**
+ * @brief open a checkpoint file. A new scan truncates it, a resumed one replays its valid records and skips their
+ * targets in the generator, then drops whatever follows them.
+ * @param checkpoint {NMAP_Checkpoint*} - Checkpoint to initialize.
+ * @param options {const NMAP_Options*} - Global options (checkpoint path, resume, targets, ports).
+ * @param replay {NMAP_CheckpointReplayFunction*} - Called with every group recovered, in order.
+ * @param param {void*} - Parameter of replay.
+ * @return {int64_t} - 0 if success, 1 otherwise (the checkpoint must still be closed).
+ */
+int64_t checkpoint_open(NMAP_Checkpoint* checkpoint, const NMAP_Options* options,
+                        NMAP_CheckpointReplayFunction* replay, void* param);
+
+/**
+ * @brief write what is left, then close and free a checkpoint.
+ * @param checkpoint {NMAP_Checkpoint*} - Checkpoint (can be zeroed or already closed).
+ * @return {int64_t} - 0 if every group added was checkpointed, 1 otherwise.
+ */
+int64_t checkpoint_close(NMAP_Checkpoint* checkpoint);
+
+/**
+ * @brief start the background writer.
+ * @param checkpoint {NMAP_Checkpoint*} - Checkpoint, open.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+int64_t checkpoint_start(NMAP_Checkpoint* checkpoint);
+
+/**
+ * @brief serialize a host group scanned to the end, in target order.
+ * @param checkpoint {NMAP_Checkpoint*} - Checkpoint.
+ * @param hosts {const Array<t_host>*} - Result store of the group.
+ * @param targets {uint32_t} - Targets of the group, the dead ones that are not in its store included.
+ */
+void checkpoint_addGroup(NMAP_Checkpoint* checkpoint, const Array* hosts, uint32_t targets);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,60 @@
+//
+// Created by loumouli on 4/13/24.
+//
+
+#ifndef CREDITS_H
+#define CREDITS_H
+
+#include "ft_nmap.h"
+
+/**
+ * @brief Process-wide budget of outstanding probes, shared by all workers.
+ * @param {uint32_t} limit - Maximum number of probes in flight (0 means unlimited).
+ * @param {_Atomic uint32_t} inFlight - Probes currently in flight across all workers.
+ * @param {_Atomic uint32_t} peakInFlight - Highest value reached by inFlight.
+ * @param {_Atomic uint64_t} stalls - Number of times a worker ran out of credits.
+ * @param {_Atomic uint64_t} waitUs - Total time workers spent waiting for credits in microseconds.
+ */
+struct s_nmap_credits {
+  uint32_t limit;
+  _Atomic uint32_t inFlight;
+  _Atomic uint32_t peakInFlight;
+  _Atomic uint64_t stalls;
+  _Atomic uint64_t waitUs;
+};
+
+/**
+ * @brief init the credits with a limit.
+ * @param credits {NMAP_Credits*} - Credits to initialize.
+ * @param limit {uint32_t} - Maximum number of probes in flight (0 means unlimited).
+ */
+void credits_init(NMAP_Credits* credits, uint32_t limit);
+
+/**
+ * @brief take one credit without blocking.
+ * @param credits {NMAP_Credits*} - Shared credits.
+ * @return {bool} - true if the caller may send one probe, false if the global cap is reached.
+ */
+bool credits_tryAcquire(NMAP_Credits* credits);
+
+/**
+ * @brief give back the credit of a probe that got a reply or timed out.
+ * @param credits {NMAP_Credits*} - Shared credits.
+ */
+void credits_release(NMAP_Credits* credits);
+
+/**
+ * @brief record a stall: a worker had probes to send but no credit left.
+ * @param credits {NMAP_Credits*} - Shared credits.
+ * @param waitUs {uint64_t} - Duration of the stall in microseconds.
+ */
+void credits_addStall(NMAP_Credits* credits, uint64_t waitUs);
+
+/**
+ * @brief print the credits metrics.
+ * @param credits {const NMAP_Credits*} - Shared credits.
+ * @param stream {FILE*} - Stream to print to.
+ */
+void credits_print(const NMAP_Credits* credits, FILE* stream);
+
+#endif // CREDITS_H
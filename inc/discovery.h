@@ -0,0 +1,122 @@
+//
+// Created by loumouli on 4/27/24.
+//
+
+#ifndef DISCOVERY_H
+#define DISCOVERY_H
+
+#include "ft_nmap.h"
+
+#define NMAP_DISCOVERY_NONE 0b00000
+#define NMAP_DISCOVERY_ECHO 0b00001
+#define NMAP_DISCOVERY_SYN 0b00010
+#define NMAP_DISCOVERY_ACK 0b00100
+#define NMAP_DISCOVERY_TIMESTAMP 0b01000
+#define NMAP_DISCOVERY_ARP 0b10000
+#define NMAP_DISCOVERY_DEFAULT 0b01111 // echo, syn, ack and timestamp
+
+#define DISCOVERY_SYN_PORT 443
+#define DISCOVERY_ACK_PORT 80
+#define DISCOVERY_SOURCE_PORT 49153 // not the one of the scan probes, so that the replies of both never mix
+#define DISCOVERY_ROUNDS 2
+#define DISCOVERY_TIMEOUT_US 1'000'000 // per round, the initial timeout of a host
+#define DISCOVERY_POLL_US 10'000
+
+/**
+ * @brief Discovery state of a target of the group being discovered.
+ * @param {in_addr_t} ip - Address of the target.
+ * @param {uint32_t} rtt - Round-trip time of its first reply in microseconds, 0 until then.
+ * @param {struct timeval} sent - Time its probes of the current round were sent.
+ * @param {bool} up - true once it replied to any probe.
+ * @param {bool} local - On the subnet of the capture interface, ARP reaches it.
+ */
+typedef struct {
+  in_addr_t ip;
+  uint32_t rtt;
+  struct timeval sent;
+  bool up;
+  bool local;
+} NMAP_DiscoveryTarget;
+
+/**
+ * @brief Host discovery, run on every host group before its ports are scanned so that the dead hosts are never
+ * scanned. Every target of a group is probed at once, and the group is done as soon as every target replied.
+ * @param {uint32_t} probes - NMAP_DISCOVERY_* probes to send.
+ * @param {NMAP_Engine*} engine - Shared engine: capture interface and raw TCP socket.
+ * @param {int32_t} icmpSock - Raw ICMP socket of the echo and timestamp probes.
+ * @param {pcap_t*} handle - Capture of the replies, its filter also admits ARP replies unlike the engine one.
+ * @param {bool} arp - The interface is an ethernet one with a known address and netmask, ARP can be sent.
+ * @param {uint8_t[]} mac - Hardware address of the interface.
+ * @param {in_addr_t} netmask - Netmask of the interface.
+ * @param {uint16_t} id - Identifier of our ICMP probes.
+ * @param {Array<NMAP_DiscoveryTarget>} targets - Targets of the group being discovered, in target order.
+ * @param {Array<uint32_t>} byIp - Indices of the targets sorted by address, to match the replies.
+ * @param {uint64_t} pending - Targets of the group that did not reply yet.
+ * @param {uint64_t} probesSent - Probes sent by every discovery so far.
+ * @param {uint64_t} up - Targets found up so far.
+ * @param {uint64_t} down - Targets found down so far.
+ */
+typedef struct {
+  uint32_t probes;
+  NMAP_Engine* engine;
+  int32_t icmpSock;
+  pcap_t* handle;
+  bool arp;
+  uint8_t mac[ETH_ALEN];
+  in_addr_t netmask;
+  uint16_t id;
+  Array* targets;
+  Array* byIp;
+  uint64_t pending;
+  uint64_t probesSent;
+  uint64_t up;
+  uint64_t down;
+} NMAP_Discovery;
+
+/**
+ * @brief get the probe of a --discovery name.
+ * @param name {const char*} - echo, syn, ack, timestamp or arp.
+ * @return {uint32_t} - The NMAP_DISCOVERY_* probe, NMAP_DISCOVERY_NONE for an unknown name.
+ */
+uint32_t discovery_getProbe(const char* name);
+
+/**
+ * @brief build the capture filter of a discovery: the replies the engine admits, and the ARP replies.
+ * @param engine {const NMAP_Engine*} - Shared engine, its filter built.
+ * @return {char*} - The filter to free, NULL on failure (an error is printed).
+ */
+char* discovery_buildFilter(const NMAP_Engine* engine);
+
+/**
+ * @brief open the ICMP socket and the capture of a discovery.
+ * @param discovery {NMAP_Discovery*} - Discovery to initialize.
+ * @param engine {NMAP_Engine*} - Shared engine, initialized.
+ * @param probes {uint32_t} - NMAP_DISCOVERY_* probes to send.
+ * @return {int64_t} - 0 if success, 1 otherwise (an error is printed, the discovery must still be destroyed).
+ */
+int64_t discovery_init(NMAP_Discovery* discovery, NMAP_Engine* engine, uint32_t probes);
+
+/**
+ * @brief close and free a discovery.
+ * @param discovery {NMAP_Discovery*} - Discovery (can be zeroed or already destroyed).
+ */
+void discovery_destroy(NMAP_Discovery* discovery);
+
+/**
+ * @brief find the live hosts of a group. A target none of the probes can reach (only ARP, out of the local subnet)
+ * is kept.
+ * @param discovery {NMAP_Discovery*} - Discovery, used by one thread at a time.
+ * @param ips {Array<in_addr_t>*} - Targets of the group, only the live ones are left in it, in the same order.
+ * @param rtts {Array<uint32_t>*} - Set to the round-trip time of every live target in microseconds, 0 when unknown.
+ * @return {int64_t} - 0 if success, 1 otherwise (an error is printed).
+ */
+int64_t discovery_run(NMAP_Discovery* discovery, Array* ips, Array* rtts);
+
+/**
+ * @brief print the discovery metrics.
+ * @param discovery {const NMAP_Discovery*} - Discovery.
+ * @param stream {FILE*} - Stream to print to.
+ */
+void discovery_printStats(const NMAP_Discovery* discovery, FILE* stream);
+
+#endif // DISCOVERY_H
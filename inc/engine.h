@@ -0,0 +1,103 @@
+//
+// Created by loumouli on 4/15/24.
+//
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "ft_nmap.h"
+
+/**
+ * @brief Process-wide state of the ultra_scan engine, set up once in NMAP_spawnWorkers and borrowed by the workers.
+ * @param {char*} device - Name of the capture interface.
+ * @param {struct in_addr} inter_ip - IP address of the capture interface.
+ * @param {int32_t} sock - Raw TCP socket shared by all the workers (sendto is thread safe).
+ * @param {int32_t} udpSock - Raw UDP socket shared the same way, -1 unless UDP is scanned.
+ * @param {char*} filter - pcap filter admitting the replies sent to the capture interface.
+ * @param {struct bpf_program} program - filter compiled once, applied to every pcap handle.
+ * @param {bool} compiled - true once program is valid.
+ * @param {pthread_mutex_t} lock - Lock protecting handles, program and compiled.
+ * @param {Array<pcap_t*>} handles - Idle pcap handles, ready to be borrowed.
+ * @param {NMAP_HostTable*} hostTable - Per-host timing and congestion state.
+ * @param {NMAP_Credits} credits - Global budget of probes in flight.
+ * @param {NMAP_PoolSignals} signals - Counters fed by ultra_scan and read by the elastic pool.
+ * @param {struct timeval} start - Time NMAP_spawnWorkers started to set up the engine.
+ * @param {uint64_t} initUs - Duration of engine_init in microseconds.
+ * @param {_Atomic uint64_t} firstProbeUs - Time between start and the first probe sent, 0 until then.
+ */
+struct s_nmap_engine {
+  char* device;
+  struct in_addr inter_ip;
+  int32_t sock;
+  int32_t udpSock;
+  char* filter;
+  struct bpf_program program;
+  bool compiled;
+  pthread_mutex_t lock;
+  Array* handles;
+  NMAP_HostTable* hostTable;
+  NMAP_Credits credits;
+  NMAP_PoolSignals signals;
+  struct timeval start;
+  uint64_t initUs;
+  _Atomic uint64_t firstProbeUs;
+};
+
+/**
+ * @brief build "dst host <interface> and (icmp or tcp)", with "or (udp and dst port <UDP_SOURCE_PORT>)" when UDP is
+ * scanned. Replies are matched to their host by the workers, so the filter does not depend on the targets and stays
+ * the same size whatever their number. The destination port of the TCP replies is checked by rx_parse: the discovery
+ * captures with the same filter, its probes are sent from another port.
+ * @param engine {const NMAP_Engine*} - Engine, inter_ip and udpSock must be set.
+ * @return {char*} - The filter to free, NULL on failure.
+ */
+char* engine_buildFilter(const NMAP_Engine* engine);
+
+/**
+ * @brief discover the capture interface, open the raw sockets, build the filter and the shared tables.
+ * @param engine {NMAP_Engine*} - Engine to initialize.
+ * @param options {const NMAP_Options*} - Global options.
+ * @return {int64_t} - 0 if success, 1 otherwise (the engine must still be destroyed).
+ */
+int64_t engine_init(NMAP_Engine* engine, const NMAP_Options* options);
+
+/**
+ * @brief release every resource owned by the engine.
+ * @param engine {NMAP_Engine*} - Engine to destroy.
+ */
+void engine_destroy(NMAP_Engine* engine);
+
+/**
+ * @brief borrow a pcap handle with the engine filter applied, opening one if none is idle.
+ * @param engine {NMAP_Engine*} - Shared engine.
+ * @return {pcap_t*} - A drained pcap handle, NULL on failure.
+ */
+pcap_t* engine_borrowHandle(NMAP_Engine* engine);
+
+/**
+ * @brief give back a pcap handle borrowed with engine_borrowHandle.
+ * @param engine {NMAP_Engine*} - Shared engine.
+ * @param handle {pcap_t*} - Handle to give back.
+ */
+void engine_returnHandle(NMAP_Engine* engine, pcap_t* handle);
+
+/**
+ * @brief throw away every packet already captured by a handle.
+ * @param handle {pcap_t*} - Handle to drain.
+ */
+void engine_drainHandle(pcap_t* handle);
+
+/**
+ * @brief record the time to first probe, cheap after the first call.
+ * @param engine {NMAP_Engine*} - Shared engine.
+ */
+void engine_onProbeSent(NMAP_Engine* engine);
+
+/**
+ * @brief print the engine metrics.
+ * @param engine {const NMAP_Engine*} - Shared engine.
+ * @param stream {FILE*} - Stream to print to.
+ */
+void engine_printStats(const NMAP_Engine* engine, FILE* stream);
+
+#endif // ENGINE_H
@@ -0,0 +1,93 @@
+//
+// Created by loumouli on 4/30/24.
+//
+
+#ifndef EXCLUSIONS_H
+#define EXCLUSIONS_H
+
+#include "ft_nmap.h"
+
+#define EXCLUSIONS_INDEX_BITS 16
+
+/**
+ * @brief Inclusive interval of addresses, in host byte order.
+ * @param {uint32_t} first - First address.
+ * @param {uint32_t} last - Last address.
+ */
+typedef struct {
+  uint32_t first;
+  uint32_t last;
+} NMAP_Interval;
+
+/**
+ * @brief Addresses never to probe. The intervals are sorted and merged once added, and indexed by the top
+ * EXCLUSIONS_INDEX_BITS bits of an address: a lookup only binary searches the few intervals sharing its /16, whatever
+ * the size of the list.
+ * @param {Array<NMAP_Interval>} intervals - Excluded intervals, sorted, disjoint and not adjacent once sealed.
+ * @param {uint32_t*} index - For each /16, the first interval ending in it or after it. 2^EXCLUSIONS_INDEX_BITS + 1
+ * entries, the last one is the number of intervals.
+ * @param {bool} sealed - intervals and index are ready to be looked up.
+ * @param {uint64_t} excluded - Number of addresses excluded, once sealed.
+ */
+typedef struct {
+  Array* intervals;
+  uint32_t* index;
+  bool sealed;
+  uint64_t excluded;
+} NMAP_Exclusions;
+
+/**
+ * @brief create an empty exclusion list.
+ * @return {NMAP_Exclusions*} - The list, NULL on allocation failure.
+ */
+NMAP_Exclusions* exclusions_create(void);
+
+/**
+ * @brief free an exclusion list.
+ * @param exclusions {NMAP_Exclusions*} - List (can be NULL).
+ */
+void exclusions_destroy(NMAP_Exclusions* exclusions);
+
+/**
+ * @brief exclude an interval of addresses, the list has to be sealed again before the next lookup.
+ * @param exclusions {NMAP_Exclusions*} - List.
+ * @param first {uint32_t} - First address, in host byte order.
+ * @param last {uint32_t} - Last address, at least first.
+ * @return {int64_t} - 0 if success, 1 on allocation failure.
+ */
+int64_t exclusions_add(NMAP_Exclusions* exclusions, uint32_t first, uint32_t last);
+
+/**
+ * @brief sort and merge the intervals and build their index.
+ * @param exclusions {NMAP_Exclusions*} - List.
+ * @return {int64_t} - 0 if success, 1 on allocation failure.
+ */
+int64_t exclusions_seal(NMAP_Exclusions* exclusions);
+
+/**
+ * @brief test if an address is excluded.
+ * @param exclusions {const NMAP_Exclusions*} - List, sealed.
+ * @param ip {uint32_t} - Address, in host byte order.
+ * @return {bool} - true if the address is excluded.
+ */
+bool exclusions_contains(const NMAP_Exclusions* exclusions, uint32_t ip);
+
+/**
+ * @brief test if any address of an interval is excluded.
+ * @param exclusions {const NMAP_Exclusions*} - List, sealed.
+ * @param first {uint32_t} - First address of the interval, in host byte order.
+ * @param last {uint32_t} - Last address, at least first.
+ * @return {bool} - true if at least one address is excluded.
+ */
+bool exclusions_overlaps(const NMAP_Exclusions* exclusions, uint32_t first, uint32_t last);
+
+/**
+ * @brief test if every address of an interval is excluded.
+ * @param exclusions {const NMAP_Exclusions*} - List, sealed.
+ * @param first {uint32_t} - First address of the interval, in host byte order.
+ * @param last {uint32_t} - Last address, at least first.
+ * @return {bool} - true if the whole interval is excluded.
+ */
+bool exclusions_covers(const NMAP_Exclusions* exclusions, uint32_t first, uint32_t last);
+
+#endif // EXCLUSIONS_H
@@ -7,20 +7,29 @@
 
 // standard headers
 #include <argp.h>
+#include <fcntl.h>
 #include <ifaddrs.h>
 #include <math.h>
 #include <netinet/ether.h>
 #include <netinet/ip_icmp.h>
 #include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <netpacket/packet.h>
 #include <pcap.h>
 #include <poll.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 // library headers
 #include <array.h>
+#include <ring.h>
 // ---------------
 
 // local headers
@@ -34,6 +43,16 @@ typedef enum e_nmap_port_status NMAP_PortStatus;
 typedef struct s_nmap_options NMAP_Options;
 typedef struct s_nmap_worker_options NMAP_WorkerOptions;
 typedef struct s_nmap_worker_data NMAP_WorkerData;
+typedef struct s_nmap_host_timing NMAP_HostTiming;
+typedef struct s_nmap_host_table NMAP_HostTable;
+typedef struct s_nmap_credits NMAP_Credits;
+typedef struct s_nmap_worker_pool NMAP_WorkerPool;
+typedef struct s_nmap_pool_signals NMAP_PoolSignals;
+typedef struct s_nmap_engine NMAP_Engine;
+typedef struct s_nmap_port_map NMAP_PortMap;
+typedef struct s_nmap_targets NMAP_Targets;
+typedef struct s_nmap_permutation NMAP_Permutation;
+typedef enum e_nmap_output_format NMAP_OutputFormat;
 
 #define NMAP_SCAN_NONE 0b000000 // DIFFERENT THAT SCAN_NULL x)
 #define NMAP_SCAN_SYN 0b000001
@@ -43,6 +62,18 @@ typedef struct s_nmap_worker_data NMAP_WorkerData;
 #define NMAP_SCAN_ACK 0b010000
 #define NMAP_SCAN_UDP 0b100000
 #define NMAP_SCAN_ALL 0b111111
+#define NMAP_SCAN_TCP 0b011111 // the default, UDP is only run when asked for: its silent ports make it far slower
+
+#define UDP_SOURCE_PORT 49152 // source port of the UDP probes, the replies of open ports are sent back to it
+#define TCP_SOURCE_PORT 49152 // source port of the TCP probes, likely unused
+
+#define ELASTIC_TICK_US 500'000
+#define ELASTIC_CHUNKS_PER_WORKER 4
+#define ELASTIC_MAX_LOSS 0.10
+#define ELASTIC_MAX_CPU 0.90
+
+#define HOSTGROUP_DEFAULT_MIN 16
+#define HOSTGROUP_DEFAULT_MAX 1024
 
 enum e_nmap_option_key {
   NMAP_KEY_IP = 'i',
@@ -50,6 +81,27 @@ enum e_nmap_option_key {
   NMAP_KEY_SCAN = 'S',
   NMAP_KEY_SPEEDUP = 's',
   NMAP_KEY_PORTS = 'p',
+  NMAP_KEY_OUTPUT = 'o',
+  NMAP_KEY_MAX_PARALLELISM = 256,
+  NMAP_KEY_STATS,
+  NMAP_KEY_ELASTIC,
+  NMAP_KEY_MIN_HOSTGROUP,
+  NMAP_KEY_MAX_HOSTGROUP,
+  NMAP_KEY_RANDOMIZE,
+  NMAP_KEY_SEED,
+  NMAP_KEY_SHARD,
+  NMAP_KEY_OUTPUT_FORMAT,
+  NMAP_KEY_RESULT_FILE,
+  NMAP_KEY_CHECKPOINT,
+  NMAP_KEY_RESUME,
+  NMAP_KEY_BASELINE,
+  NMAP_KEY_TOP_PORTS,
+  NMAP_KEY_PORT_RATIO,
+  NMAP_KEY_DISCOVERY,
+  NMAP_KEY_RESOLVERS,
+  NMAP_KEY_EXCLUDE_PORTS,
+  NMAP_KEY_EXCLUDE,
+  NMAP_KEY_EXCLUDE_FILE,
 };
 
 enum e_nmap_port_status {
@@ -58,28 +110,98 @@ enum e_nmap_port_status {
   NMAP_CLOSE = 1 << 2, // == 4
   NMAP_FILTERED = 1 << 3, // == 8
   NMAP_UNFILTERED = 1 << 4, // == 16
+  NMAP_OPEN_FILTERED = 1 << 5, // == 32, no reply to a UDP probe: open, or filtered
+};
+
+enum e_nmap_output_format {
+  NMAP_OUTPUT_TEXT = 0, // report per host, once every port of the host is final
+  NMAP_OUTPUT_JSONL = 1, // one JSON object per line, streamed as results resolve
+  NMAP_OUTPUT_GREPABLE = 2, // one line per port, streamed as results resolve
 };
 
 struct s_nmap_options {
   uint32_t scan;
   uint8_t speedup;
-  Array* ips; // Array <in_addr_t>
+  uint8_t minSpeedup; // elastic mode only
+  uint8_t maxSpeedup; // 0 == elastic mode disabled
+  bool stats;
+  uint32_t maxParallelism; // 0 == unlimited
+  uint32_t minHostgroup; // size of the first host group, groups never shrink below it
+  uint32_t maxHostgroup;
+  bool randomize; // hosts and ports in a pseudo-random order
+  uint64_t seed; // of the random order
+  uint32_t shard; // scan the targets of this shard only, in [0, shards)
+  uint32_t shards;
+  const char* outputPath; // NULL == standard output
+  NMAP_OutputFormat outputFormat;
+  const char* resultPath; // binary result file, NULL == none
+  const char* checkpointPath; // NULL == no checkpoint
+  bool resume; // from checkpointPath
+  const char* baselinePath; // result file of a previous scan to compare to, NULL == none
+  uint32_t discovery; // NMAP_DISCOVERY_* probes finding the live hosts, 0 == every target is scanned
+  NMAP_Targets* targets; // pulled one host group at a time
   Array* ports; // Array<uint16_t>
 };
 
 struct s_nmap_worker_options {
   uint32_t scan;
-  const Array* ips; // Array<in_addr_t>
+  Array* hosts; // Array<t_host>, result store of the group the chunk is scanned for
   Array* ports; // Array<uint16_t>
+  uint32_t portOffset; // position of the first port of the chunk in portOrder
+  const NMAP_Permutation* portOrder; // order of the ports of the scan, maps the chunk ports to their result index
+  bool randomize; // probe the ports in a pseudo-random order
+  uint64_t seed; // of the port order of this chunk
+  NMAP_Engine* engine; // shared by all workers
+};
+
+/**
+ * @brief Counters fed by every ultra_scan, used by the elastic pool to decide its size.
+ * @param {_Atomic uint64_t} probesSent - Probes sent (retransmissions included).
+ * @param {_Atomic uint64_t} retransmits - Probes that timed out and were scheduled again.
+ * @param {_Atomic uint64_t} losses - Retransmissions to hosts that already replied: the probes lost, without the ports
+ * that stay silent whatever the load (filtered ports, silent hosts, UDP).
+ * @param {_Atomic uint64_t} sendErrors - Probes rejected because the socket send queue was full.
+ * @param {_Atomic uint64_t} captureDrops - Packets dropped by the capture buffer before we could read them.
+ * @param {_Atomic uint64_t} replies - Replies parsed by the RX stages.
+ * @param {_Atomic uint64_t} rxStalls - Replies the RX stages had to hold because the worker was behind.
+ */
+struct s_nmap_pool_signals {
+  _Atomic uint64_t probesSent;
+  _Atomic uint64_t retransmits;
+  _Atomic uint64_t losses;
+  _Atomic uint64_t sendErrors;
+  _Atomic uint64_t captureDrops;
+  _Atomic uint64_t replies;
+  _Atomic uint64_t rxStalls;
 };
 
 struct s_nmap_worker_data {
   pthread_t thread;
-  NMAP_WorkerOptions options;
-  void* result;
+  NMAP_WorkerPool* pool;
+  _Atomic bool retire; // set by the elastic controller, the worker exits after its current chunk
+  _Atomic bool finished;
+  bool running; // spawned and not joined yet
+  uint64_t cpuNs; // thread CPU time at the previous elastic tick
 };
 
+#include "permutation.h"
+#include "resolver.h"
+#include "exclusions.h"
+#include "targets.h"
+#include "port_map.h"
+#include "port_set.h"
 #include "t_host.h"
+#include "probe_slab.h"
+#include "host_table.h"
+#include "credits.h"
+#include "engine.h"
+#include "rx.h"
+#include "output.h"
+#include "result_file.h"
+#include "baseline.h"
+#include "services.h"
+#include "discovery.h"
+#include "checkpoint.h"
 #include "ultra_scan.h"
 
 // options.c
@@ -102,14 +224,13 @@ int NMAP_spawnWorkers(const NMAP_Options* options);
 
 // Engine function
 /**
- * @brief ultra_scan engine, based on nmap one
- * @param ips {Array<in_addr>} - Vector of targets to scan.
- * @param ports {Array<uint16_t>} - Vector of ports to scan.
- * @param scanType {NMAP_ScanType} - Type of scan to perform.
- * @param thread_result {Array<Array<t_host>} - Actual result of all the scan
- * @return {int64_t} - 0 if success, 1 otherwise.
+ * @brief ultra_scan engine, based on nmap one. Runs every scan type of options on the same state buffers and
+ * pcap handle, borrowed once from the engine.
+ * @param options {const NMAP_WorkerOptions*} - Targets, ports, scan types and shared engine of the worker.
+ * @return {int64_t} - 0 if success, 1 otherwise. The results of every scan type are folded into the result store of
+ * options as they come, a port of a failed chunk may stay unknown.
  */
-int64_t ultra_scan(const Array* ips, const Array* ports, NMAP_ScanType scanType, Array* thread_result);
+int64_t ultra_scan(const NMAP_WorkerOptions* options);
 
 // Packet I/O
 
@@ -126,31 +247,31 @@ uint64_t send_packet(int sck, const uint8_t* packet, uint64_t size_packet, int32
 
 // TCP SYN  Function
 
-int32_t tcp_syn_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src);
+int32_t tcp_syn_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src);
 
 NMAP_PortStatus tcp_syn_analysis(const struct iphdr* ip_hdr, const void* ip_payload);
 
 // TCP ACK Function
 
-int32_t tcp_ack_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src);
+int32_t tcp_ack_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src);
 
 NMAP_PortStatus tcp_ack_analysis(const struct iphdr* ip_hdr, const void* ip_payload);
 
 // TCP NULL Function
 
-int32_t tcp_null_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src);
+int32_t tcp_null_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src);
 
 NMAP_PortStatus tcp_null_analysis(const struct iphdr* ip_hdr, const void* ip_payload);
 
 // TCP FIN Function
 
-int32_t tcp_fin_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src);
+int32_t tcp_fin_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src);
 
 NMAP_PortStatus tcp_fin_analysis(const struct iphdr* ip_hdr, const void* ip_payload);
 
 // TCP XMAS Function
 
-int32_t tcp_xmas_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src);
+int32_t tcp_xmas_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src);
 
 NMAP_PortStatus tcp_xmas_analysis(const struct iphdr* ip_hdr, const void* ip_payload);
 
@@ -158,10 +279,17 @@ NMAP_PortStatus tcp_xmas_analysis(const struct iphdr* ip_hdr, const void* ip_pay
 // Utils
 char* port_status_to_string(NMAP_PortStatus status);
 
+/**
+ * @brief protocol of the ports of a scan, for the reports.
+ * @param scan {uint32_t} - NMAP_SCAN_* types of the scan.
+ * @return {const char*} - "udp" for a UDP only scan, "tcp" otherwise.
+ */
+const char* scan_protocol(uint32_t scan);
+
 // UDP
 NMAP_PortStatus udp_analysis(const struct iphdr* ip_hdr, const void* ip_payload);
 
-uint32_t udp_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dst, struct in_addr ip_src);
+int32_t udp_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dst, struct in_addr ip_src);
 
 // Checksum
 
@@ -173,4 +301,14 @@ uint32_t udp_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr i
  */
 uint16_t checksum(uint16_t* buffer, int size);
 
+/**
+ * @brief - Checksum of a TCP segment, over its pseudo header
+ * @param vdata {const void*} - TCP header and payload
+ * @param length {size_t} - size in bytes of the segment
+ * @param src_addr {struct in_addr} - source address
+ * @param dest_addr {struct in_addr} - destination address
+ * @return {uint16_t} - return the checksum
+ */
+uint16_t tcp_checksum(const void* vdata, size_t length, struct in_addr src_addr, struct in_addr dest_addr);
+
 #endif
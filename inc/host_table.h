@@ -0,0 +1,105 @@
+//
+// Created by loumouli on 4/12/24.
+//
+
+#ifndef HOST_TABLE_H
+#define HOST_TABLE_H
+
+#include "ft_nmap.h"
+
+#define HOST_TABLE_STRIPES 64
+#define HOST_INITIAL_CWND 10.0
+#define HOST_INITIAL_SSTHRESH 75.0
+#define HOST_MAX_CWND 1000.0
+#define HOST_MIN_CWND 1.0
+
+/**
+ * @brief Timing and congestion state of one target, shared by every worker scanning it.
+ * @param {in_addr_t} ip - IP address of the host.
+ * @param {uint32_t} stripe - Index of the lock protecting srtt/rttvar/ssthresh.
+ * @param {long double} srtt - Smoothed Round-Trip Time in microseconds.
+ * @param {long double} rttvar - Round-Trip Time Variance in microseconds.
+ * @param {double} ssthresh - Slow start threshold of the congestion window.
+ * @param {_Atomic double} timeout - Timeout for a probe in microseconds, readable without lock.
+ * @param {_Atomic double} cwnd - Congestion window (max probes in flight), readable without lock.
+ * @param {_Atomic uint32_t} inFlight - Probes sent to this host by all workers and not yet answered or timed out.
+ */
+struct s_nmap_host_timing {
+  in_addr_t ip;
+  uint32_t stripe;
+  long double srtt;
+  long double rttvar;
+  double ssthresh;
+  _Atomic double timeout;
+  _Atomic double cwnd;
+  _Atomic uint32_t inFlight;
+};
+
+/**
+ * @brief Process-wide timing bounds and locks. The NMAP_HostTiming entries live with the host group of their target.
+ * @param {double} minTimeout - Minimum timeout for a probe in microseconds.
+ * @param {double} maxTimeout - Maximum timeout for a probe in microseconds.
+ * @param {pthread_mutex_t[]} locks - Striped locks protecting the RTT estimators.
+ */
+struct s_nmap_host_table {
+  double minTimeout;
+  double maxTimeout;
+  pthread_mutex_t locks[HOST_TABLE_STRIPES];
+};
+
+/**
+ * @brief create the shared table.
+ * @return {NMAP_HostTable*} - The new table, or NULL on allocation failure.
+ */
+NMAP_HostTable* hostTable_create(void);
+
+/**
+ * @brief destroy a table created with hostTable_create.
+ * @param table {NMAP_HostTable*} - Table to destroy (can be NULL).
+ */
+void hostTable_destroy(NMAP_HostTable* table);
+
+/**
+ * @brief create the initial timing entries of a group of targets.
+ * @param ips {const Array<in_addr_t>*} - Targets of the group.
+ * @return {Array<NMAP_HostTiming>} - One entry per target in the same order, NULL on allocation failure.
+ */
+Array* hostTable_createTimings(const Array* ips);
+
+/**
+ * @brief check whether the congestion window of a host allows one more probe.
+ * @param timing {const NMAP_HostTiming*} - Shared entry of the host.
+ * @return {bool} - true if a probe can be sent, false otherwise.
+ */
+bool hostTable_canSend(const NMAP_HostTiming* timing);
+
+/**
+ * @brief account for a probe sent to a host.
+ * @param timing {NMAP_HostTiming*} - Shared entry of the host.
+ */
+void hostTable_onSend(NMAP_HostTiming* timing);
+
+/**
+ * @brief account for a reply: update RTT estimators and timeout, grow the congestion window.
+ * @param table {NMAP_HostTable*} - Shared table.
+ * @param timing {NMAP_HostTiming*} - Shared entry of the host.
+ * @param rtt {long double} - Measured round-trip time in microseconds.
+ */
+void hostTable_onReply(NMAP_HostTable* table, NMAP_HostTiming* timing, long double rtt);
+
+/**
+ * @brief account for a probe that timed out: shrink the congestion window of a host that already replied.
+ * @param table {NMAP_HostTable*} - Shared table.
+ * @param timing {NMAP_HostTiming*} - Shared entry of the host.
+ * @return {bool} - true if the host already replied: the probe was lost, its silence is not the one of its port.
+ */
+bool hostTable_onDrop(NMAP_HostTable* table, NMAP_HostTiming* timing);
+
+/**
+ * @brief account for a probe that timed out without its silence saying anything about congestion (most UDP ports
+ * never reply): free its place in the congestion window, leave the window as it is.
+ * @param timing {NMAP_HostTiming*} - Shared entry of the host.
+ */
+void hostTable_onSilence(NMAP_HostTiming* timing);
+
+#endif // HOST_TABLE_H
@@ -0,0 +1,126 @@
+//
+// Created by loumouli on 4/22/24.
+//
+
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include "ft_nmap.h"
+
+#define OUTPUT_RING_CAPACITY 8192
+#define OUTPUT_BUFFER_SIZE (1 << 16)
+#define OUTPUT_MAX_LINE 256
+#define OUTPUT_POLL_US 1'000
+#define OUTPUT_BATCH 256
+
+typedef enum e_nmap_output_record_type {
+  // A port whose result is final
+  OUTPUT_PORT = 0,
+
+  // Every port of a host is final, carries the number of ports with a result
+  OUTPUT_HOST = 1,
+
+  // A port open in the baseline and not anymore, or the other way around
+  OUTPUT_CHANGE = 2,
+} NMAP_OutputRecordType;
+
+/**
+ * @brief Result handed to the output writer, formatted by it.
+ * @param {struct in_addr} ip - IP address of the host.
+ * @param {uint32_t} analyzed - OUTPUT_HOST only, number of ports of the host with a result.
+ * @param {uint16_t} opened - OUTPUT_HOST with a baseline only, number of ports newly open.
+ * @param {uint16_t} closed - OUTPUT_HOST with a baseline only, number of ports newly closed, the others with a result
+ * are unchanged.
+ * @param {uint16_t} port - OUTPUT_PORT and OUTPUT_CHANGE only, port the result is about.
+ * @param {uint8_t} status - OUTPUT_PORT and OUTPUT_CHANGE only, NMAP_PortStatus of the port.
+ * @param {uint8_t} previous - OUTPUT_CHANGE only, NMAP_PortStatus of the port in the baseline.
+ * @param {uint8_t} type - NMAP_OutputRecordType of the record.
+ * @param {bool} diff - OUTPUT_HOST only, the host was compared to a baseline.
+ */
+typedef struct {
+  struct in_addr ip;
+  uint32_t analyzed;
+  uint16_t opened;
+  uint16_t closed;
+  uint16_t port;
+  uint8_t status;
+  uint8_t previous;
+  uint8_t type;
+  bool diff;
+} NMAP_OutputRecord;
+
+/**
+ * @brief Output writer: a thread formatting the records pushed by the workers into a large buffer, written out at
+ * every host boundary, when it fills up or when no record is waiting.
+ * @param {pthread_t} thread - Writer thread, running between output_start and output_stop.
+ * @param {Ring<NMAP_OutputRecord>} records - MPSC ring from the workers to the writer.
+ * @param {NMAP_OutputFormat} format - Format of the records.
+ * @param {const char*} protocol - Protocol of the ports, "tcp" or "udp".
+ * @param {int32_t} fd - File descriptor written to.
+ * @param {bool} ownsFd - true if fd was opened by output_init.
+ * @param {char*} buffer - OUTPUT_BUFFER_SIZE bytes of formatted records not written yet.
+ * @param {size_t} used - Bytes used in buffer.
+ * @param {bool} running - true between output_start and output_stop.
+ * @param {_Atomic bool} stop - Set by output_stop, the thread exits once the ring is drained.
+ * @param {_Atomic bool} failed - Set by the thread if a write failed, records are dropped from then on.
+ */
+typedef struct {
+  pthread_t thread;
+  Ring* records;
+  NMAP_OutputFormat format;
+  const char* protocol;
+  int32_t fd;
+  bool ownsFd;
+  char* buffer;
+  size_t used;
+  bool running;
+  _Atomic bool stop;
+  _Atomic bool failed;
+} NMAP_Output;
+
+/**
+ * @brief open the destination of the results and allocate the ring and the buffer of a writer.
+ * @param output {NMAP_Output*} - Writer to initialize.
+ * @param path {const char*} - File to write the results to, NULL or "-" for the standard output.
+ * @param format {NMAP_OutputFormat} - Format of the results.
+ * @param protocol {const char*} - Protocol of the ports, see scan_protocol.
+ * @return {int64_t} - 0 if success, 1 otherwise (the writer must still be destroyed).
+ */
+int64_t output_init(NMAP_Output* output, const char* path, NMAP_OutputFormat format, const char* protocol);
+
+/**
+ * @brief close the destination and free a writer, which must be stopped.
+ * @param output {NMAP_Output*} - Writer to destroy.
+ */
+void output_destroy(NMAP_Output* output);
+
+/**
+ * @brief start the writer thread.
+ * @param output {NMAP_Output*} - Writer, stopped.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+int64_t output_start(NMAP_Output* output);
+
+/**
+ * @brief write every record already pushed, then stop and join the writer thread.
+ * @param output {NMAP_Output*} - Writer.
+ * @return {int64_t} - 0 if every record was written, 1 otherwise.
+ */
+int64_t output_stop(NMAP_Output* output);
+
+/**
+ * @brief hand a record to the writer, waiting for room in the ring. Safe to call from any number of threads, the
+ * records of one thread are written in the order they are pushed.
+ * @param output {NMAP_Output*} - Writer, started.
+ * @param record {const NMAP_OutputRecord*} - Record to write.
+ */
+void output_push(NMAP_Output* output, const NMAP_OutputRecord* record);
+
+/**
+ * @brief whether the records of a format are written as soon as each port is final, rather than grouped per host.
+ * @param format {NMAP_OutputFormat} - Format of the results.
+ * @return {bool} - true for the line oriented formats (JSON Lines and grepable), false for the text report.
+ */
+bool output_isStreamed(NMAP_OutputFormat format);
+
+#endif // OUTPUT_H
@@ -0,0 +1,52 @@
+//
+// Created by loumouli on 4/22/24.
+//
+
+#ifndef PERMUTATION_H
+#define PERMUTATION_H
+
+#include "ft_nmap.h"
+
+#define PERMUTATION_ROUNDS 4
+
+/**
+ * @brief Pseudo-random permutation of [0, range), computed on demand by a balanced Feistel network on the smallest
+ * even number of bits covering range: indexes outside of the range are walked through the network again until they
+ * fall in it. It holds no table, any index (or shard of indexes) can be computed independently.
+ * @param {uint64_t} range - Size of the permuted interval.
+ * @param {uint32_t} halfBits - Bits of each half of the Feistel network.
+ * @param {uint32_t} rounds - Rounds of the network, 0 for the identity.
+ * @param {uint64_t[]} keys - Round keys, derived from the seed.
+ */
+struct s_nmap_permutation {
+  uint64_t range;
+  uint32_t halfBits;
+  uint32_t rounds;
+  uint64_t keys[PERMUTATION_ROUNDS];
+};
+
+/**
+ * @brief set up a permutation of [0, range).
+ * @param permutation {NMAP_Permutation*} - Permutation to initialize.
+ * @param range {uint64_t} - Size of the interval, at most 2^32.
+ * @param randomize {bool} - false for the identity.
+ * @param seed {uint64_t} - Seed of the round keys, the same seed gives the same order.
+ */
+void permutation_init(NMAP_Permutation* permutation, uint64_t range, bool randomize, uint64_t seed);
+
+/**
+ * @brief position i of the permutation.
+ * @param permutation {const NMAP_Permutation*} - Permutation.
+ * @param i {uint64_t} - Index in [0, range).
+ * @return {uint64_t} - Permuted index in [0, range).
+ */
+uint64_t permutation_at(const NMAP_Permutation* permutation, uint64_t i);
+
+/**
+ * @brief splitmix64 step, to derive independent seeds from one.
+ * @param x {uint64_t} - Input.
+ * @return {uint64_t} - Well mixed output.
+ */
+uint64_t permutation_mix(uint64_t x);
+
+#endif // PERMUTATION_H
@@ -0,0 +1,81 @@
+//
+// Created by loumouli on 4/18/24.
+//
+
+#ifndef PORT_MAP_H
+#define PORT_MAP_H
+
+#include "ft_nmap.h"
+
+/* Bits of a port status code, NMAP_PortStatus flags are stored as their bit index */
+#define PORT_MAP_BITS 3
+#define PORT_MAP_MASK ((1ULL << PORT_MAP_BITS) - 1)
+/* Codes never straddle two words, the last bit of each word is unused */
+#define PORT_MAP_PER_WORD (64 / PORT_MAP_BITS)
+
+/**
+ * @brief Dense status of the finished ports of a host, PORT_MAP_BITS bits per port.
+ * @param {uint64_t*} words - Packed status codes, port i is in words[i / PORT_MAP_PER_WORD].
+ * @param {uint32_t} count - Number of ports in the map.
+ */
+struct s_nmap_port_map {
+  uint64_t* words;
+  uint32_t count;
+} __attribute__((packed));
+
+/**
+ * @brief number of words needed by a map of count ports, to lay several maps out in one block.
+ * @param count {uint32_t} - Number of ports.
+ * @return {size_t} - Number of uint64_t words.
+ */
+size_t portMap_words(uint32_t count);
+
+/**
+ * @brief allocate a map of count ports, all NMAP_UNKNOWN.
+ * @param map {NMAP_PortMap*} - Map to initialize.
+ * @param count {uint32_t} - Number of ports.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+int64_t portMap_init(NMAP_PortMap* map, uint32_t count);
+
+/**
+ * @brief free the words of a map.
+ * @param map {NMAP_PortMap*} - Map to destroy.
+ */
+void portMap_destroy(NMAP_PortMap* map);
+
+/**
+ * @brief read the status of a port.
+ * @param map {const NMAP_PortMap*} - Map.
+ * @param i {uint32_t} - Index of the port.
+ * @return {NMAP_PortStatus} - Status of the port.
+ */
+NMAP_PortStatus portMap_get(const NMAP_PortMap* map, uint32_t i);
+
+/**
+ * @brief write the status of a port.
+ * @param map {NMAP_PortMap*} - Map.
+ * @param i {uint32_t} - Index of the port.
+ * @param status {NMAP_PortStatus} - Status of the port.
+ */
+void portMap_set(NMAP_PortMap* map, uint32_t i, NMAP_PortStatus status);
+
+/**
+ * @brief merge the status of a port written concurrently with its neighbours: an open port stays open, open|filtered
+ * only sets a port without a status yet, any other status is overridden. The word is updated with a compare and swap,
+ * the other ports of the word are left intact.
+ * @param map {NMAP_PortMap*} - Map shared between threads.
+ * @param i {uint32_t} - Index of the port.
+ * @param status {NMAP_PortStatus} - Status to merge.
+ */
+void portMap_fold(NMAP_PortMap* map, uint32_t i, NMAP_PortStatus status);
+
+/**
+ * @brief copy every status of src into dst, starting at index offset.
+ * @param dst {NMAP_PortMap*} - Destination map, at least offset + src->count ports.
+ * @param offset {uint32_t} - Index in dst of the first port of src.
+ * @param src {const NMAP_PortMap*} - Source map.
+ */
+void portMap_copy(NMAP_PortMap* dst, uint32_t offset, const NMAP_PortMap* src);
+
+#endif // PORT_MAP_H
@@ -0,0 +1,78 @@
+//
+// Created by loumouli on 4/29/24.
+//
+
+#ifndef PORT_SET_H
+#define PORT_SET_H
+
+#include "ft_nmap.h"
+
+#define PORTSET_WORDS ((UINT16_MAX + 1) / 64)
+
+/**
+ * @brief Set of ports, one bit per port: adding, removing and testing a port is O(1), combining two sets is one pass
+ * over 1024 words, and iterating skips the empty words.
+ * @param {uint64_t[]} words - Bit port % 64 of word port / 64 is set when port is in the set.
+ * @param {uint32_t} size - Number of ports in the set.
+ */
+typedef struct {
+  uint64_t words[PORTSET_WORDS];
+  uint32_t size;
+} NMAP_PortSet;
+
+/**
+ * @brief empty a set.
+ * @param set {NMAP_PortSet*} - Set.
+ */
+void portSet_clear(NMAP_PortSet* set);
+
+/**
+ * @brief test if a port is in a set.
+ * @param set {const NMAP_PortSet*} - Set.
+ * @param port {uint16_t} - Port.
+ * @return {bool} - true if the port is in the set.
+ */
+bool portSet_has(const NMAP_PortSet* set, uint16_t port);
+
+/**
+ * @brief add the ports [first, last] to a set.
+ * @param set {NMAP_PortSet*} - Set.
+ * @param first {uint16_t} - First port of the range.
+ * @param last {uint16_t} - Last port of the range, at least first.
+ * @return {uint32_t} - Number of ports of the range that were already in the set.
+ */
+uint32_t portSet_addRange(NMAP_PortSet* set, uint16_t first, uint16_t last);
+
+/**
+ * @brief remove the ports of other from a set.
+ * @param set {NMAP_PortSet*} - Set.
+ * @param other {const NMAP_PortSet*} - Ports to remove.
+ */
+void portSet_subtract(NMAP_PortSet* set, const NMAP_PortSet* other);
+
+/**
+ * @brief keep only the ports of a set that are also in other.
+ * @param set {NMAP_PortSet*} - Set.
+ * @param other {const NMAP_PortSet*} - Ports to keep.
+ */
+void portSet_intersect(NMAP_PortSet* set, const NMAP_PortSet* other);
+
+/**
+ * @brief find the first port of a set from a port on, to iterate it in numeric order:
+ * for (int32_t port = portSet_next(set, 0); port >= 0; port = portSet_next(set, port + 1))
+ * @param set {const NMAP_PortSet*} - Set.
+ * @param from {uint32_t} - First port to look at, UINT16_MAX + 1 is past the end.
+ * @return {int32_t} - The smallest port of the set at least from, -1 if there is none.
+ */
+int32_t portSet_next(const NMAP_PortSet* set, uint32_t from);
+
+/**
+ * @brief add the ports of a specification to a set: comma separated ports and ranges (eg: 1-10 or 1,2,3 or 1,5-15).
+ * @param set {NMAP_PortSet*} - Set.
+ * @param spec {const char*} - Specification.
+ * @param duplicate {bool*} - Set to true if a port of the specification was already in the set (left as is otherwise).
+ * @return {int64_t} - 0 if success, 1 if the specification is invalid (the set may be partially filled).
+ */
+int64_t portSet_parse(NMAP_PortSet* set, const char* spec, bool* duplicate);
+
+#endif // PORT_SET_H
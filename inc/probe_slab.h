@@ -0,0 +1,100 @@
+//
+// Created by loumouli on 4/20/24.
+//
+
+#ifndef PROBE_SLAB_H
+#define PROBE_SLAB_H
+
+#include "ft_nmap.h"
+
+/* Alignment of every slab column */
+#define PROBE_SLAB_ALIGN 64
+/* Upper bound of the slab of a single ultra_scan, whatever the congestion windows allow */
+#define PROBE_SLAB_MAX (1U << 16)
+
+typedef enum { SLOT_FREE = 0, SLOT_SENT = 1, SLOT_RETRY = 2 } NMAP_SlotState;
+
+/**
+ * @brief Fixed-capacity store of the probes of a scan that are in flight or waiting to be sent again. A probe gets a
+ * slot when it is first sent and gives it back as soon as its result is recorded. Slots are columns, like the rest of
+ * the hot probe state, and indexed by (host, port) with an open addressing table.
+ * @param {uint32_t} capacity - Number of slots, a power of two.
+ * @param {uint32_t} used - Number of slots taken.
+ * @param {uint32_t*} freeSlots - Stack of the free slots.
+ * @param {uint64_t*} sendNs - Time the last probe was sent in nanoseconds (CLOCK_REALTIME, like pcap timestamps).
+ * @param {uint32_t*} host - Index of the host.
+ * @param {uint32_t*} portIdx - Index of the port in the scan, also its index in the result map.
+ * @param {uint16_t*} port - Port number.
+ * @param {uint8_t*} state - NMAP_SlotState.
+ * @param {uint8_t*} attempts - Number of probes sent.
+ * @param {uint32_t*} index - (host, port) -> slot + 1, 0 when empty, twice the capacity.
+ */
+typedef struct s_probe_slab {
+  uint32_t capacity;
+  uint32_t used;
+  uint32_t* freeSlots;
+  uint64_t* sendNs;
+  uint32_t* host;
+  uint32_t* portIdx;
+  uint16_t* port;
+  uint8_t* state;
+  uint8_t* attempts;
+  uint32_t* index;
+} NMAP_ProbeSlab;
+
+/**
+ * @brief allocate a slab of at least capacity slots in a single block.
+ * @param slab {NMAP_ProbeSlab*} - Slab to initialize.
+ * @param capacity {uint32_t} - Minimum number of slots, rounded up to a power of two.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+int64_t probeSlab_init(NMAP_ProbeSlab* slab, uint32_t capacity);
+
+/**
+ * @brief free the block of a slab.
+ * @param slab {NMAP_ProbeSlab*} - Slab to destroy.
+ */
+void probeSlab_destroy(NMAP_ProbeSlab* slab);
+
+/**
+ * @brief release every slot, between two scan types.
+ * @param slab {NMAP_ProbeSlab*} - Slab to clear.
+ */
+void probeSlab_clear(NMAP_ProbeSlab* slab);
+
+/**
+ * @brief take a slot for a probe about to be sent.
+ * @param slab {NMAP_ProbeSlab*} - Slab.
+ * @param host {uint32_t} - Index of the host.
+ * @param portIdx {uint32_t} - Index of the port in the scan.
+ * @param port {uint16_t} - Port number.
+ * @return {int64_t} - The slot, -1 if the slab is full.
+ */
+int64_t probeSlab_insert(NMAP_ProbeSlab* slab, uint32_t host, uint32_t portIdx, uint16_t port);
+
+/**
+ * @brief find the slot of the probe sent to a port of a host.
+ * @param slab {const NMAP_ProbeSlab*} - Slab.
+ * @param host {uint32_t} - Index of the host.
+ * @param port {uint16_t} - Port number.
+ * @return {int64_t} - The slot, -1 if the probe is not in the slab.
+ */
+int64_t probeSlab_find(const NMAP_ProbeSlab* slab, uint32_t host, uint16_t port);
+
+/**
+ * @brief give a slot back once the result of its probe is recorded.
+ * @param slab {NMAP_ProbeSlab*} - Slab.
+ * @param slot {uint32_t} - Slot to release.
+ */
+void probeSlab_remove(NMAP_ProbeSlab* slab, uint32_t slot);
+
+/**
+ * @brief check whether a probe in flight is older than a timeout, without branching per slot.
+ * @param slab {const NMAP_ProbeSlab*} - Slab.
+ * @param nowNs {uint64_t} - Current time in nanoseconds.
+ * @param timeoutNs {uint64_t} - Timeout in nanoseconds.
+ * @return {bool} - true if at least one probe is older.
+ */
+bool probeSlab_hasExpired(const NMAP_ProbeSlab* slab, uint64_t nowNs, uint64_t timeoutNs);
+
+#endif // PROBE_SLAB_H
@@ -0,0 +1,116 @@
+//
+// Created by loumouli on 4/28/24.
+//
+
+#ifndef RESOLVER_H
+#define RESOLVER_H
+
+#include "ft_nmap.h"
+
+#define RESOLVER_DEFAULT_THREADS 8
+#define RESOLVER_MAX_THREADS 64
+#define RESOLVER_WINDOW 1024 // target specifications read ahead of the generator, their hostnames resolved meanwhile
+#define RESOLVER_MIN_CAPACITY 64
+
+/**
+ * @brief Function resolving a hostname, called by the resolver threads concurrently.
+ * @param name {const char*} - Hostname.
+ * @return {in_addr_t} - Its first IPv4 address, INADDR_NONE if it can not be resolved.
+ */
+typedef in_addr_t NMAP_ResolveFunction(const char* name);
+
+/**
+ * @brief Hostname of the cache, resolved once whatever the number of specifications naming it.
+ * @param {char*} name - Hostname.
+ * @param {in_addr_t} ip - Its address once done, INADDR_NONE if it could not be resolved.
+ * @param {bool} done - true once resolved.
+ */
+typedef struct {
+  char* name;
+  in_addr_t ip;
+  bool done;
+} NMAP_ResolverEntry;
+
+/**
+ * @brief Pool of threads resolving the hostnames of the targets ahead of the generator, so that the scan starts as
+ * soon as the first ones are resolved instead of after all of them. The threads are only started by the first
+ * hostname.
+ * @param {NMAP_ResolveFunction*} resolve - Resolution of a hostname, getaddrinfo unless replaced.
+ * @param {uint32_t} nThreads - Threads to start.
+ * @param {pthread_t*} threads - Threads started.
+ * @param {uint32_t} running - Number of threads started.
+ * @param {pthread_mutex_t} lock - Lock protecting every field below.
+ * @param {pthread_cond_t} queued - Signaled when a hostname is queued or the threads have to stop.
+ * @param {pthread_cond_t} resolved - Signaled when a hostname is resolved.
+ * @param {NMAP_ResolverEntry**} table - Cache of every hostname submitted, open addressing on the hash of the name.
+ * @param {uint64_t} capacity - Slots of table, a power of 2.
+ * @param {uint64_t} count - Hostnames in table, at most half its capacity.
+ * @param {Array<NMAP_ResolverEntry*>} jobs - Hostnames waiting for a thread, in submission order.
+ * @param {uint64_t} nextJob - Index of the next job of jobs.
+ * @param {bool} stop - Set by resolver_destroy.
+ * @param {uint64_t} lookups - Hostnames resolved.
+ * @param {uint64_t} hits - Hostnames submitted again and served by the cache.
+ */
+typedef struct {
+  NMAP_ResolveFunction* resolve;
+  uint32_t nThreads;
+  pthread_t* threads;
+  uint32_t running;
+  pthread_mutex_t lock;
+  pthread_cond_t queued;
+  pthread_cond_t resolved;
+  NMAP_ResolverEntry** table;
+  uint64_t capacity;
+  uint64_t count;
+  Array* jobs;
+  uint64_t nextJob;
+  bool stop;
+  uint64_t lookups;
+  uint64_t hits;
+} NMAP_Resolver;
+
+/**
+ * @brief resolve a hostname with getaddrinfo.
+ * @param name {const char*} - Hostname.
+ * @return {in_addr_t} - Its first IPv4 address, INADDR_NONE if it can not be resolved.
+ */
+in_addr_t resolver_getaddrinfo(const char* name);
+
+/**
+ * @brief create a resolver, its threads are started by the first hostname submitted.
+ * @param resolve {NMAP_ResolveFunction*} - Resolution of a hostname.
+ * @param nThreads {uint32_t} - Threads resolving concurrently, in [1, RESOLVER_MAX_THREADS].
+ * @return {NMAP_Resolver*} - The resolver, NULL on allocation failure.
+ */
+NMAP_Resolver* resolver_create(NMAP_ResolveFunction* resolve, uint32_t nThreads);
+
+/**
+ * @brief stop the threads and free the resolver and its cache.
+ * @param resolver {NMAP_Resolver*} - Resolver (can be NULL).
+ */
+void resolver_destroy(NMAP_Resolver* resolver);
+
+/**
+ * @brief queue a hostname to resolve, unless it is already cached.
+ * @param resolver {NMAP_Resolver*} - Resolver.
+ * @param name {const char*} - Hostname.
+ * @return {int64_t} - 0 if success, -1 on allocation failure.
+ */
+int64_t resolver_submit(NMAP_Resolver* resolver, const char* name);
+
+/**
+ * @brief wait for the address of a hostname, submitting it first if needed.
+ * @param resolver {NMAP_Resolver*} - Resolver.
+ * @param name {const char*} - Hostname.
+ * @return {in_addr_t} - Its address, INADDR_NONE if it can not be resolved (or on allocation failure).
+ */
+in_addr_t resolver_wait(NMAP_Resolver* resolver, const char* name);
+
+/**
+ * @brief print the resolver metrics.
+ * @param resolver {const NMAP_Resolver*} - Resolver.
+ * @param stream {FILE*} - Stream to print to.
+ */
+void resolver_printStats(const NMAP_Resolver* resolver, FILE* stream);
+
+#endif // RESOLVER_H
@@ -0,0 +1,259 @@
+//
+// Created by loumouli on 4/23/24.
+//
+
+#ifndef RESULT_FILE_H
+#define RESULT_FILE_H
+
+#include "ft_nmap.h"
+
+#define RESULT_FILE_MAGIC "NMAPRES"
+#define RESULT_FILE_VERSION 1
+#define RESULT_FILE_BUFFER (1 << 20)
+
+/*
+** Layout of a result file, every section starts on 8 bytes and every integer is in the byte order of the writer:
+**
+**   NMAP_ResultHeader
+**   runs         per host, its ports with a result as runs of consecutive ports sharing a status
+**   hosts        NMAP_ResultHost[hostCount], in scan order
+**   ipIndex      NMAP_ResultIpEntry[hostCount], sorted by address
+**   ports        uint16_t[portCount], the scanned ports sorted
+**   portIndex    NMAP_ResultPortEntry[openPortCount], the ports open on at least one host sorted
+**   postings     uint32_t host indices, the hosts of each entry of portIndex in scan order
+**
+** A run is two varints (7 bits per byte, least significant group first): the gap between the end of the previous
+** run (0 for the first one) and its first port, then (length - 1) << 3 | status, status being the index of its bit
+** in NMAP_PortStatus.
+*/
+
+/**
+ * @brief Header of a result file, at offset 0.
+ * @param {char[8]} magic - RESULT_FILE_MAGIC.
+ * @param {uint32_t} version - RESULT_FILE_VERSION.
+ * @param {uint32_t} scan - Scan types of the scan.
+ * @param {uint64_t} hostCount - Number of hosts.
+ * @param {uint64_t} hostsOffset - Offset of the host table.
+ * @param {uint64_t} ipIndexOffset - Offset of the address index.
+ * @param {uint32_t} portCount - Number of scanned ports.
+ * @param {uint32_t} openPortCount - Number of entries of the port index.
+ * @param {uint64_t} portsOffset - Offset of the scanned ports.
+ * @param {uint64_t} portIndexOffset - Offset of the port index.
+ * @param {uint64_t} postingsOffset - Offset of the postings.
+ * @param {uint64_t} fileSize - Size of the whole file, written last: a file cut short does not match it.
+ */
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t scan;
+  uint64_t hostCount;
+  uint64_t hostsOffset;
+  uint64_t ipIndexOffset;
+  uint32_t portCount;
+  uint32_t openPortCount;
+  uint64_t portsOffset;
+  uint64_t portIndexOffset;
+  uint64_t postingsOffset;
+  uint64_t fileSize;
+} NMAP_ResultHeader;
+
+/**
+ * @brief Entry of the host table.
+ * @param {struct in_addr} ip - IP address of the host.
+ * @param {uint32_t} analyzed - Number of ports with a result.
+ * @param {uint32_t} open - Number of open ports.
+ * @param {uint32_t} runsSize - Size in bytes of the runs of the host.
+ * @param {uint64_t} runsOffset - Offset of the runs of the host.
+ */
+typedef struct {
+  struct in_addr ip;
+  uint32_t analyzed;
+  uint32_t open;
+  uint32_t runsSize;
+  uint64_t runsOffset;
+} NMAP_ResultHost;
+
+/**
+ * @brief Entry of the address index.
+ * @param {uint32_t} ip - IP address of the host, in host byte order so that entries sort numerically.
+ * @param {uint32_t} host - Index of the host in the host table.
+ */
+typedef struct {
+  uint32_t ip;
+  uint32_t host;
+} NMAP_ResultIpEntry;
+
+/**
+ * @brief Entry of the port index.
+ * @param {uint16_t} port - Port open on at least one host.
+ * @param {uint32_t} count - Number of hosts the port is open on.
+ * @param {uint64_t} postings - Index in the postings of the first of those hosts.
+ */
+typedef struct {
+  uint16_t port;
+  uint16_t _padding;
+  uint32_t count;
+  uint64_t postings;
+} NMAP_ResultPortEntry;
+
+/**
+ * @brief Writer of a result file, fed one host at a time in scan order. The runs are written as hosts come, only the
+ * host table and the (port, host) pairs of the open ports stay in memory until resultWriter_close.
+ * @param {FILE*} file - File being written.
+ * @param {NMAP_ResultHeader} header - Header, written last.
+ * @param {const Array<uint16_t>*} ports - Ports of the scan, in result index order.
+ * @param {uint32_t*} byPort - Result indices of the ports, sorted by port.
+ * @param {uint8_t*} runs - Scratch buffer holding the runs of one host.
+ * @param {Array<NMAP_ResultHost>} hosts - Host table.
+ * @param {Array<uint32_t[2]>} open - (port, host) pair of every open port, in scan order.
+ * @param {uint64_t} offset - Offset of the end of the runs written so far.
+ * @param {bool} failed - true once a write failed.
+ */
+typedef struct {
+  FILE* file;
+  NMAP_ResultHeader header;
+  const Array* ports;
+  uint32_t* byPort;
+  uint8_t* runs;
+  Array* hosts;
+  Array* open;
+  uint64_t offset;
+  bool failed;
+} NMAP_ResultWriter;
+
+/**
+ * @brief Result file mapped in memory, queried in place.
+ * @param {const uint8_t*} data - Mapping of the file.
+ * @param {size_t} size - Size of the mapping.
+ * @param {const NMAP_ResultHeader*} header - Header.
+ * @param {const NMAP_ResultHost*} hosts - Host table.
+ * @param {const NMAP_ResultIpEntry*} ipIndex - Address index.
+ * @param {const uint16_t*} ports - Scanned ports, sorted.
+ * @param {const NMAP_ResultPortEntry*} portIndex - Port index.
+ * @param {const uint32_t*} postings - Postings of the port index.
+ */
+typedef struct {
+  const uint8_t* data;
+  size_t size;
+  const NMAP_ResultHeader* header;
+  const NMAP_ResultHost* hosts;
+  const NMAP_ResultIpEntry* ipIndex;
+  const uint16_t* ports;
+  const NMAP_ResultPortEntry* portIndex;
+  const uint32_t* postings;
+} NMAP_ResultFile;
+
+/**
+ * @brief Ports of a host sharing a status.
+ * @param {uint16_t} first - First port of the run.
+ * @param {uint32_t} length - Number of ports of the run.
+ * @param {NMAP_PortStatus} status - Status of every port of the run.
+ */
+typedef struct {
+  uint16_t first;
+  uint32_t length;
+  NMAP_PortStatus status;
+} NMAP_ResultRun;
+
+/**
+ * @brief Cursor over the runs of a host.
+ * @param {const uint8_t*} cursor - Next run.
+ * @param {const uint8_t*} end - End of the runs.
+ * @param {uint32_t} next - Port following the previous run.
+ */
+typedef struct {
+  const uint8_t* cursor;
+  const uint8_t* end;
+  uint32_t next;
+} NMAP_ResultRuns;
+
+/**
+ * @brief sort the ports of a scan.
+ * @param ports {const Array<uint16_t>*} - Ports of the scan, unique, in result index order.
+ * @return {uint32_t*} - Result indices of the ports sorted by port (to free), NULL on allocation failure.
+ */
+uint32_t* resultFile_sortPorts(const Array* ports);
+
+/**
+ * @brief encode the results of a host as runs, the ports without a result are skipped.
+ * @param results {const NMAP_PortMap*} - Results of the host, indexed like ports.
+ * @param ports {const Array<uint16_t>*} - Ports of the scan, in result index order.
+ * @param byPort {const uint32_t*} - Result indices sorted by port, from resultFile_sortPorts.
+ * @param out {uint8_t*} - Buffer of at least 6 bytes per port.
+ * @return {uint32_t} - Size of the runs.
+ */
+uint32_t resultFile_encodeRuns(const NMAP_PortMap* results, const Array* ports, const uint32_t* byPort, uint8_t* out);
+
+/**
+ * @brief create a result file and write its header.
+ * @param writer {NMAP_ResultWriter*} - Writer to initialize.
+ * @param path {const char*} - Path of the file, truncated.
+ * @param ports {const Array<uint16_t>*} - Ports of the scan, in result index order.
+ * @param scan {uint32_t} - Scan types of the scan.
+ * @return {int64_t} - 0 if success, 1 otherwise (the writer must still be closed).
+ */
+int64_t resultWriter_open(NMAP_ResultWriter* writer, const char* path, const Array* ports, uint32_t scan);
+
+/**
+ * @brief append the results of a host.
+ * @param writer {NMAP_ResultWriter*} - Writer.
+ * @param host {const t_host*} - Host, its results indexed like the ports of the writer.
+ */
+void resultWriter_addHost(NMAP_ResultWriter* writer, const t_host* host);
+
+/**
+ * @brief write the tables and the indices, then the header, and free the writer.
+ * @param writer {NMAP_ResultWriter*} - Writer.
+ * @return {int64_t} - 0 if the whole file was written, 1 otherwise.
+ */
+int64_t resultWriter_close(NMAP_ResultWriter* writer);
+
+/**
+ * @brief map a result file and check its header and sections.
+ * @param file {NMAP_ResultFile*} - Mapping to initialize.
+ * @param path {const char*} - Path of the file.
+ * @return {int64_t} - 0 if success, 1 otherwise (an error is printed).
+ */
+int64_t resultFile_map(NMAP_ResultFile* file, const char* path);
+
+/**
+ * @brief unmap a result file.
+ * @param file {NMAP_ResultFile*} - Mapping.
+ */
+void resultFile_unmap(NMAP_ResultFile* file);
+
+/**
+ * @brief find the hosts of an address, by binary search.
+ * @param file {const NMAP_ResultFile*} - Mapping.
+ * @param ip {struct in_addr} - Address.
+ * @param count {uint64_t*} - Set to the number of hosts with this address (a target can be listed twice).
+ * @return {const NMAP_ResultIpEntry*} - First entry of the address index for ip, count entries follow.
+ */
+const NMAP_ResultIpEntry* resultFile_findHost(const NMAP_ResultFile* file, struct in_addr ip, uint64_t* count);
+
+/**
+ * @brief find the hosts a port is open on, by binary search.
+ * @param file {const NMAP_ResultFile*} - Mapping.
+ * @param port {uint16_t} - Port.
+ * @param count {uint32_t*} - Set to the number of hosts.
+ * @return {const uint32_t*} - count indices in the host table, NULL if the port is open nowhere.
+ */
+const uint32_t* resultFile_findPort(const NMAP_ResultFile* file, uint16_t port, uint32_t* count);
+
+/**
+ * @brief start iterating over the runs of a host.
+ * @param file {const NMAP_ResultFile*} - Mapping.
+ * @param host {uint64_t} - Index of the host in the host table.
+ * @return {NMAP_ResultRuns} - Cursor, empty if the runs of the host are out of the file.
+ */
+NMAP_ResultRuns resultFile_runs(const NMAP_ResultFile* file, uint64_t host);
+
+/**
+ * @brief decode the next run of a host (the runs of a file, or from resultFile_encodeRuns).
+ * @param runs {NMAP_ResultRuns*} - Cursor.
+ * @param run {NMAP_ResultRun*} - Set to the run.
+ * @return {bool} - false once every run is decoded, or if the runs are corrupted.
+ */
+bool resultFile_nextRun(NMAP_ResultRuns* runs, NMAP_ResultRun* run);
+
+#endif // RESULT_FILE_H
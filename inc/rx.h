@@ -0,0 +1,89 @@
+//
+// Created by loumouli on 4/17/24.
+//
+
+#ifndef RX_H
+#define RX_H
+
+#include "ft_nmap.h"
+
+#define RX_RING_CAPACITY 4096
+#define RX_POLL_US 10'000
+#define RX_BATCH 64
+
+/**
+ * @brief Reply parsed by the RX stage, everything the TX stage needs to update a port.
+ * @param {struct in_addr} ip - IP address of the target the reply is about, the probed one for an ICMP error.
+ * @param {uint16_t} port - Port the reply is about.
+ * @param {NMAP_PortStatus} result - Status deduced from the reply.
+ * @param {struct timeval} recvTime - Capture timestamp of the reply.
+ */
+typedef struct {
+  struct in_addr ip;
+  uint16_t port;
+  NMAP_PortStatus result;
+  struct timeval recvTime;
+} NMAP_Reply;
+
+/**
+ * @brief RX stage of an ultra_scan: a thread reading the pcap handle while the worker keeps sending.
+ * @param {pthread_t} thread - RX thread, running between rx_start and rx_stop.
+ * @param {pcap_t*} handle - Pcap handle, owned by the RX thread while it runs.
+ * @param {NMAP_ScanType} scanType - Scan type used to analyse the replies.
+ * @param {Ring<NMAP_Reply>} replies - SPSC ring from the RX thread to the worker.
+ * @param {NMAP_PoolSignals*} signals - Counters shared with the elastic pool.
+ * @param {_Atomic bool} stop - Set by rx_stop, the thread exits within RX_POLL_US.
+ * @param {_Atomic bool} failed - Set by the thread if the capture failed.
+ * @param {uint32_t} captureDrops - Packets dropped by the pcap handle, as of the last check.
+ */
+typedef struct {
+  pthread_t thread;
+  pcap_t* handle;
+  NMAP_ScanType scanType;
+  Ring* replies;
+  NMAP_PoolSignals* signals;
+  _Atomic bool stop;
+  _Atomic bool failed;
+  uint32_t captureDrops;
+} NMAP_Rx;
+
+/**
+ * @brief allocate the reply ring of an RX stage.
+ * @param rx {NMAP_Rx*} - RX stage to initialize.
+ * @param handle {pcap_t*} - Pcap handle to read from.
+ * @param signals {NMAP_PoolSignals*} - Counters shared with the elastic pool.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+int64_t rx_init(NMAP_Rx* rx, pcap_t* handle, NMAP_PoolSignals* signals);
+
+/**
+ * @brief free the reply ring of an RX stage, which must be stopped.
+ * @param rx {NMAP_Rx*} - RX stage to destroy.
+ */
+void rx_destroy(NMAP_Rx* rx);
+
+/**
+ * @brief start the RX thread for one scan type.
+ * @param rx {NMAP_Rx*} - RX stage, stopped.
+ * @param scanType {NMAP_ScanType} - Scan type used to analyse the replies.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+int64_t rx_start(NMAP_Rx* rx, NMAP_ScanType scanType);
+
+/**
+ * @brief stop and join the RX thread, the replies already queued stay in the ring.
+ * @param rx {NMAP_Rx*} - RX stage, started.
+ */
+void rx_stop(NMAP_Rx* rx);
+
+/**
+ * @brief parse a captured packet.
+ * @param scanType {NMAP_ScanType} - Scan type used to analyse the reply.
+ * @param head {const struct pcap_pkthdr*} - Capture header.
+ * @param packet {const uint8_t*} - Captured bytes, starting with the ethernet header.
+ * @param reply {NMAP_Reply*} - Parsed reply.
+ * @return {bool} - true if the packet is a reply to one of our probes, false otherwise.
+ */
+bool rx_parse(NMAP_ScanType scanType, const struct pcap_pkthdr* head, const uint8_t* packet, NMAP_Reply* reply);
+
+#endif // RX_H
@@ -0,0 +1,54 @@
+//
+// Created by loumouli on 4/26/24.
+//
+
+#ifndef SERVICES_H
+#define SERVICES_H
+
+#include "ft_nmap.h"
+
+/**
+ * @brief Entry of the services table.
+ * @param {uint16_t} port - TCP port of the service.
+ * @param {float} frequency - Fraction of the hosts of an Internet-wide scan the port was found open on.
+ * @param {const char*} name - Name of the service.
+ */
+typedef struct {
+  uint16_t port;
+  float frequency;
+  const char* name;
+} NMAP_Service;
+
+/**
+ * @brief get the services table compiled in the binary, sorted by decreasing frequency.
+ * @param count {size_t*} - Set to the number of services.
+ * @return {const NMAP_Service*} - The table.
+ */
+const NMAP_Service* services_table(size_t* count);
+
+/**
+ * @brief add the most frequently open ports: the ports of the services table by decreasing frequency, then the other
+ * ports in numeric order.
+ * @param ports {NMAP_PortSet*} - Port set, empty.
+ * @param count {uint32_t} - Number of ports, at most UINT16_MAX + 1 (less if ports are excluded).
+ * @param excluded {const NMAP_PortSet*} - Ports never added, the next ones are taken instead.
+ */
+void services_topPorts(NMAP_PortSet* ports, uint32_t count, const NMAP_PortSet* excluded);
+
+/**
+ * @brief add the ports of the services table open at least as often as ratio.
+ * @param ports {NMAP_PortSet*} - Port set.
+ * @param ratio {double} - Minimum frequency, in [0, 1].
+ */
+void services_portRatio(NMAP_PortSet* ports, double ratio);
+
+/**
+ * @brief list the ports of a set by decreasing frequency, so that the most valuable results come first. The ports
+ * out of the services table come last, in numeric order.
+ * @param ports {const NMAP_PortSet*} - Port set.
+ * @param list {Array<uint16_t>*} - Set to the ordered port list.
+ * @return {int64_t} - 0 if success, 1 on allocation failure.
+ */
+int64_t services_sortPorts(const NMAP_PortSet* ports, Array* list);
+
+#endif // SERVICES_H
@@ -7,46 +7,65 @@
 
 #include "ft_nmap.h"
 
-typedef enum { PROBE_PENDING = 0, PROBE_SENT = 1 << 0, PROBE_RECV = 1 << 1, PROBE_TIMEOUT = 1 << 2 } NMAP_ProbeStatus;
-
-/**
- * @brief Structure storing all the info needed for a port.
- * @param {uint16_t} port - Port number.
- * @param {NMAP_PortStatus} result - Result of the scan.
- * @param {ProbeStatus} probeStatus - Status of the current probe.
- * @param {struct timeval} sendTime - Time when the probe was sent.
- * @param {struct timeval} recvTime - Time when the probe was received.
- * @param {uint64_t} nprobes_sent - Number of probes sent.
- * @param {uint64_t} _padding - Padding to align the structure on a 64 bits boundary.
- */
-typedef struct s_port {
-  uint16_t port;
-  NMAP_PortStatus result;
-  NMAP_ProbeStatus probeStatus;
-  struct timeval sendTime;
-  struct timeval recvTime;
-  uint32_t nprobes_sent;
-  unused uint8_t _padding[18];
-} __attribute__((packed)) t_port;
-
 /**
  * @brief Structure to store all the information needed for ultra_scan engine.
  * @param {struct in_addr} ip - IP address of the host.
- * @param {Array<t_port>} incompletePorts - Vector of ports to scan.
- * @param {uint16_t} idx_ports - Index of the next port to scan.
+ * @param {uint32_t} idx_ports - Position of the next port to probe for the first time in the probe order, the ports
+ * after it are pending.
+ * @param {uint32_t} portEnd - End of the probe order: the ports of the chunk of a view, walked twice when the host has
+ * a baseline (the ports open in the baseline, then the others).
+ * @param {uint32_t} inSlab - Probes of the host in the probe slab: in flight or waiting to be sent again.
  * @param {bool} done - True if all the ports have been scanned.
- * @param {uint8_t} _padding - Padding to align the struc on a 32 bits boundary.
+ * @param {NMAP_HostTiming*} timing - Timing and congestion state shared with the other workers.
+ * @param {NMAP_PortMap} results - Status of every port of the scan once scanned. The maps of a result store are laid
+ * out in a single block owned by its first host, the views of the workers share them.
+ * @param {NMAP_PortMap} baseline - Status of every port of the scan in the baseline, laid out in the block of the
+ * results after them. No words when the scan has no baseline or the host is not in it.
+ * @param {uint8_t} _padding - Padding to align the struc on a 64 bits boundary.
  */
 typedef struct s_host {
   struct in_addr ip;
-  Array* ports;
-  uint16_t idx_ports;
+  uint32_t idx_ports;
+  uint32_t portEnd;
+  uint32_t inSlab;
   uint16_t done;
-  unused uint8_t _padding[16];
+  NMAP_HostTiming* timing;
+  NMAP_PortMap results;
+  NMAP_PortMap baseline;
+  unused uint8_t _padding[6];
 } __attribute__((packed)) t_host;
 
 bool host_hasPortPendingLeft(const t_host* host);
 bool host_hasPortLeft(const t_host* host);
-t_port* host_nextIncPort(t_host* host);
+void host_resetPorts(t_host* host);
+
+/**
+ * @brief record the result of a port for the current scan type, concurrently with the other workers of the group.
+ * @param host {t_host*} - Host of the port.
+ * @param idx {uint32_t} - Index of the port in the scan.
+ * @param result {NMAP_PortStatus} - Result of the scan type.
+ */
+void host_foldResult(t_host* host, uint32_t idx, NMAP_PortStatus result);
+
+/**
+ * @brief create the result store of a group: one host per ip with an empty result map of nPorts ports, all the maps
+ * in a single block.
+ * @param ips {const Array<struct in_addr>*} - Targets.
+ * @param timings {Array<NMAP_HostTiming>} - Shared timing of every ip, in the same order.
+ * @param nPorts {uint32_t} - Number of ports of each map.
+ * @param baseline {bool} - Also lay out an empty baseline map per host.
+ * @return {Array<t_host>} - The hosts (free them with host_destroyArray), NULL on allocation failure.
+ */
+Array* host_createArray(const Array* ips, Array* timings, uint32_t nPorts, bool baseline);
+void host_destroyArray(Array* hosts);
+
+/**
+ * @brief create the hosts a worker scans a chunk of a group with: their cursors are their own, their timing, result
+ * and baseline maps are the ones of the store.
+ * @param store {const Array<t_host>*} - Result store of the group.
+ * @param nPorts {uint32_t} - Number of ports of the chunk.
+ * @return {Array<t_host>} - The views (free them with array_destroy), NULL on allocation failure.
+ */
+Array* host_createViews(const Array* store, uint32_t nPorts);
 
 #endif // t_host_H
@@ -0,0 +1,229 @@
+//
+// Created by loumouli on 4/21/24.
+//
+
+#ifndef TARGETS_H
+#define TARGETS_H
+
+#include "ft_nmap.h"
+
+#define TARGETS_SEEN_MIN_CAPACITY 1024
+
+/* Intervals of the walked ranges buffered before they are merged into the sorted list, and most intervals of a range */
+#define TARGETS_PENDING_RUNS 256
+
+/**
+ * @brief Addresses of one target specification, the cartesian product of an inclusive range per octet. CIDR blocks,
+ * dash ranges and wildcards all fit in it.
+ * @param {uint8_t[4]} lo - First value of each octet, most significant first.
+ * @param {uint8_t[4]} hi - Last value of each octet.
+ */
+typedef struct s_nmap_target_range {
+  uint8_t lo[4];
+  uint8_t hi[4];
+} NMAP_TargetRange;
+
+/**
+ * @brief Where targets come from, in the order of the command line.
+ * @param {char*} spec - Target specification, or path of the file ("-" for the standard input).
+ * @param {FILE*} file - File to stream specifications from, one per line. NULL for a command line specification and
+ * for a mapped file.
+ * @param {char*} data - Mapping of a regular file of specifications, NULL otherwise.
+ * @param {size_t} size - Size of data.
+ */
+typedef struct s_nmap_target_source {
+  char* spec;
+  FILE* file;
+  char* data;
+  size_t size;
+} NMAP_TargetSource;
+
+/**
+ * @brief Specification of the window, parsed when it is read unless it names a host.
+ * @param {NMAP_TargetRange} range - Addresses of the specification, when spec is NULL.
+ * @param {char*} spec - Specification left to parse once the generator reaches it: a hostname, resolved meanwhile,
+ * or an invalid specification, reported then. NULL for addresses and ranges.
+ */
+typedef struct s_nmap_target_entry {
+  NMAP_TargetRange range;
+  char* spec;
+} NMAP_TargetEntry;
+
+/**
+ * @brief Lazy generator of the scan targets: a specification is only generated once the previous one is exhausted,
+ * and files are read one line at a time, a window of RESOLVER_WINDOW specifications ahead. Regular files are mapped
+ * and their plain addresses parsed in place without any allocation, the hostnames of the window are resolved by the
+ * resolver threads meanwhile. An address listed again, by the same specification or by overlapping ones, is skipped:
+ * the single addresses are kept in a hash set and the walked ranges as merged intervals, the only state growing with
+ * the number of specifications. It is not thread safe, the worker pool pulls from it under its lock.
+ * @param {Array<NMAP_TargetSource>} sources - Sources, in order.
+ * @param {uint64_t} nextSource - Index of the next source to open.
+ * @param {FILE*} stream - File being streamed, NULL between files.
+ * @param {char*} line - Line buffer of stream.
+ * @param {size_t} lineSize - Size of line.
+ * @param {const char*} cursor - Next line of the mapped file being read, NULL between files.
+ * @param {const char*} end - End of the mapped file being read.
+ * @param {Ring<NMAP_TargetEntry>} window - Specifications read ahead, in order.
+ * @param {bool} sourcesRead - true once every specification of the sources is in the window or consumed.
+ * @param {NMAP_Resolver*} resolver - Resolver of the hostnames of the window.
+ * @param {NMAP_TargetRange} range - Range being generated.
+ * @param {uint64_t} size - Number of addresses of range.
+ * @param {uint64_t} position - Position in range of the next address, before permutation.
+ * @param {NMAP_Permutation} order - Order of the addresses of range (identity unless randomized).
+ * @param {bool} randomize - Walk every range in a pseudo-random order.
+ * @param {uint64_t} seed - Seed of the order, each range gets its own permutation from it.
+ * @param {uint64_t} ranges - Number of ranges loaded so far.
+ * @param {uint32_t} shard - Shard of the targets to generate, in [0, shards).
+ * @param {uint32_t} shards - Number of shards the targets are split in, 1 to generate them all.
+ * @param {uint64_t} walked - Addresses walked so far, those of the other shards included.
+ * @param {bool} active - true while range has addresses left.
+ * @param {bool} exhausted - true once every source has been consumed.
+ * @param {uint64_t} generated - Number of addresses generated so far.
+ * @param {in_addr_t*} seen - Addresses of the single address specifications loaded so far, open addressing on their
+ * hash, 0 for an empty slot.
+ * @param {uint64_t} seenCapacity - Slots of seen, a power of 2.
+ * @param {uint64_t} seenCount - Addresses in seen, at most three quarters of its capacity.
+ * @param {bool} seenZero - 0.0.0.0 was loaded, it can not be stored in seen.
+ * @param {NMAP_Exclusions*} covered - Addresses of the ranges walked so far, but those still in pending.
+ * @param {NMAP_Interval[]} pending - Intervals of the last ranges walked, not merged into covered yet.
+ * @param {uint32_t} pendingCount - Intervals in pending.
+ * @param {Array<NMAP_TargetRange>} sparse - Ranges walked so far made of too many intervals for covered
+ * (192.168.*.1), matched octet by octet.
+ * @param {bool} record - range was loaded and has to be recorded once walked.
+ * @param {bool} dedupe - range may hold addresses already generated, each of its addresses is looked up.
+ * @param {NMAP_Exclusions*} exclusions - Addresses never generated, NULL if none.
+ * @param {bool} filter - range crosses the exclusions, each of its addresses is looked up.
+ */
+struct s_nmap_targets {
+  Array* sources;
+  uint64_t nextSource;
+  FILE* stream;
+  char* line;
+  size_t lineSize;
+  const char* cursor;
+  const char* end;
+  Ring* window;
+  bool sourcesRead;
+  NMAP_Resolver* resolver;
+  NMAP_TargetRange range;
+  uint64_t size;
+  uint64_t position;
+  NMAP_Permutation order;
+  bool randomize;
+  uint64_t seed;
+  uint64_t ranges;
+  uint32_t shard;
+  uint32_t shards;
+  uint64_t walked;
+  bool active;
+  bool exhausted;
+  uint64_t generated;
+  in_addr_t* seen;
+  uint64_t seenCapacity;
+  uint64_t seenCount;
+  bool seenZero;
+  NMAP_Exclusions* covered;
+  NMAP_Interval pending[TARGETS_PENDING_RUNS];
+  uint32_t pendingCount;
+  Array* sparse;
+  bool record;
+  bool dedupe;
+  NMAP_Exclusions* exclusions;
+  bool filter;
+};
+
+/**
+ * @brief create a generator without any source.
+ * @return {NMAP_Targets*} - The generator, NULL on allocation failure.
+ */
+NMAP_Targets* targets_create(void);
+
+/**
+ * @brief close every file and free the generator.
+ * @param targets {NMAP_Targets*} - Generator (can be NULL).
+ */
+void targets_destroy(NMAP_Targets* targets);
+
+/**
+ * @brief add a target specification: an address or hostname with an optional /bits prefix length
+ * (10.0.0.0/8, scanme.org/24), or octet ranges (10.0.0-3.1-254, 192.168.*.1, 10.0.0.-100).
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param spec {const char*} - Specification, checked now but only resolved when the generator reaches it.
+ * @return {int64_t} - 0 if success, 1 if the specification is invalid, -1 on allocation failure.
+ */
+int64_t targets_addSpec(NMAP_Targets* targets, const char* spec);
+
+/**
+ * @brief add a file of target specifications, one per line (empty lines and lines starting with # are skipped). A
+ * regular file is mapped now, and read as the generator reaches it.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param path {const char*} - Path of the file, "-" for the standard input.
+ * @return {int64_t} - 0 if success, 1 otherwise (errno is set).
+ */
+int64_t targets_addFile(NMAP_Targets* targets, const char* path);
+
+/**
+ * @brief exclude the addresses of a target specification (hostnames are resolved now), whatever the sources they are
+ * listed in.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param spec {const char*} - Specification.
+ * @return {int64_t} - 0 if success, 1 if the specification is invalid, 2 if its hostname can not be resolved, -1 on
+ * allocation failure.
+ */
+int64_t targets_addExclude(NMAP_Targets* targets, const char* spec);
+
+/**
+ * @brief exclude the addresses of a file of target specifications, one per line (empty lines and lines starting
+ * with # are skipped).
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param path {const char*} - Path of the file.
+ * @return {int64_t} - 0 if success, 1 if a line is invalid or can not be resolved (it is reported), -1 if the file
+ * can not be read (errno is set) or on allocation failure.
+ */
+int64_t targets_addExcludeFile(NMAP_Targets* targets, const char* path);
+
+/**
+ * @brief set the order of the targets, before the first address is generated.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param randomize {bool} - Walk every range in a pseudo-random order.
+ * @param seed {uint64_t} - Seed of the order.
+ * @param shard {uint32_t} - Shard to generate, in [0, shards): the addresses whose position in the whole walk is
+ * shard modulo shards. Every shard of the same targets and seed is disjoint from the others.
+ * @param shards {uint32_t} - Number of shards, 1 to generate every target.
+ */
+void targets_setOrder(NMAP_Targets* targets, bool randomize, uint64_t seed, uint32_t shard, uint32_t shards);
+
+/**
+ * @brief set how the hostnames are resolved, before the first address is generated.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param resolve {NMAP_ResolveFunction*} - Resolution of a hostname (resolver_getaddrinfo by default).
+ * @param nThreads {uint32_t} - Hostnames resolved concurrently, in [1, RESOLVER_MAX_THREADS].
+ */
+void targets_setResolver(NMAP_Targets* targets, NMAP_ResolveFunction* resolve, uint32_t nThreads);
+
+/**
+ * @brief check whether a generator has no source.
+ * @param targets {const NMAP_Targets*} - Generator.
+ * @return {bool} - true if no source was added.
+ */
+bool targets_empty(const NMAP_Targets* targets);
+
+/**
+ * @brief generate the next addresses. An invalid or unresolvable specification met on the way is reported and skipped,
+ * an address already generated and an excluded address are skipped silently.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param ips {in_addr_t*} - Buffer of at least count addresses.
+ * @param count {uint64_t} - Maximum number of addresses to generate.
+ * @return {uint64_t} - Number of addresses generated, less than count only once the generator is exhausted.
+ */
+uint64_t targets_next(NMAP_Targets* targets, in_addr_t* ips, uint64_t count);
+
+/**
+ * @brief skip the next addresses, as if they were generated.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param count {uint64_t} - Number of addresses to skip.
+ * @return {uint64_t} - Number of addresses skipped, less than count only once the generator is exhausted.
+ */
+uint64_t targets_skip(NMAP_Targets* targets, uint64_t count);
+
+#endif // TARGETS_H
@@ -9,35 +9,67 @@
 #define TIMEVAL_SUBTRACT(a, b) (((a).tv_sec - (b).tv_sec) * 1000000 + (a).tv_usec - (b).tv_usec)
 #define TIMEVAL_TO_MICROSC(a) ((a).tv_sec * 1000000 + (a).tv_usec)
 
+/* Sleep of the TX loop when it has nothing to send and no reply to process */
+#define US_IDLE_US 200
+
+/* Probes sent to a port closed or filtered in the baseline before it is deemed filtered */
+#define US_BASELINE_RETRIES 2
+
+/* Probes sent to a UDP port before it is deemed open|filtered: most UDP ports never reply, whatever their state */
+#define US_UDP_MAX_RETRIES 2
+
 /**
  * @brief Structure to store all the information needed for ultra_scan engine.
+ * @param {NMAP_Engine*} engine - Process-wide engine the handle and socket are borrowed from.
  * @param {pcap_t*} handle - Pcap handle.
  * @param {struct in_addr} inter_ip - IP address of the interface used for pcap handle.
  * @param {int32_t} sock - raw socket file descriptor.
- * @param {Array<t_host>} hosts - Vector of hosts to scan.
+ * @param {int32_t} udpSock - raw UDP socket file descriptor, -1 unless UDP is scanned.
+ * @param {Array<t_host>} hosts - Views of the hosts to scan on the result store of the group.
+ * @param {const uint16_t*} ports - Port numbers, shared by every host.
+ * @param {NMAP_Permutation} portOrder - Order the ports are probed in, each host starts at its own position.
+ * @param {const NMAP_Permutation*} resultOrder - Order of the ports of the whole scan, maps a port to its result index.
+ * @param {uint32_t} portOffset - Position of the first port of the chunk in resultOrder.
+ * @param {NMAP_ProbeSlab} slab - State of the probes in flight or waiting to be sent again.
+ * @param {uint32_t} retries - Probes of the slab waiting to be sent again.
  * @param {uint64_t} idxNextHost - Index of the next host to scan.
  * @param {NMAPP_ScanType} scanType - Type of scan to perform
- * @param {double} srtt - Smoothed Round-Trip Time in microseconds.
- * @param {double} rttvar - Round-Trip Time Variance in microseconds.
- * @param {double} timeout - Timeout for a probe in microseconds.
- * @param {double} maxTimeout - Maximum timeout for a probe in microseconds.
- * @param {double} minTimeout - Minimum timeout for a probe in microseconds.
+ * @param {NMAP_HostTable*} hostTable - Per-host timing and congestion state shared by all workers.
+ * @param {NMAP_Credits*} credits - Global budget of probes in flight shared by all workers.
+ * @param {NMAP_PoolSignals*} signals - Counters read by the elastic pool controller.
+ * @param {NMAP_Rx} rx - RX stage reading the pcap handle concurrently with the sends.
+ * @param {struct timeval} stallStart - Time the worker ran out of credits, zero when it is not stalled.
+ * @param {double} timeout - Timeout of the last host that replied.
  * @param {uint64_t} maxRetries - Maximum number of retries for a probe.
+ * @param {uint64_t} baselineRetries - Maximum number of retries for a probe to a port closed or filtered in the
+ * baseline.
+ * @param {uint64_t} udpMaxRetries - Maximum number of retries for a UDP probe.
  * @param {struct timeval} now - Current time.
  */
 typedef struct {
+  NMAP_Engine* engine;
   pcap_t* handle;
   struct in_addr inter_ip;
   int32_t sock;
+  int32_t udpSock;
   Array* hosts;
+  const uint16_t* ports;
+  NMAP_Permutation portOrder;
+  const NMAP_Permutation* resultOrder;
+  uint32_t portOffset;
+  NMAP_ProbeSlab slab;
+  uint32_t retries;
   uint64_t idxNextHosts;
   NMAP_ScanType scanType;
-  long double srtt;
-  long double rttvar;
+  NMAP_HostTable* hostTable;
+  NMAP_Credits* credits;
+  NMAP_PoolSignals* signals;
+  NMAP_Rx rx;
+  struct timeval stallStart;
   long double timeout;
-  double maxTimeout;
-  double minTimeout;
   uint64_t maxRetries;
+  uint64_t baselineRetries;
+  uint64_t udpMaxRetries;
   struct timeval now;
   uint64_t packet_recv;
   uint64_t packet_sent;
@@ -46,48 +78,53 @@ typedef struct {
 } NMAP_UltraScan;
 
 /**
- * @brief update the SRTT of the NMAP_UltraScan structure based on the probe received.
- * @param us {NMAP_UltraScan*} - NMAP_UltraScan struc
- * @param port {const t_port*} - Probe recieved to update the SRTT
+ * @brief update the shared timing of a host based on the probe received.
+ * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param host {const t_host*} - Host that replied.
+ * @param slot {uint32_t} - Slot of the probe that got a reply.
+ * @param recvTime {struct timeval} - Capture time of the reply.
  */
-void us_updateSRTT(NMAP_UltraScan* us, const t_port* port);
-
+void us_updateTimeout(NMAP_UltraScan* us, const t_host* host, uint32_t slot, struct timeval recvTime);
 
 /**
- * @brief update the RTTVAR of the NMAP_UltraScan structure based on the probe received.
- * @param us {NMAP_UltraScan*} - NMAP_UltraScan struc
- * @param port {const t_port*} - Probe recieved to update the RTTVAR
+ * @brief init NMAP_UltraScan structure to default value.
+ * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure to initialize.
  */
-void us_updateRTTVAR(NMAP_UltraScan* us, const t_port* port);
+void us_default_init(NMAP_UltraScan* us);
 
 /**
- * @brief update the timeout of the NMAP_UltraScan structure based on the SRTT and RTTVAR.
- * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
- * @param port {const t_port*} - Probe received to update the timeout.
+ * @brief index of the port a host probes at a given position of its scan.
+ * @param us {const NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param hostIdx {uint32_t} - Index of the host.
+ * @param position {uint32_t} - Position in the port order of the chunk (the idx_ports cursor of the host, modulo the
+ * number of ports).
+ * @return {uint32_t} - Index of the port in us->ports and in the result map of the host.
  */
-void us_updateTimeout(NMAP_UltraScan* us, const t_port* port);
+uint32_t us_portIndex(const NMAP_UltraScan* us, uint32_t hostIdx, uint32_t position);
 
 /**
- * @brief init NMAP_UltraScan structure to default value.
- * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure to initialize.
+ * @brief index in the result store of a port of the chunk.
+ * @param us {const NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param portIdx {uint32_t} - Index of the port in us->ports.
+ * @return {uint32_t} - Index of the port in the result maps.
  */
-void us_default_init(NMAP_UltraScan* us);
+uint32_t us_resultIndex(const NMAP_UltraScan* us, uint32_t portIdx);
 
 /**
- * @brief create host vectors based on input ips and ports.
+ * @brief create the views of the hosts to scan and the probe slab.
  * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure to initialize.
- * @param ips  {Array<struct addr_in>} - Vector of IP addresses to filter.
- * @param ports {Array<uint16_t>} - Vector of ports to scan.
+ * @param options {const NMAP_WorkerOptions*} - Result store, ports and port order of the chunk.
  * @return {int64_t} - 0 if success, 1 otherwise.
  */
-int64_t us_createHost(NMAP_UltraScan* us, const Array* ips, const Array* ports);
+int64_t us_createHost(NMAP_UltraScan* us, const NMAP_WorkerOptions* options);
 
 /**
- * @brief init_sniffer and apply filter to the sniffer.
- * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure
- * @return {int64_t} - 0 if success, 1 otherwise.
+ * @brief move the cursor of a host with a baseline to the next port of its current pass: the ports open in the
+ * baseline are probed first to confirm them, then the others.
+ * @param us {const NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param host {t_host*} - Host, one of us->hosts.
  */
-int64_t init_sniffer(NMAP_UltraScan* us);
+void us_skipPorts(const NMAP_UltraScan* us, t_host* host);
 
 /**
  * @brief return the next host to scan and increment the nextIter.
@@ -100,7 +137,7 @@ t_host* us_nextHost(NMAP_UltraScan* us);
  * @brief send a probe to the next port of a given host
  * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
  * @param host {t_host*} - Host to send the probe to.
- * @return {int64_t} - 0 if success, 1 otherwise.
+ * @return {int64_t} - 0 if success, -1 if the probe has to wait (full slab, no credit or full send queue), 1 on error.
  */
 int64_t sendNextScanProbe(NMAP_UltraScan* us, t_host* host);
 
@@ -120,34 +157,22 @@ int64_t doAnyNewProbe(NMAP_UltraScan* us);
 int64_t pcap_poll(pcap_t* p, int64_t to_usec);
 
 /**
- * @brief read a packet from the pcap handle with a timeout.
- * @param handle {pcap_t*} - pcap handle
- * @param to_usec {long} - timeout in microseconds
- * @param packet {const uint8_t**} - pointer to a uint8_t pointer
- * @param head {struct pcap_pkthdr**} - pointer to a pcap header
- * @param rcvdtime  {struct timeval*} - time when the packet was received
- * @return {int64_t} - 0 if success, 1 otherwise.
- */
-int64_t read_reply_pcap(pcap_t* handle, int64_t to_usec, const uint8_t** packet, struct pcap_pkthdr** head,
-                        struct timeval* rcvdtime);
-
-/**
- * @brief grap a packet from the pcap handle and process it.
+ * @brief update the port a reply is about.
  * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
- * @param stime {struct timeval*} - start time.
- * @return {bool} - true if there is a result, false otherwise.
+ * @param reply {const NMAP_Reply*} - Reply parsed by the RX stage.
  */
-bool get_pcap_result(NMAP_UltraScan* us, const struct timeval* stime);
+void us_applyReply(NMAP_UltraScan* us, const NMAP_Reply* reply);
 
 /**
- * @brief recv and process packet until there is no more packet to process or timeout.
+ * @brief apply every reply queued by the RX stage, without waiting.
  * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @return {uint64_t} - Number of replies applied.
  */
-void waitForResponses(NMAP_UltraScan* us);
+uint64_t us_drainReplies(NMAP_UltraScan* us);
 
 /**
  * @brief - Handle timeout for sent probe and check the number of retries
  * @param us {NMAP_Ultrascan*} - UltraScan structure
  */
-void doAnyOustandingRetransmit(NMAP_UltraScan* us);
+int64_t doAnyOustandingRetransmit(NMAP_UltraScan* us);
 #endif // ULTRA_SCAN_H
@@ -0,0 +1,151 @@
+/**
+ * @brief This variable represents a bounded lock-free ring buffer.
+ *
+ * It moves fixed-size elements from one (SPSC) or many (MPSC) producer threads
+ * to a single consumer thread without any lock.
+ * The capacity is fixed at creation and rounded up to a power of two.
+ */
+#ifndef RING_H
+#define RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RING_CACHE_LINE 64
+
+typedef struct s_ring Ring;
+
+typedef enum e_ring_mode {
+  // One producer thread, one consumer thread
+  RING_SPSC = 0,
+
+  // Any number of producer threads, one consumer thread
+  RING_MPSC = 1,
+} RingMode;
+
+#if defined RING_IMPL || defined RING_USE_IMPL
+
+# include <assert.h>
+# include <stdatomic.h>
+# include <stdlib.h>
+# include <string.h>
+# include "tools.h"
+
+void* ring_slot(const Ring* ring, size_t pos);
+
+# ifdef RING_IMPL
+
+/*
+** `head` is only written by producers and `tail` only by the consumer, each
+** one sits on its own cache line with the side-local cached copy of the other
+** index so that the fast path never touches a line owned by the other side.
+*/
+struct s_ring {
+  _Alignas(RING_CACHE_LINE) _Atomic size_t head;
+  size_t cachedTail;
+
+  _Alignas(RING_CACHE_LINE) _Atomic size_t tail;
+  size_t cachedHead;
+
+  _Alignas(RING_CACHE_LINE) size_t dataSize;
+  size_t capacity;
+  size_t mask;
+  RingMode mode;
+  _Atomic size_t* seq;
+  uint8_t* data;
+};
+
+# endif
+
+#endif
+
+/*
+** Create a new ring buffer.
+**
+** @param dataSize The size (in bytes) of a single element.
+** @param capacity The minimum number of elements the ring can hold (rounded up
+**                 to the next power of two).
+** @param mode `RING_SPSC` or `RING_MPSC`.
+**
+** @return The new ring (don't forget to free it with `ring_destroy`), or
+**         `NULL` in case of failure (`errno` is set by the allocator).
+*/
+Ring* ring(size_t dataSize, size_t capacity, RingMode mode);
+
+/*
+** Destroy a ring buffer.
+**
+** @param ring The ring to destroy.
+**
+** @note No thread may use the ring during or after this call.
+*/
+void ring_destroy(Ring* ring);
+
+/*
+** Push up to `count` elements at the back of the ring.
+**
+** @param ring The ring.
+** @param values A pointer to `count` contiguous elements.
+** @param count The number of elements to push.
+**
+** @return The number of elements actually pushed (`0` if the ring is full).
+**
+** @note Never blocks, a partial push leaves the remaining elements to the
+**       caller.
+** @note In `RING_SPSC` mode, only one thread may push at a time.
+*/
+size_t ring_push(Ring* ring, const void* values, size_t count);
+
+/*
+** Pop up to `count` elements from the front of the ring.
+**
+** @param ring The ring.
+** @param values A buffer of at least `count` elements.
+** @param count The maximum number of elements to pop.
+**
+** @return The number of elements actually popped (`0` if the ring is empty).
+**
+** @note Never blocks, only one thread may pop at a time.
+*/
+size_t ring_pop(Ring* ring, void* values, size_t count);
+
+/*
+** Get the number of elements currently stored in the ring.
+**
+** @param ring The ring.
+**
+** @return A snapshot of the number of elements, which may already be stale
+**         when other threads are pushing or popping.
+*/
+size_t ring_size(const Ring* ring);
+
+/*
+** Check if the ring is empty.
+**
+** @param ring The ring.
+**
+** @return `true` if the ring is empty, `false` otherwise (same caveat as
+**         `ring_size`).
+*/
+bool ring_empty(const Ring* ring);
+
+/*
+** Get the capacity of the ring.
+**
+** @param ring The ring.
+**
+** @return The number of elements the ring can hold.
+*/
+size_t ring_capacity(const Ring* ring);
+
+/*
+** Get the size of a single element in the ring.
+**
+** @param ring The ring.
+**
+** @return The size (in bytes) of a single element.
+*/
+size_t ring_dataSize(const Ring* ring);
+
+#endif
@@ -0,0 +1,69 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "inc/ring.h"
+
+#define BENCH_ITEMS 50000000ULL
+#define BENCH_CAPACITY 4096
+
+typedef struct {
+  Ring * ring;
+  uint64_t count;
+  size_t batch;
+} BenchParam;
+
+static double now(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void * producerMain(void * arg) {
+  const BenchParam * param = arg;
+  uint64_t values[256] = {0};
+
+  for (uint64_t sent = 0; sent < param->count;) {
+    const size_t want = param->count - sent < param->batch ? param->count - sent : param->batch;
+
+    sent += ring_push(param->ring, values, want);
+  }
+  return NULL;
+}
+
+static void bench(const char * name, RingMode mode, size_t producers, size_t batch) {
+  Ring * r = ring(sizeof(uint64_t), BENCH_CAPACITY, mode);
+  pthread_t threads[8];
+  BenchParam param = {.ring = r, .count = BENCH_ITEMS / producers, .batch = batch};
+  uint64_t values[256];
+  uint64_t received = 0;
+
+  if (r == NULL) {
+    perror("ring");
+    return;
+  }
+  const double start = now();
+  for (size_t i = 0; i < producers; ++i)
+    pthread_create(threads + i, NULL, producerMain, &param);
+  while (received < param.count * producers)
+    received += ring_pop(r, values, batch);
+  for (size_t i = 0; i < producers; ++i)
+    pthread_join(threads[i], NULL);
+  const double elapsed = now() - start;
+
+  printf("%-5s producers=%zu batch=%-3zu %8.2f Mitems/s\n", name, producers, batch, received / elapsed / 1e6);
+  ring_destroy(r);
+}
+
+int main(void) {
+  const size_t batches[] = {1, 16, 256};
+
+  for (size_t i = 0; i < sizeof(batches) / sizeof(*batches); ++i)
+    bench("SPSC", RING_SPSC, 1, batches[i]);
+  for (size_t i = 0; i < sizeof(batches) / sizeof(*batches); ++i) {
+    bench("MPSC", RING_MPSC, 1, batches[i]);
+    bench("MPSC", RING_MPSC, 4, batches[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,145 @@
+#include <pthread.h>
+#include <stdio.h>
+
+#include "inc/ring.h"
+#include <criterion/criterion.h>
+#include <criterion/new/assert.h>
+
+#define STRESS_ITEMS 2000000
+#define STRESS_PRODUCERS 4
+
+TestSuite(ring);
+
+Test(ring, constructor_destructor) {
+  Ring * r = ring(sizeof(int), 5, RING_SPSC);
+
+  cr_assert(ne(ptr, r, NULL));
+  cr_assert(eq(sz, ring_capacity(r), 8));
+  cr_assert(eq(sz, ring_dataSize(r), sizeof(int)));
+  cr_assert(eq(sz, ring_size(r), 0));
+  cr_assert(ring_empty(r));
+  ring_destroy(r);
+
+  r = ring(sizeof(int), 16, RING_MPSC);
+  cr_assert(ne(ptr, r, NULL));
+  cr_assert(eq(sz, ring_capacity(r), 16));
+  ring_destroy(r);
+}
+
+static void pushPopRoundTrip(RingMode mode) {
+  Ring * r = ring(sizeof(int), 4, mode);
+  int in[] = {1, 2, 3, 4, 5, 6};
+  int out[6] = {0};
+
+  cr_assert(ne(ptr, r, NULL));
+  cr_assert(eq(sz, ring_pop(r, out, 1), 0));
+  cr_assert(eq(sz, ring_push(r, in, 6), 4));
+  cr_assert(eq(sz, ring_size(r), 4));
+  cr_assert(eq(sz, ring_push(r, in + 4, 2), 0));
+  cr_assert(eq(sz, ring_pop(r, out, 3), 3));
+  cr_assert(eq(i32, out[0], 1));
+  cr_assert(eq(i32, out[1], 2));
+  cr_assert(eq(i32, out[2], 3));
+
+  // The next push wraps around the end of the storage.
+  cr_assert(eq(sz, ring_push(r, in + 4, 2), 2));
+  cr_assert(eq(sz, ring_pop(r, out, 6), 3));
+  cr_assert(eq(i32, out[0], 4));
+  cr_assert(eq(i32, out[1], 5));
+  cr_assert(eq(i32, out[2], 6));
+  cr_assert(ring_empty(r));
+  ring_destroy(r);
+}
+
+Test(ring, push_pop_spsc) {
+  pushPopRoundTrip(RING_SPSC);
+}
+
+Test(ring, push_pop_mpsc) {
+  pushPopRoundTrip(RING_MPSC);
+}
+
+Test(ring, large_elements) {
+  typedef struct {
+    uint64_t a;
+    uint8_t b[37];
+  } Element;
+  Ring * r = ring(sizeof(Element), 3, RING_MPSC);
+  Element in = {.a = 42, .b = {[36] = 7}};
+  Element out = {0};
+
+  cr_assert(ne(ptr, r, NULL));
+  for (int i = 0; i < 10; ++i) {
+    in.a = i;
+    cr_assert(eq(sz, ring_push(r, &in, 1), 1));
+    cr_assert(eq(sz, ring_pop(r, &out, 1), 1));
+    cr_assert(eq(u64, out.a, (uint64_t)i));
+    cr_assert(eq(u8, out.b[36], 7));
+  }
+  ring_destroy(r);
+}
+
+typedef struct {
+  Ring * ring;
+  uint64_t id;
+  uint64_t count;
+} ProducerParam;
+
+static void * producerMain(void * arg) {
+  const ProducerParam * param = arg;
+  uint64_t batch[16];
+
+  for (uint64_t i = 0; i < param->count;) {
+    const uint64_t n = param->count - i < 16 ? param->count - i : 16;
+
+    for (uint64_t j = 0; j < n; ++j)
+      batch[j] = param->id << 32 | (i + j);
+    size_t pushed = 0;
+    while (pushed < n)
+      pushed += ring_push(param->ring, batch + pushed, n - pushed);
+    i += n;
+  }
+  return NULL;
+}
+
+// Every producer sends an increasing sequence, the consumer checks that each
+// sequence arrives complete and in order.
+static void stress(RingMode mode, uint64_t producers) {
+  Ring * r = ring(sizeof(uint64_t), 1024, mode);
+  pthread_t threads[STRESS_PRODUCERS];
+  ProducerParam params[STRESS_PRODUCERS];
+  uint64_t expected[STRESS_PRODUCERS] = {0};
+  const uint64_t perProducer = STRESS_ITEMS / producers;
+  uint64_t received = 0;
+  uint64_t batch[64];
+
+  cr_assert(ne(ptr, r, NULL));
+  for (uint64_t i = 0; i < producers; ++i) {
+    params[i] = (ProducerParam){.ring = r, .id = i, .count = perProducer};
+    cr_assert(eq(i32, pthread_create(threads + i, NULL, producerMain, params + i), 0));
+  }
+  while (received < perProducer * producers) {
+    const size_t n = ring_pop(r, batch, 64);
+
+    for (size_t i = 0; i < n; ++i) {
+      const uint64_t id = batch[i] >> 32;
+
+      cr_assert(lt(u64, id, producers));
+      cr_assert(eq(u64, batch[i] & 0xffffffff, expected[id]));
+      ++expected[id];
+    }
+    received += n;
+  }
+  for (uint64_t i = 0; i < producers; ++i)
+    pthread_join(threads[i], NULL);
+  cr_assert(ring_empty(r));
+  ring_destroy(r);
+}
+
+Test(ring, stress_spsc, .timeout = 60) {
+  stress(RING_SPSC, 1);
+}
+
+Test(ring, stress_mpsc, .timeout = 60) {
+  stress(RING_MPSC, STRESS_PRODUCERS);
+}
@@ -0,0 +1,6 @@
+#define RING_IMPL
+#include <ring.h>
+
+void * ring_slot(const Ring * ring, size_t pos) {
+  return ring->data + (pos & ring->mask) * ring->dataSize;
+}
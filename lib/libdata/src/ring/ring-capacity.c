@@ -0,0 +1,8 @@
+#define RING_IMPL
+#include <ring.h>
+
+size_t ring_capacity(const Ring * ring) {
+  assert(ring != NULL && "ring cannot be NULL");
+
+  return ring->capacity;
+}
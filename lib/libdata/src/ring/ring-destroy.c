@@ -0,0 +1,10 @@
+#define RING_IMPL
+#include <ring.h>
+
+void ring_destroy(Ring * ring) {
+  if (ring) {
+    free(ring->seq);
+    free(ring->data);
+    free(ring);
+  }
+}
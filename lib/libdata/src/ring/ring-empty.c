@@ -0,0 +1,6 @@
+#define RING_USE_IMPL
+#include <ring.h>
+
+bool ring_empty(const Ring * ring) {
+  return ring_size(ring) == 0;
+}
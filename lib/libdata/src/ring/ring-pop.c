@@ -0,0 +1,49 @@
+#define RING_IMPL
+#include <ring.h>
+
+static void ring_copyOut(const Ring * ring, size_t pos, void * values, size_t n) {
+  const size_t first = min(n, ring->capacity - (pos & ring->mask));
+
+  memcpy(values, ring_slot(ring, pos), first * ring->dataSize);
+  memcpy((uint8_t *)values + first * ring->dataSize, ring->data, (n - first) * ring->dataSize);
+}
+
+static size_t ring_popSingle(Ring * ring, void * values, size_t count) {
+  const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+
+  if (ring->cachedHead - tail < count)
+    ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  const size_t n = min(count, ring->cachedHead - tail);
+
+  if (n == 0)
+    return 0;
+  ring_copyOut(ring, tail, values, n);
+  atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+  return n;
+}
+
+static size_t ring_popMulti(Ring * ring, void * values, size_t count) {
+  const size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t n = 0;
+
+  // Stop at the first slot that is reserved but not yet published.
+  while (n < count &&
+         atomic_load_explicit(&ring->seq[(tail + n) & ring->mask], memory_order_acquire) == tail + n + 1)
+    ++n;
+  if (n == 0)
+    return 0;
+  ring_copyOut(ring, tail, values, n);
+  atomic_store_explicit(&ring->tail, tail + n, memory_order_release);
+  return n;
+}
+
+size_t ring_pop(Ring * ring, void * values, size_t count) {
+  assert(ring != NULL && "ring cannot be NULL");
+
+  if (count == 0)
+    return 0;
+  if (ring->mode == RING_MPSC)
+    return ring_popMulti(ring, values, count);
+  return ring_popSingle(ring, values, count);
+}
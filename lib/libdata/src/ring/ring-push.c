@@ -0,0 +1,60 @@
+#define RING_IMPL
+#include <ring.h>
+
+static void ring_copyIn(Ring * ring, size_t pos, const void * values, size_t n) {
+  const size_t first = min(n, ring->capacity - (pos & ring->mask));
+
+  memcpy(ring_slot(ring, pos), values, first * ring->dataSize);
+  memcpy(ring->data, (const uint8_t *)values + first * ring->dataSize, (n - first) * ring->dataSize);
+}
+
+static size_t ring_pushSingle(Ring * ring, const void * values, size_t count) {
+  const size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+  if (ring->capacity - (head - ring->cachedTail) < count)
+    ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+  const size_t n = min(count, ring->capacity - (head - ring->cachedTail));
+
+  if (n == 0)
+    return 0;
+  ring_copyIn(ring, head, values, n);
+  atomic_store_explicit(&ring->head, head + n, memory_order_release);
+  return n;
+}
+
+static size_t ring_pushMulti(Ring * ring, const void * values, size_t count) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t n;
+
+  // Reserve [head, head + n) for this producer, the tail can only move forward
+  // so the free space computed here is a lower bound.
+  do {
+    const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const size_t used = head - tail;
+
+    if (used > ring->capacity) // stale head, the exchange below refreshes it
+      n = 0;
+    else if ((n = min(count, ring->capacity - used)) == 0)
+      return 0;
+  } while (!atomic_compare_exchange_weak_explicit(
+      &ring->head, &head, head + n, memory_order_relaxed, memory_order_relaxed
+  ));
+
+  ring_copyIn(ring, head, values, n);
+  // Publish every slot on its own so that the consumer never waits for a
+  // slower producer that reserved an earlier range.
+  for (size_t i = 0; i < n; ++i)
+    atomic_store_explicit(&ring->seq[(head + i) & ring->mask], head + i + 1, memory_order_release);
+  return n;
+}
+
+size_t ring_push(Ring * ring, const void * values, size_t count) {
+  assert(ring != NULL && "ring cannot be NULL");
+
+  if (count == 0)
+    return 0;
+  if (ring->mode == RING_MPSC)
+    return ring_pushMulti(ring, values, count);
+  return ring_pushSingle(ring, values, count);
+}
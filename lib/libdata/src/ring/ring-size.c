@@ -0,0 +1,11 @@
+#define RING_IMPL
+#include <ring.h>
+
+size_t ring_size(const Ring * ring) {
+  assert(ring != NULL && "ring cannot be NULL");
+
+  const size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  const size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+  return min(head - tail, ring->capacity);
+}
@@ -0,0 +1,39 @@
+#define RING_IMPL
+#include <ring.h>
+
+Ring * ring(size_t dataSize, size_t capacity, RingMode mode) {
+  assert(dataSize != 0 && "dataSize must be greater than 0");
+  assert(capacity != 0 && "capacity must be greater than 0");
+
+  size_t realCapacity = 1;
+  while (realCapacity < capacity)
+    realCapacity <<= 1;
+
+  Ring * ring = aligned_alloc(RING_CACHE_LINE, sizeof(Ring));
+  uint8_t * data = malloc(realCapacity * dataSize);
+  _Atomic size_t * seq = NULL;
+
+  if (mode == RING_MPSC)
+    seq = calloc(realCapacity, sizeof(*seq));
+  if (!ring || !data || (mode == RING_MPSC && !seq))
+    goto NoMemoryError;
+
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  ring->cachedTail = 0;
+  ring->cachedHead = 0;
+  ring->dataSize = dataSize;
+  ring->capacity = realCapacity;
+  ring->mask = realCapacity - 1;
+  ring->mode = mode;
+  ring->seq = seq;
+  ring->data = data;
+  return ring;
+
+NoMemoryError:
+
+  free(seq);
+  free(data);
+  free(ring);
+  return NULL;
+}
@@ -0,0 +1,49 @@
+//
+// Created by loumouli on 4/25/24.
+//
+
+#include "ft_nmap.h"
+
+int64_t baseline_open(NMAP_Baseline* baseline, const char* path, const Array* ports) {
+  memset(baseline, 0, sizeof(NMAP_Baseline));
+  if (resultFile_map(&baseline->file, path))
+    return 1;
+  baseline->open = true;
+  baseline->position = malloc((UINT16_MAX + 1) * sizeof(uint32_t));
+  if (baseline->position == NULL || portMap_init(&baseline->scratch, array_size(ports))) {
+    perror("malloc");
+    return 1;
+  }
+  memset(baseline->position, 0xff, (UINT16_MAX + 1) * sizeof(uint32_t));
+  for (uint32_t i = 0; i < array_size(ports); ++i)
+    baseline->position[*(const uint16_t*)array_cGet(ports, i)] = i;
+  return 0;
+}
+
+void baseline_close(NMAP_Baseline* baseline) {
+  if (baseline->open == false)
+    return;
+  resultFile_unmap(&baseline->file);
+  portMap_destroy(&baseline->scratch);
+  free(baseline->position);
+  memset(baseline, 0, sizeof(NMAP_Baseline));
+}
+
+bool baseline_load(const NMAP_Baseline* baseline, const struct in_addr ip, NMAP_PortMap* map) {
+  uint64_t count;
+  const NMAP_ResultIpEntry* entries = resultFile_findHost(&baseline->file, ip, &count);
+  NMAP_ResultRun run;
+
+  memset(map->words, 0, portMap_words(map->count) * sizeof(uint64_t));
+  if (count == 0)
+    return false;
+  NMAP_ResultRuns runs = resultFile_runs(&baseline->file, entries[0].host);
+  while (resultFile_nextRun(&runs, &run))
+    for (uint32_t j = 0; j < run.length; ++j) {
+      const uint32_t idx = baseline->position[run.first + j];
+      // The ports the scan does not share with the baseline have no baseline
+      if (idx < map->count)
+        portMap_set(map, idx, run.status);
+    }
+  return true;
+}
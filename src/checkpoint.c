@@ -0,0 +1,401 @@
+//
+// Created by loumouli on 4/24/24.
+//
+
+#include "ft_nmap.h"
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t fnv1a(uint64_t hash, const void* data, const size_t size) {
+  for (size_t i = 0; i < size; ++i)
+    hash = (hash ^ ((const uint8_t*)data)[i]) * FNV_PRIME;
+  return hash;
+}
+
+/**
+ * @brief hash the content of a mapped file 8 bytes at a time, a list of targets can be large and is hashed at every
+ * start.
+ * @param hash {uint64_t} - Hash to fold the content into.
+ * @param data {const char*} - Content.
+ * @param size {size_t} - Size of data.
+ * @return {uint64_t} - The hash.
+ */
+static uint64_t checkpoint_hashContent(uint64_t hash, const char* data, const size_t size) {
+  uint64_t word;
+  size_t i = 0;
+
+  for (; i + sizeof(word) <= size; i += sizeof(word)) {
+    memcpy(&word, data + i, sizeof(word));
+    hash = (hash ^ word) * FNV_PRIME;
+    // The product only carries the low bits upwards, the high ones are folded back so that every byte counts
+    hash ^= hash >> 32;
+  }
+  return fnv1a(hash, data + i, size - i);
+}
+
+static uint32_t checkpoint_checksum(const void* data, const size_t size) {
+  const uint64_t hash = fnv1a(FNV_OFFSET, data, size);
+  return hash ^ hash >> 32;
+}
+
+static uint64_t checkpoint_fingerprint(const NMAP_Options* options) {
+  const uint8_t randomize = options->randomize;
+  uint64_t hash = FNV_OFFSET;
+
+  hash = fnv1a(hash, &options->scan, sizeof(options->scan));
+  hash = fnv1a(hash, &randomize, sizeof(randomize));
+  hash = fnv1a(hash, &options->seed, sizeof(options->seed));
+  hash = fnv1a(hash, &options->shard, sizeof(options->shard));
+  hash = fnv1a(hash, &options->shards, sizeof(options->shards));
+  hash = fnv1a(hash, array_cData(options->ports), array_size(options->ports) * sizeof(uint16_t));
+  for (uint64_t i = 0; i < array_size(options->targets->sources); ++i) {
+    const NMAP_TargetSource* source = array_cGet(options->targets->sources, i);
+    const uint8_t file = source->file != NULL || source->data != NULL;
+    hash = fnv1a(hash, &file, sizeof(file));
+    hash = fnv1a(hash, source->spec, strlen(source->spec) + 1);
+    // A file edited between two runs would give the cursor of the checkpoint to other targets
+    if (source->data) {
+      hash = fnv1a(hash, &source->size, sizeof(source->size));
+      hash = checkpoint_hashContent(hash, source->data, source->size);
+    }
+  }
+  // The exclusions change which addresses are generated, so the position of the cursor in them
+  if (options->targets->exclusions) {
+    const Array* intervals = options->targets->exclusions->intervals;
+    hash = fnv1a(hash, array_cData(intervals), array_size(intervals) * sizeof(NMAP_Interval));
+  }
+  return hash;
+}
+
+/**
+ * @brief read exactly size bytes at an offset.
+ * @return {bool} - true if every byte was read.
+ */
+static bool checkpoint_read(const int32_t fd, void* data, const size_t size, const uint64_t offset) {
+  size_t done = 0;
+
+  while (done < size) {
+    const ssize_t n = pread(fd, (uint8_t*)data + done, size - done, offset + done);
+    if (n <= 0 && (n == 0 || errno != EINTR))
+      return false;
+    done += n > 0 ? n : 0;
+  }
+  return true;
+}
+
+static bool checkpoint_writeAll(const int32_t fd, const void* data, const size_t size) {
+  size_t done = 0;
+
+  while (done < size) {
+    const ssize_t n = write(fd, (const uint8_t*)data + done, size - done);
+    if (n < 0 && errno != EINTR)
+      return false;
+    done += n > 0 ? n : 0;
+  }
+  return true;
+}
+
+int64_t checkpoint_readOrder(const char* path, bool* randomize, uint64_t* seed) {
+  const int32_t fd = open(path, O_RDONLY | O_CLOEXEC);
+  NMAP_CheckpointHeader header;
+
+  if (fd == -1) {
+    // Nothing to resume yet, the scan starts from scratch
+    if (errno == ENOENT)
+      return -1;
+    fprintf(stderr, "ft_nmap: failed to open '%s': %s\n", path, strerror(errno));
+    return 1;
+  }
+  const bool read = checkpoint_read(fd, &header, sizeof(header), 0);
+  close(fd);
+  if (read == false)
+    return -1;
+  if (memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic)) || header.version != CHECKPOINT_VERSION) {
+    fprintf(stderr, "ft_nmap: '%s' is not a checkpoint file of version %u\n", path, CHECKPOINT_VERSION);
+    return 1;
+  }
+  *randomize = header.randomize;
+  *seed = header.seed;
+  return 0;
+}
+
+/**
+ * @brief decode the hosts of a record and hand them to the replay callback.
+ * @param record {const NMAP_CheckpointRecord*} - Record, its checksum checked.
+ * @param data {const uint8_t*} - Hosts of the record.
+ * @param position {const uint32_t*} - Result index of every port, UINT32_MAX for the ports not scanned.
+ * @param nPorts {uint32_t} - Number of ports of the scan.
+ * @param replay {NMAP_CheckpointReplayFunction*} - Replay callback.
+ * @param param {void*} - Parameter of replay.
+ * @return {int64_t} - 0 if success, 1 if the record does not match the scan, -1 on allocation failure.
+ */
+static int64_t checkpoint_replayRecord(const NMAP_CheckpointRecord* record, const uint8_t* data,
+                                       const uint32_t* position, const uint32_t nPorts,
+                                       NMAP_CheckpointReplayFunction* replay, void* param) {
+  Array* ips = array(sizeof(in_addr_t), 0, record->hosts, NULL, NULL);
+  Array* timings = array(sizeof(NMAP_HostTiming), 0, record->hosts, NULL, NULL);
+  const uint8_t* const end = data + record->size;
+  const uint8_t* cursor = data;
+  Array* hosts = NULL;
+  int64_t error = 0;
+
+  // The results of every host follow its address, the addresses are needed first to create the store
+  for (uint32_t i = 0; ips && i < record->hosts && error == 0; ++i) {
+    uint32_t size;
+    if ((size_t)(end - cursor) < sizeof(in_addr_t) + sizeof(size)) {
+      error = 1;
+      break;
+    }
+    memcpy(array_get(ips, i), cursor, sizeof(in_addr_t));
+    memcpy(&size, cursor + sizeof(in_addr_t), sizeof(size));
+    cursor += sizeof(in_addr_t) + sizeof(size);
+    if ((size_t)(end - cursor) < size)
+      error = 1;
+    else
+      cursor += size;
+  }
+  if (ips && timings && error == 0)
+    hosts = host_createArray(ips, timings, nPorts, false);
+  if (hosts == NULL && error == 0)
+    error = -1;
+  cursor = data;
+  for (uint32_t i = 0; error == 0 && i < record->hosts; ++i) {
+    uint32_t size;
+    NMAP_ResultRun run;
+    memcpy(&size, cursor + sizeof(in_addr_t), sizeof(size));
+    cursor += sizeof(in_addr_t) + sizeof(size);
+    NMAP_ResultRuns runs = {.cursor = cursor, .end = cursor + size};
+    while (resultFile_nextRun(&runs, &run))
+      for (uint32_t j = 0; j < run.length; ++j) {
+        const uint32_t idx = position[run.first + j];
+        if (idx >= nPorts)
+          error = 1;
+        else
+          host_foldResult(array_get(hosts, i), idx, run.status);
+      }
+    cursor += size;
+  }
+  if (error == 0)
+    replay(hosts, param);
+  if (error < 0)
+    perror("malloc");
+  host_destroyArray(hosts);
+  array_destroy(timings);
+  array_destroy(ips);
+  return error;
+}
+
+/**
+ * @brief replay every valid record of a checkpoint file.
+ * @param checkpoint {NMAP_Checkpoint*} - Checkpoint, its targets set to the cursor of the last valid record.
+ * @param replay {NMAP_CheckpointReplayFunction*} - Replay callback.
+ * @param param {void*} - Parameter of replay.
+ * @return {int64_t} - Offset of the end of the last valid record, -1 on failure.
+ */
+static int64_t checkpoint_replay(NMAP_Checkpoint* checkpoint, NMAP_CheckpointReplayFunction* replay, void* param) {
+  const uint32_t nPorts = array_size(checkpoint->ports);
+  uint32_t* position = malloc((UINT16_MAX + 1) * sizeof(uint32_t));
+  Array* data = array(sizeof(uint8_t), 0, 0, NULL, NULL);
+  uint64_t offset = sizeof(NMAP_CheckpointHeader);
+  const off_t fileSize = lseek(checkpoint->fd, 0, SEEK_END);
+  NMAP_CheckpointRecord record;
+
+  if (position == NULL || data == NULL) {
+    perror("malloc");
+    free(position);
+    array_destroy(data);
+    return -1;
+  }
+  memset(position, 0xff, (UINT16_MAX + 1) * sizeof(uint32_t));
+  for (uint32_t i = 0; i < nPorts; ++i)
+    position[*(const uint16_t*)array_cGet(checkpoint->ports, i)] = i;
+  while (checkpoint_read(checkpoint->fd, &record, sizeof(record), offset)) {
+    if (record.size > fileSize - offset - sizeof(record))
+      break;
+    if (array_resize(data, sizeof(record) + record.size)) {
+      perror("malloc");
+      offset = -1;
+      break;
+    }
+    memcpy(array_data(data), &record, sizeof(record));
+    // A torn record fails to read to the end or its checksum, the scan resumes from the record before it
+    if (checkpoint_read(checkpoint->fd, (uint8_t*)array_data(data) + sizeof(record), record.size,
+                        offset + sizeof(record)) == false ||
+        checkpoint_checksum((const uint8_t*)array_cData(data) + 2 * sizeof(uint32_t),
+                            sizeof(record) - 2 * sizeof(uint32_t) + record.size) != record.checksum ||
+        record.targets < checkpoint->targets)
+      break;
+    const int64_t error = checkpoint_replayRecord(&record, (const uint8_t*)array_cData(data) + sizeof(record),
+                                                  position, nPorts, replay, param);
+    if (error) {
+      if (error > 0)
+        fputs("ft_nmap: the checkpoint does not match the ports of the scan\n", stderr);
+      offset = -1;
+      break;
+    }
+    checkpoint->targets = record.targets;
+    offset += sizeof(record) + record.size;
+  }
+  free(position);
+  array_destroy(data);
+  return offset;
+}
+
+int64_t checkpoint_open(NMAP_Checkpoint* checkpoint, const NMAP_Options* options,
+                        NMAP_CheckpointReplayFunction* replay, void* param) {
+  const NMAP_CheckpointHeader expected = {
+    .magic = CHECKPOINT_MAGIC,
+    .version = CHECKPOINT_VERSION,
+    .randomize = options->randomize,
+    .seed = options->seed,
+    .fingerprint = checkpoint_fingerprint(options),
+  };
+  NMAP_CheckpointHeader header;
+
+  memset(checkpoint, 0, sizeof(NMAP_Checkpoint));
+  checkpoint->open = true;
+  checkpoint->ports = options->ports;
+  pthread_mutex_init(&checkpoint->lock, NULL);
+  checkpoint->fd = open(options->checkpointPath, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (checkpoint->fd == -1) {
+    fprintf(stderr, "ft_nmap: failed to open '%s': %s\n", options->checkpointPath, strerror(errno));
+    return 1;
+  }
+  checkpoint->byPort = resultFile_sortPorts(options->ports);
+  checkpoint->runs = malloc(6 * array_size(options->ports) + 1);
+  checkpoint->buffers[0] = array(sizeof(uint8_t), 0, 0, NULL, NULL);
+  checkpoint->buffers[1] = array(sizeof(uint8_t), 0, 0, NULL, NULL);
+  if (checkpoint->byPort == NULL || checkpoint->runs == NULL || checkpoint->buffers[0] == NULL ||
+      checkpoint->buffers[1] == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  int64_t offset = 0;
+  // A checkpoint without a header is a scan that never got to start, resuming it is starting it
+  if (options->resume && checkpoint_read(checkpoint->fd, &header, sizeof(header), 0)) {
+    if (memcmp(&header, &expected, sizeof(header))) {
+      fprintf(stderr, "ft_nmap: '%s' is the checkpoint of another scan (targets, ports, scan types or order)\n",
+              options->checkpointPath);
+      return 1;
+    }
+    offset = checkpoint_replay(checkpoint, replay, param);
+    if (offset < 0)
+      return 1;
+    checkpoint->resumed = targets_skip(options->targets, checkpoint->targets);
+  }
+  if (ftruncate(checkpoint->fd, offset) || lseek(checkpoint->fd, offset, SEEK_SET) != offset ||
+      (offset == 0 && (checkpoint_writeAll(checkpoint->fd, &expected, sizeof(expected)) == false ||
+                       fdatasync(checkpoint->fd)))) {
+    fprintf(stderr, "ft_nmap: failed to write '%s': %s\n", options->checkpointPath, strerror(errno));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief append the records serialized since the previous call to the file and sync it.
+ * @param checkpoint {NMAP_Checkpoint*} - Checkpoint, only called by one thread at a time.
+ */
+static void checkpoint_flush(NMAP_Checkpoint* checkpoint) {
+  pthread_mutex_lock(&checkpoint->lock);
+  Array* const full = checkpoint->buffers[checkpoint->active];
+  checkpoint->active ^= 1;
+  pthread_mutex_unlock(&checkpoint->lock);
+  if (array_empty(full) || atomic_load(&checkpoint->failed)) {
+    array_clear(full);
+    return;
+  }
+  if (checkpoint_writeAll(checkpoint->fd, array_cData(full), array_size(full)) == false ||
+      fdatasync(checkpoint->fd)) {
+    perror("ft_nmap: failed to write the checkpoint");
+    atomic_store(&checkpoint->failed, true);
+  }
+  array_clear(full);
+}
+
+static void* checkpoint_main(void* arg) {
+  NMAP_Checkpoint* const checkpoint = arg;
+  uint64_t waited = 0;
+
+  while (true) {
+    const bool stopping = atomic_load_explicit(&checkpoint->stop, memory_order_acquire);
+    waited += CHECKPOINT_POLL_US;
+    if (stopping || waited >= CHECKPOINT_PERIOD_US) {
+      checkpoint_flush(checkpoint);
+      waited = 0;
+    }
+    if (stopping)
+      break;
+    usleep(CHECKPOINT_POLL_US);
+  }
+  return NULL;
+}
+
+int64_t checkpoint_start(NMAP_Checkpoint* checkpoint) {
+  atomic_store(&checkpoint->stop, false);
+  const int error = pthread_create(&checkpoint->thread, NULL, checkpoint_main, checkpoint);
+  if (error) {
+    fprintf(stderr, "pthread_create/checkpoint: %s\n", strerror(error));
+    return 1;
+  }
+  checkpoint->running = true;
+  return 0;
+}
+
+void checkpoint_addGroup(NMAP_Checkpoint* checkpoint, const Array* hosts, const uint32_t targets) {
+  NMAP_CheckpointRecord record = {.hosts = array_size(hosts)};
+  bool failed = false;
+
+  if (atomic_load(&checkpoint->failed))
+    return;
+  pthread_mutex_lock(&checkpoint->lock);
+  Array* const buffer = checkpoint->buffers[checkpoint->active];
+  const size_t start = array_size(buffer);
+  failed = array_pushBack(buffer, &record, sizeof(record));
+  for (uint64_t i = 0; failed == false && i < array_size(hosts); ++i) {
+    const t_host* host = array_cGet(hosts, i);
+    const uint32_t size = resultFile_encodeRuns(&host->results, checkpoint->ports, checkpoint->byPort,
+                                                checkpoint->runs);
+    failed = array_pushBack(buffer, &host->ip, sizeof(host->ip)) || array_pushBack(buffer, &size, sizeof(size)) ||
+             array_pushBack(buffer, checkpoint->runs, size);
+  }
+  if (failed == false) {
+    checkpoint->targets += targets;
+    checkpoint->records += 1;
+    record.targets = checkpoint->targets;
+    record.size = array_size(buffer) - start - sizeof(record);
+    memcpy(array_get(buffer, start), &record, sizeof(record));
+    // The checksum covers the record header from the targets on, and the hosts
+    uint8_t* const covered = (uint8_t*)array_get(buffer, start) + 2 * sizeof(uint32_t);
+    record.checksum = checkpoint_checksum(covered, sizeof(record) - 2 * sizeof(uint32_t) + record.size);
+    memcpy(array_get(buffer, start), &record, sizeof(record));
+  }
+  else {
+    perror("ft_nmap: failed to checkpoint a host group");
+    array_resize(buffer, start);
+    atomic_store(&checkpoint->failed, true);
+  }
+  pthread_mutex_unlock(&checkpoint->lock);
+}
+
+int64_t checkpoint_close(NMAP_Checkpoint* checkpoint) {
+  if (checkpoint->open == false)
+    return 0;
+  if (checkpoint->running) {
+    atomic_store_explicit(&checkpoint->stop, true, memory_order_release);
+    pthread_join(checkpoint->thread, NULL);
+  }
+  else if (checkpoint->buffers[0] && checkpoint->buffers[1])
+    checkpoint_flush(checkpoint);
+  const bool failed = atomic_load(&checkpoint->failed);
+  if (checkpoint->fd != -1)
+    close(checkpoint->fd);
+  pthread_mutex_destroy(&checkpoint->lock);
+  free(checkpoint->byPort);
+  free(checkpoint->runs);
+  array_destroy(checkpoint->buffers[0]);
+  array_destroy(checkpoint->buffers[1]);
+  memset(checkpoint, 0, sizeof(NMAP_Checkpoint));
+  return failed;
+}
@@ -0,0 +1,48 @@
+//
+// Created by loumouli on 4/13/24.
+//
+
+#include "ft_nmap.h"
+
+void credits_init(NMAP_Credits* credits, const uint32_t limit) {
+  credits->limit = limit;
+  atomic_init(&credits->inFlight, 0);
+  atomic_init(&credits->peakInFlight, 0);
+  atomic_init(&credits->stalls, 0);
+  atomic_init(&credits->waitUs, 0);
+}
+
+bool credits_tryAcquire(NMAP_Credits* credits) {
+  uint32_t inFlight = atomic_load_explicit(&credits->inFlight, memory_order_relaxed);
+  do {
+    if (credits->limit && inFlight >= credits->limit)
+      return false;
+  } while (!atomic_compare_exchange_weak_explicit(&credits->inFlight, &inFlight, inFlight + 1, memory_order_acquire,
+                                                  memory_order_relaxed));
+  uint32_t peak = atomic_load_explicit(&credits->peakInFlight, memory_order_relaxed);
+  while (peak < inFlight + 1 &&
+         !atomic_compare_exchange_weak_explicit(&credits->peakInFlight, &peak, inFlight + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+  return true;
+}
+
+void credits_release(NMAP_Credits* credits) {
+  atomic_fetch_sub_explicit(&credits->inFlight, 1, memory_order_release);
+}
+
+void credits_addStall(NMAP_Credits* credits, const uint64_t waitUs) {
+  atomic_fetch_add_explicit(&credits->stalls, 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&credits->waitUs, waitUs, memory_order_relaxed);
+}
+
+void credits_print(const NMAP_Credits* credits, FILE* stream) {
+  if (credits->limit)
+    fprintf(stream, "in-flight probes: %u now, %u peak, %u max\n", atomic_load(&credits->inFlight),
+            atomic_load(&credits->peakInFlight), credits->limit);
+  else
+    fprintf(stream, "in-flight probes: %u now, %u peak, unlimited\n", atomic_load(&credits->inFlight),
+            atomic_load(&credits->peakInFlight));
+  fprintf(stream, "credit stalls: %lu, time waiting for credits: %.3fs\n", atomic_load(&credits->stalls),
+          atomic_load(&credits->waitUs) / 1e6);
+}
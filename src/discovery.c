@@ -0,0 +1,453 @@
+//
+// Created by loumouli on 4/27/24.
+//
+
+#include "ft_nmap.h"
+
+typedef struct {
+  struct icmphdr header;
+  uint32_t originate;
+  uint32_t receive;
+  uint32_t transmit;
+} DISCOVERY_Timestamp;
+
+typedef struct {
+  struct ether_header ether;
+  struct ether_arp arp;
+} DISCOVERY_ArpFrame;
+
+// Both headers are made of 16 bits fields and bytes, the frame has no padding
+_Static_assert(sizeof(DISCOVERY_ArpFrame) == sizeof(struct ether_header) + sizeof(struct ether_arp), "padding");
+
+uint32_t discovery_getProbe(const char* name) {
+  if (!strcmp(name, "echo"))
+    return NMAP_DISCOVERY_ECHO;
+  if (!strcmp(name, "syn"))
+    return NMAP_DISCOVERY_SYN;
+  if (!strcmp(name, "ack"))
+    return NMAP_DISCOVERY_ACK;
+  if (!strcmp(name, "timestamp"))
+    return NMAP_DISCOVERY_TIMESTAMP;
+  if (!strcmp(name, "arp"))
+    return NMAP_DISCOVERY_ARP;
+  return NMAP_DISCOVERY_NONE;
+}
+
+/**
+ * @brief read the hardware address and the netmask of the capture interface, needed to send ARP requests.
+ * @param discovery {NMAP_Discovery*} - Discovery, its engine initialized.
+ * @return {bool} - true if both were found.
+ */
+static bool discovery_readInterface(NMAP_Discovery* discovery) {
+  struct ifaddrs* ifaddr;
+  bool mac = false, netmask = false;
+
+  if (getifaddrs(&ifaddr) == -1) {
+    perror("getifaddrs");
+    return false;
+  }
+  for (const struct ifaddrs* ifa = ifaddr; ifa != NULL; ifa = ifa->ifa_next) {
+    if (ifa->ifa_addr == NULL || strcmp(ifa->ifa_name, discovery->engine->device))
+      continue;
+    if (ifa->ifa_addr->sa_family == AF_PACKET && ((struct sockaddr_ll*)ifa->ifa_addr)->sll_halen == ETH_ALEN) {
+      memcpy(discovery->mac, ((struct sockaddr_ll*)ifa->ifa_addr)->sll_addr, ETH_ALEN);
+      mac = true;
+    }
+    if (ifa->ifa_addr->sa_family == AF_INET && ifa->ifa_netmask) {
+      discovery->netmask = ((struct sockaddr_in*)ifa->ifa_netmask)->sin_addr.s_addr;
+      netmask = true;
+    }
+  }
+  freeifaddrs(ifaddr);
+  return mac && netmask;
+}
+
+char* discovery_buildFilter(const NMAP_Engine* engine) {
+  static const char suffix[] = ") or (arp and arp[6:2] = 2)";
+  // The filter of the engine grows with the scan types (UDP adds its source port), it is sized from it
+  const size_t size = strlen(engine->filter) + sizeof(suffix) + 2;
+  char* filter = malloc(size);
+
+  if (filter == NULL) {
+    perror("malloc");
+    return NULL;
+  }
+  const int32_t length = snprintf(filter, size, "(%s%s", engine->filter, suffix);
+  if (length < 0 || (size_t)length >= size) {
+    fprintf(stderr, "ft_nmap: discovery filter truncated\n");
+    free(filter);
+    return NULL;
+  }
+  return filter;
+}
+
+/**
+ * @brief open the capture of the replies: the ones the engine admits, and the ARP replies.
+ * @param discovery {NMAP_Discovery*} - Discovery, its engine initialized.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+static int64_t discovery_openHandle(NMAP_Discovery* discovery) {
+  const NMAP_Engine* const engine = discovery->engine;
+  char errbuf[PCAP_ERRBUF_SIZE];
+  struct bpf_program program;
+
+  discovery->handle = pcap_open_live(engine->device, 10000, 1, 1, errbuf);
+  if (discovery->handle == NULL) {
+    fprintf(stderr, "pcap_open_live: %s\n", errbuf);
+    return 1;
+  }
+  char* filter = discovery_buildFilter(engine);
+  if (filter == NULL)
+    return 1;
+  const bool compiled = pcap_compile(discovery->handle, &program, filter, 0, 0) != -1;
+  free(filter);
+  if (compiled == false) {
+    fprintf(stderr, "Cant parse filter %s\n", pcap_geterr(discovery->handle));
+    return 1;
+  }
+  const bool filtered = pcap_setfilter(discovery->handle, &program) != -1;
+  pcap_freecode(&program);
+  if (filtered == false) {
+    fprintf(stderr, "Couldnt apply filter %s\n", pcap_geterr(discovery->handle));
+    return 1;
+  }
+  if (pcap_setnonblock(discovery->handle, 1, errbuf) == -1) {
+    fprintf(stderr, "pcap_setnonblock: %s\n", errbuf);
+    return 1;
+  }
+  return 0;
+}
+
+int64_t discovery_init(NMAP_Discovery* discovery, NMAP_Engine* engine, const uint32_t probes) {
+  memset(discovery, 0, sizeof(NMAP_Discovery));
+  discovery->icmpSock = -1;
+  discovery->probes = probes;
+  discovery->engine = engine;
+  discovery->id = getpid() & 0xffff;
+  discovery->targets = array(sizeof(NMAP_DiscoveryTarget), 0, 0, NULL, NULL);
+  discovery->byIp = array(sizeof(uint32_t), 0, 0, NULL, NULL);
+  if (discovery->targets == NULL || discovery->byIp == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  if (probes & (NMAP_DISCOVERY_ECHO | NMAP_DISCOVERY_TIMESTAMP)) {
+    discovery->icmpSock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (discovery->icmpSock < 0) {
+      perror("socket/discovery_init");
+      return 1;
+    }
+  }
+  if (discovery_openHandle(discovery))
+    return 1;
+  if (probes & NMAP_DISCOVERY_ARP) {
+    discovery->arp = pcap_datalink(discovery->handle) == DLT_EN10MB && discovery_readInterface(discovery);
+    if (discovery->arp == false)
+      fprintf(stderr, "ft_nmap: %s is not an ethernet interface, no ARP discovery\n", engine->device);
+  }
+  return 0;
+}
+
+void discovery_destroy(NMAP_Discovery* discovery) {
+  if (discovery->engine == NULL)
+    return;
+  if (discovery->handle)
+    pcap_close(discovery->handle);
+  if (discovery->icmpSock >= 0)
+    close(discovery->icmpSock);
+  array_destroy(discovery->targets);
+  array_destroy(discovery->byIp);
+  memset(discovery, 0, sizeof(NMAP_Discovery));
+}
+
+static int ArrayFn_compareTargetIp(const void* lhs, const void* rhs, void* param) {
+  const NMAP_DiscoveryTarget* const a = array_cGet(param, *(const uint32_t*)lhs);
+  const NMAP_DiscoveryTarget* const b = array_cGet(param, *(const uint32_t*)rhs);
+
+  if (a->ip != b->ip)
+    return a->ip < b->ip ? -1 : 1;
+  return *(const uint32_t*)lhs < *(const uint32_t*)rhs ? -1 : *(const uint32_t*)lhs > *(const uint32_t*)rhs;
+}
+
+/**
+ * @brief mark the targets of an address up, the first reply of a target gives its round-trip time.
+ * @param discovery {NMAP_Discovery*} - Discovery.
+ * @param ip {in_addr_t} - Address that replied.
+ * @param recvTime {struct timeval} - Capture timestamp of the reply.
+ */
+static void discovery_onReply(NMAP_Discovery* discovery, const in_addr_t ip, const struct timeval recvTime) {
+  const uint32_t* const byIp = array_cData(discovery->byIp);
+  uint64_t lo = 0, hi = array_size(discovery->byIp);
+
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if (((const NMAP_DiscoveryTarget*)array_cGet(discovery->targets, byIp[mid]))->ip < ip)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  // An address listed twice in the group is up twice
+  for (; lo < array_size(discovery->byIp); ++lo) {
+    NMAP_DiscoveryTarget* const target = array_get(discovery->targets, byIp[lo]);
+    if (target->ip != ip)
+      break;
+    if (target->up)
+      continue;
+    const int64_t rtt = TIMEVAL_SUBTRACT(recvTime, target->sent);
+    target->up = true;
+    target->rtt = rtt > 0 ? rtt : 1;
+    --discovery->pending;
+  }
+}
+
+/**
+ * @brief parse a captured packet.
+ * @param discovery {const NMAP_Discovery*} - Discovery.
+ * @param head {const struct pcap_pkthdr*} - Capture header.
+ * @param packet {const uint8_t*} - Captured bytes, starting with the ethernet header.
+ * @param ip {in_addr_t*} - Set to the address that replied.
+ * @return {bool} - true if the packet is a reply to one of our probes: an ICMP echo or timestamp reply, a TCP reply
+ * to a SYN or ACK probe, or an ARP reply.
+ */
+static bool discovery_parse(const NMAP_Discovery* discovery, const struct pcap_pkthdr* head, const uint8_t* packet,
+                            in_addr_t* ip) {
+  if (head->caplen < sizeof(struct ether_header))
+    return false;
+  const uint16_t type = ntohs(((const struct ether_header*)packet)->ether_type);
+  if (type == ETHERTYPE_ARP && head->caplen >= sizeof(DISCOVERY_ArpFrame)) {
+    const struct ether_arp* arp = &((const DISCOVERY_ArpFrame*)packet)->arp;
+    memcpy(ip, arp->arp_spa, sizeof(*ip));
+    return ntohs(arp->arp_op) == ARPOP_REPLY;
+  }
+  if (type != ETHERTYPE_IP || head->caplen < sizeof(struct ether_header) + sizeof(struct iphdr))
+    return false;
+  const struct iphdr* iphdr = (const struct iphdr*)(packet + sizeof(struct ether_header));
+  const uint32_t offset = sizeof(struct ether_header) + iphdr->ihl * 4;
+  // The first 8 bytes of the ICMP or TCP header hold everything matched below
+  if (iphdr->ihl < 5 || head->caplen < offset + 8)
+    return false;
+  *ip = iphdr->saddr;
+  if (iphdr->protocol == IPPROTO_ICMP) {
+    const struct icmphdr* icmp = (const struct icmphdr*)(packet + offset);
+    return (icmp->type == ICMP_ECHOREPLY || icmp->type == ICMP_TIMESTAMPREPLY) &&
+           ntohs(icmp->un.echo.id) == discovery->id;
+  }
+  if (iphdr->protocol == IPPROTO_TCP) {
+    const struct tcphdr* tcp = (const struct tcphdr*)(packet + offset);
+    return ntohs(tcp->dest) == DISCOVERY_SOURCE_PORT &&
+           (ntohs(tcp->source) == DISCOVERY_SYN_PORT || ntohs(tcp->source) == DISCOVERY_ACK_PORT);
+  }
+  return false;
+}
+
+static void discovery_onPacket(u_char* arg, const struct pcap_pkthdr* head, const u_char* packet) {
+  NMAP_Discovery* const discovery = (NMAP_Discovery*)arg;
+  in_addr_t ip;
+
+  if (discovery_parse(discovery, head, packet, &ip))
+    discovery_onReply(discovery, ip, head->ts);
+}
+
+/**
+ * @brief wait for replies and handle them.
+ * @param discovery {NMAP_Discovery*} - Discovery.
+ * @param timeout {int64_t} - Time to wait for the first one in microseconds.
+ * @return {int64_t} - 0 if success, 1 if the capture failed.
+ */
+static int64_t discovery_dispatch(NMAP_Discovery* discovery, const int64_t timeout) {
+  const int64_t ready = pcap_poll(discovery->handle, timeout);
+
+  if (ready < 0 && errno != EINTR) {
+    perror("poll/discovery");
+    return 1;
+  }
+  if (ready > 0 && pcap_dispatch(discovery->handle, -1, discovery_onPacket, (u_char*)discovery) == PCAP_ERROR) {
+    fprintf(stderr, "pcap_dispatch: %s\n", pcap_geterr(discovery->handle));
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief send a probe, handling the replies while the socket send queue is full.
+ * @param discovery {NMAP_Discovery*} - Discovery.
+ * @param sock {int32_t} - Raw socket.
+ * @param packet {const void*} - Probe, without its IP header.
+ * @param size {uint64_t} - Size of the probe.
+ * @param ip {in_addr_t} - Target.
+ * @return {int64_t} - 0 if success (or the target is unreachable), 1 if the capture failed.
+ */
+static int64_t discovery_send(NMAP_Discovery* discovery, const int32_t sock, const void* packet, const uint64_t size,
+                              const in_addr_t ip) {
+  const struct sockaddr_in dest = {.sin_family = AF_INET, .sin_addr.s_addr = ip};
+
+  while (send_packet(sock, packet, size, 0, (const struct sockaddr*)&dest)) {
+    if (errno != ENOBUFS && errno != EAGAIN) {
+      // A target the system can not route to is just down
+      if (errno != EHOSTUNREACH && errno != ENETUNREACH)
+        perror("send_packet/discovery");
+      return 0;
+    }
+    if (discovery_dispatch(discovery, DISCOVERY_POLL_US / 10))
+      return 1;
+  }
+  discovery->probesSent += 1;
+  return 0;
+}
+
+static int64_t discovery_sendTcp(NMAP_Discovery* discovery, const in_addr_t ip, const uint16_t port,
+                                 const uint8_t flags) {
+  struct tcphdr tcp = {0};
+
+  tcp.source = htons(DISCOVERY_SOURCE_PORT);
+  tcp.dest = htons(port);
+  tcp.doff = 5;
+  tcp.window = htons(1024);
+  tcp.th_flags = flags;
+  tcp.check = tcp_checksum(&tcp, sizeof(tcp), discovery->engine->inter_ip, (struct in_addr){ip});
+  return discovery_send(discovery, discovery->engine->sock, &tcp, sizeof(tcp), ip);
+}
+
+static int64_t discovery_sendEcho(NMAP_Discovery* discovery, const in_addr_t ip, const uint16_t sequence) {
+  struct icmphdr icmp = {.type = ICMP_ECHO};
+
+  icmp.un.echo.id = htons(discovery->id);
+  icmp.un.echo.sequence = htons(sequence);
+  icmp.checksum = checksum((uint16_t*)&icmp, sizeof(icmp));
+  return discovery_send(discovery, discovery->icmpSock, &icmp, sizeof(icmp), ip);
+}
+
+static int64_t discovery_sendTimestamp(NMAP_Discovery* discovery, const in_addr_t ip, const uint16_t sequence) {
+  DISCOVERY_Timestamp timestamp = {.header.type = ICMP_TIMESTAMP};
+  struct timeval now;
+
+  gettimeofday(&now, NULL);
+  timestamp.header.un.echo.id = htons(discovery->id);
+  timestamp.header.un.echo.sequence = htons(sequence);
+  // Milliseconds since midnight UTC
+  timestamp.originate = htonl((now.tv_sec % 86'400) * 1000 + now.tv_usec / 1000);
+  timestamp.header.checksum = checksum((uint16_t*)&timestamp, sizeof(timestamp));
+  return discovery_send(discovery, discovery->icmpSock, &timestamp, sizeof(timestamp), ip);
+}
+
+static int64_t discovery_sendArp(NMAP_Discovery* discovery, const in_addr_t ip) {
+  DISCOVERY_ArpFrame frame = {0};
+
+  memset(frame.ether.ether_dhost, 0xff, ETH_ALEN);
+  memcpy(frame.ether.ether_shost, discovery->mac, ETH_ALEN);
+  frame.ether.ether_type = htons(ETHERTYPE_ARP);
+  frame.arp.arp_hrd = htons(ARPHRD_ETHER);
+  frame.arp.arp_pro = htons(ETHERTYPE_IP);
+  frame.arp.arp_hln = ETH_ALEN;
+  frame.arp.arp_pln = sizeof(in_addr_t);
+  frame.arp.arp_op = htons(ARPOP_REQUEST);
+  memcpy(frame.arp.arp_sha, discovery->mac, ETH_ALEN);
+  memcpy(frame.arp.arp_spa, &discovery->engine->inter_ip, sizeof(in_addr_t));
+  memcpy(frame.arp.arp_tpa, &ip, sizeof(in_addr_t));
+  if (pcap_inject(discovery->handle, &frame, sizeof(frame)) == PCAP_ERROR) {
+    fprintf(stderr, "pcap_inject: %s\n", pcap_geterr(discovery->handle));
+    return 0;
+  }
+  discovery->probesSent += 1;
+  return 0;
+}
+
+/**
+ * @brief send a round of probes to every target that did not reply yet. A target on the local subnet is sent an ARP
+ * request only when ARP is enabled, no firewall can drop it.
+ * @param discovery {NMAP_Discovery*} - Discovery.
+ * @param round {uint16_t} - Round, the sequence number of the ICMP probes.
+ * @return {int64_t} - 0 if success, 1 if the capture failed.
+ */
+static int64_t discovery_sendRound(NMAP_Discovery* discovery, const uint16_t round) {
+  const uint32_t probes = discovery->probes;
+  int64_t error = 0;
+
+  for (uint64_t i = 0; error == 0 && i < array_size(discovery->targets); ++i) {
+    NMAP_DiscoveryTarget* const target = array_get(discovery->targets, i);
+    if (target->up)
+      continue;
+    gettimeofday(&target->sent, NULL);
+    if (target->local) {
+      error = discovery_sendArp(discovery, target->ip);
+      continue;
+    }
+    if (probes & NMAP_DISCOVERY_ECHO)
+      error = discovery_sendEcho(discovery, target->ip, round);
+    if (error == 0 && probes & NMAP_DISCOVERY_SYN)
+      error = discovery_sendTcp(discovery, target->ip, DISCOVERY_SYN_PORT, TH_SYN);
+    if (error == 0 && probes & NMAP_DISCOVERY_ACK)
+      error = discovery_sendTcp(discovery, target->ip, DISCOVERY_ACK_PORT, TH_ACK);
+    if (error == 0 && probes & NMAP_DISCOVERY_TIMESTAMP)
+      error = discovery_sendTimestamp(discovery, target->ip, round);
+  }
+  return error;
+}
+
+/**
+ * @brief set up the targets of a group, the ones no probe can reach are up from the start.
+ * @param discovery {NMAP_Discovery*} - Discovery.
+ * @param ips {const Array<in_addr_t>*} - Targets of the group.
+ * @return {int64_t} - 0 if success, 1 on allocation failure.
+ */
+static int64_t discovery_setTargets(NMAP_Discovery* discovery, const Array* ips) {
+  const in_addr_t subnet = discovery->engine->inter_ip.s_addr & discovery->netmask;
+  const bool routed = discovery->probes & ~NMAP_DISCOVERY_ARP;
+
+  if (array_resize(discovery->targets, array_size(ips)) || array_resize(discovery->byIp, array_size(ips))) {
+    perror("malloc");
+    return 1;
+  }
+  discovery->pending = 0;
+  for (uint32_t i = 0; i < array_size(ips); ++i) {
+    NMAP_DiscoveryTarget* const target = array_get(discovery->targets, i);
+    const in_addr_t ip = *(const in_addr_t*)array_cGet(ips, i);
+    *target = (NMAP_DiscoveryTarget){.ip = ip, .local = discovery->arp && (ip & discovery->netmask) == subnet};
+    target->up = target->local == false && routed == false;
+    discovery->pending += target->up == false;
+    *(uint32_t*)array_get(discovery->byIp, i) = i;
+  }
+  return array_sort(discovery->byIp, ArrayFn_compareTargetIp, discovery->targets) != 0;
+}
+
+int64_t discovery_run(NMAP_Discovery* discovery, Array* ips, Array* rtts) {
+  struct timeval start, now;
+  uint32_t live = 0;
+
+  if (discovery_setTargets(discovery, ips))
+    return 1;
+  // A late reply to a round is still a reply, the capture is not drained between rounds
+  for (uint16_t round = 0; discovery->pending && round < DISCOVERY_ROUNDS; ++round) {
+    if (discovery_sendRound(discovery, round))
+      return 1;
+    gettimeofday(&start, NULL);
+    gettimeofday(&now, NULL);
+    while (discovery->pending && TIMEVAL_SUBTRACT(now, start) < DISCOVERY_TIMEOUT_US) {
+      const int64_t left = DISCOVERY_TIMEOUT_US - TIMEVAL_SUBTRACT(now, start);
+      if (discovery_dispatch(discovery, left < DISCOVERY_POLL_US ? left : DISCOVERY_POLL_US))
+        return 1;
+      gettimeofday(&now, NULL);
+    }
+  }
+  if (array_resize(rtts, array_size(ips))) {
+    perror("malloc");
+    return 1;
+  }
+  for (uint32_t i = 0; i < array_size(ips); ++i) {
+    const NMAP_DiscoveryTarget* target = array_cGet(discovery->targets, i);
+    if (target->up == false)
+      continue;
+    *(in_addr_t*)array_get(ips, live) = target->ip;
+    *(uint32_t*)array_get(rtts, live) = target->rtt;
+    ++live;
+  }
+  discovery->up += live;
+  discovery->down += array_size(ips) - live;
+  array_resize(ips, live);
+  array_resize(rtts, live);
+  return 0;
+}
+
+void discovery_printStats(const NMAP_Discovery* discovery, FILE* stream) {
+  fprintf(stream, "host discovery: %lu hosts up, %lu down, %lu probes sent\n", discovery->up, discovery->down,
+          discovery->probesSent);
+}
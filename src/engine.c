@@ -0,0 +1,167 @@
+//
+// Created by loumouli on 4/15/24.
+//
+
+#include "ft_nmap.h"
+
+#define ENGINE_QUOTE(x) #x
+#define ENGINE_STRINGIFY(x) ENGINE_QUOTE(x)
+
+char* engine_buildFilter(const NMAP_Engine* engine) {
+  static const char prefix[] = "dst host ";
+  static const char suffix[] = " and (icmp or tcp)";
+  static const char udpSuffix[] = " and (icmp or tcp or (udp and dst port " ENGINE_STRINGIFY(UDP_SOURCE_PORT) "))";
+  char* filter = malloc(sizeof(prefix) + INET_ADDRSTRLEN + sizeof(udpSuffix));
+  char ip[INET_ADDRSTRLEN];
+  if (filter == NULL)
+    return NULL;
+  char* cursor = stpcpy(filter, prefix);
+  cursor = stpcpy(cursor, inet_ntop(AF_INET, &engine->inter_ip, ip, sizeof(ip)));
+  stpcpy(cursor, engine->udpSock >= 0 ? udpSuffix : suffix);
+  return filter;
+}
+
+int64_t engine_init(NMAP_Engine* engine, const NMAP_Options* options) {
+  char errbuf[PCAP_ERRBUF_SIZE];
+  pcap_if_t* devs;
+  struct timeval end;
+
+  memset(engine, 0, sizeof(NMAP_Engine));
+  engine->sock = -1;
+  engine->udpSock = -1;
+  gettimeofday(&engine->start, NULL);
+  pthread_mutex_init(&engine->lock, NULL);
+  credits_init(&engine->credits, options->maxParallelism);
+  if (pcap_findalldevs(&devs, errbuf) == -1 || devs == NULL) {
+    fprintf(stderr, "pcap_findalldevs: %s\n", errbuf);
+    return 1;
+  }
+  engine->device = strdup(devs->name);
+  pcap_freealldevs(devs);
+  if (engine->device == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  engine->inter_ip = get_interface_ip(engine->device);
+  engine->sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+  if (engine->sock < 0) {
+    perror("socket/engine_init");
+    return 1;
+  }
+  if (options->scan & NMAP_SCAN_UDP) {
+    engine->udpSock = socket(AF_INET, SOCK_RAW, IPPROTO_UDP);
+    if (engine->udpSock < 0) {
+      perror("socket/engine_init");
+      return 1;
+    }
+  }
+  engine->filter = engine_buildFilter(engine);
+  engine->handles = array(sizeof(pcap_t*), 0, 0, NULL, NULL);
+  engine->hostTable = hostTable_create();
+  if (engine->filter == NULL || engine->handles == NULL || engine->hostTable == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  gettimeofday(&end, NULL);
+  engine->initUs = TIMEVAL_SUBTRACT(end, engine->start);
+  return 0;
+}
+
+void engine_destroy(NMAP_Engine* engine) {
+  for (uint64_t i = 0; engine->handles && i < array_size(engine->handles); ++i)
+    pcap_close(*(pcap_t**)array_get(engine->handles, i));
+  array_destroy(engine->handles);
+  if (engine->compiled)
+    pcap_freecode(&engine->program);
+  if (engine->sock >= 0)
+    close(engine->sock);
+  if (engine->udpSock >= 0)
+    close(engine->udpSock);
+  hostTable_destroy(engine->hostTable);
+  free(engine->filter);
+  free(engine->device);
+  pthread_mutex_destroy(&engine->lock);
+}
+
+static pcap_t* engine_openHandle(NMAP_Engine* engine) {
+  char errbuf[PCAP_ERRBUF_SIZE];
+  pcap_t* handle = pcap_open_live(engine->device, 10000, 1, 1, errbuf);
+
+  if (handle == NULL) {
+    fprintf(stderr, "pcap_open_live: %s\n", errbuf);
+    return NULL;
+  }
+  pthread_mutex_lock(&engine->lock);
+  // Every handle is opened on the same device, so the program compiled for the first one fits all of them
+  if (engine->compiled == false && pcap_compile(handle, &engine->program, engine->filter, 0, 0) == -1)
+    fprintf(stderr, "Cant parse filter %s\n", pcap_geterr(handle));
+  else
+    engine->compiled = true;
+  const bool filtered = engine->compiled && pcap_setfilter(handle, &engine->program) != -1;
+  pthread_mutex_unlock(&engine->lock);
+  if (filtered == false) {
+    fprintf(stderr, "Couldnt apply filter %s\n", pcap_geterr(handle));
+    pcap_close(handle);
+    return NULL;
+  }
+  return handle;
+}
+
+void engine_drainHandle(pcap_t* handle) {
+  char errbuf[PCAP_ERRBUF_SIZE];
+  struct pcap_pkthdr* head;
+  const uint8_t* packet;
+
+  if (pcap_setnonblock(handle, 1, errbuf) == -1)
+    return;
+  while (pcap_next_ex(handle, &head, &packet) == 1)
+    ;
+  pcap_setnonblock(handle, 0, errbuf);
+}
+
+pcap_t* engine_borrowHandle(NMAP_Engine* engine) {
+  pcap_t* handle = NULL;
+
+  pthread_mutex_lock(&engine->lock);
+  if (array_empty(engine->handles) == false) {
+    handle = *(pcap_t**)array_back(engine->handles);
+    array_popBack(engine->handles, 1, NULL);
+  }
+  pthread_mutex_unlock(&engine->lock);
+  if (handle == NULL)
+    return engine_openHandle(engine);
+  engine_drainHandle(handle);
+  return handle;
+}
+
+void engine_returnHandle(NMAP_Engine* engine, pcap_t* handle) {
+  pthread_mutex_lock(&engine->lock);
+  const int error = array_pushBack(engine->handles, &handle, 1);
+  pthread_mutex_unlock(&engine->lock);
+  if (error)
+    pcap_close(handle);
+}
+
+void engine_onProbeSent(NMAP_Engine* engine) {
+  if (atomic_load_explicit(&engine->firstProbeUs, memory_order_relaxed))
+    return;
+  struct timeval now;
+  uint64_t expected = 0;
+  gettimeofday(&now, NULL);
+  const uint64_t elapsed = TIMEVAL_SUBTRACT(now, engine->start);
+  atomic_compare_exchange_strong(&engine->firstProbeUs, &expected, elapsed ? elapsed : 1);
+}
+
+void engine_printStats(const NMAP_Engine* engine, FILE* stream) {
+  fprintf(stream, "engine init: %.3fms, time to first probe: %.3fms\n", engine->initUs / 1e3,
+          atomic_load(&engine->firstProbeUs) / 1e3);
+  fprintf(stream,
+          "probes sent: %lu, replies: %lu, retransmits: %lu (lost: %lu), capture drops: %lu, rx stalls: %lu\n",
+          atomic_load(&engine->signals.probesSent), atomic_load(&engine->signals.replies),
+          atomic_load(&engine->signals.retransmits), atomic_load(&engine->signals.losses),
+          atomic_load(&engine->signals.captureDrops), atomic_load(&engine->signals.rxStalls));
+  credits_print(&engine->credits, stream);
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) == 0)
+    fprintf(stream, "peak RSS: %.1f MiB\n", usage.ru_maxrss / 1024.0);
+}
@@ -0,0 +1,123 @@
+//
+// Created by loumouli on 4/30/24.
+//
+
+#include "ft_nmap.h"
+
+#define EXCLUSIONS_INDEX_SIZE ((1U << EXCLUSIONS_INDEX_BITS) + 1)
+
+NMAP_Exclusions* exclusions_create(void) {
+  NMAP_Exclusions* const exclusions = calloc(1, sizeof(NMAP_Exclusions));
+
+  if (exclusions == NULL)
+    return NULL;
+  exclusions->intervals = array(sizeof(NMAP_Interval), 0, 0, NULL, NULL);
+  exclusions->index = calloc(EXCLUSIONS_INDEX_SIZE, sizeof(uint32_t));
+  if (exclusions->intervals == NULL || exclusions->index == NULL) {
+    exclusions_destroy(exclusions);
+    return NULL;
+  }
+  // An empty list is sealed: every entry of its index already points past its (zero) intervals
+  exclusions->sealed = true;
+  return exclusions;
+}
+
+void exclusions_destroy(NMAP_Exclusions* exclusions) {
+  if (exclusions == NULL)
+    return;
+  array_destroy(exclusions->intervals);
+  free(exclusions->index);
+  free(exclusions);
+}
+
+int64_t exclusions_add(NMAP_Exclusions* exclusions, const uint32_t first, const uint32_t last) {
+  const NMAP_Interval interval = {.first = first, .last = last};
+
+  exclusions->sealed = false;
+  return array_pushBack(exclusions->intervals, &interval, 1) != 0;
+}
+
+static int ArrayFn_compareIntervals(const void* lhs, const void* rhs, unused void* param) {
+  const NMAP_Interval* const left = lhs;
+  const NMAP_Interval* const right = rhs;
+
+  if (left->first != right->first)
+    return left->first < right->first ? -1 : 1;
+  if (left->last != right->last)
+    return left->last < right->last ? -1 : 1;
+  return 0;
+}
+
+int64_t exclusions_seal(NMAP_Exclusions* exclusions) {
+  if (exclusions->sealed)
+    return 0;
+  if (array_sort(exclusions->intervals, ArrayFn_compareIntervals, NULL))
+    return 1;
+
+  NMAP_Interval* const intervals = array_data(exclusions->intervals);
+  const uint64_t count = array_size(exclusions->intervals);
+  uint64_t merged = 0;
+  // Overlapping and adjacent intervals are merged, so that one interval answers exclusions_covers
+  for (uint64_t i = 0; i < count; ++i) {
+    if (merged && intervals[i].first <= (uint64_t)intervals[merged - 1].last + 1) {
+      if (intervals[i].last > intervals[merged - 1].last)
+        intervals[merged - 1].last = intervals[i].last;
+      continue;
+    }
+    intervals[merged++] = intervals[i];
+  }
+  if (array_resize(exclusions->intervals, merged))
+    return 1;
+  exclusions->excluded = 0;
+  for (uint64_t i = 0; i < merged; ++i)
+    exclusions->excluded += (uint64_t)intervals[i].last - intervals[i].first + 1;
+  uint32_t i = 0;
+  for (uint64_t block = 0; block < EXCLUSIONS_INDEX_SIZE; ++block) {
+    while (i < merged && intervals[i].last < block << (32 - EXCLUSIONS_INDEX_BITS))
+      ++i;
+    exclusions->index[block] = i;
+  }
+  exclusions->sealed = true;
+  return 0;
+}
+
+/**
+ * @brief find the first interval ending at an address or after it.
+ * @param exclusions {const NMAP_Exclusions*} - List, sealed.
+ * @param ip {uint32_t} - Address, in host byte order.
+ * @return {const NMAP_Interval*} - The interval, NULL if every interval ends before the address.
+ */
+static const NMAP_Interval* exclusions_find(const NMAP_Exclusions* exclusions, const uint32_t ip) {
+  const NMAP_Interval* const intervals = array_cData(exclusions->intervals);
+  const uint32_t block = ip >> (32 - EXCLUSIONS_INDEX_BITS);
+  // The answer is at most the first interval ending in the next block, which also ends after ip
+  uint32_t lo = exclusions->index[block];
+  uint32_t hi = exclusions->index[block + 1];
+
+  while (lo < hi) {
+    const uint32_t mid = lo + (hi - lo) / 2;
+    if (intervals[mid].last < ip)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo < array_size(exclusions->intervals) ? intervals + lo : NULL;
+}
+
+bool exclusions_contains(const NMAP_Exclusions* exclusions, const uint32_t ip) {
+  const NMAP_Interval* const interval = exclusions_find(exclusions, ip);
+
+  return interval && interval->first <= ip;
+}
+
+bool exclusions_overlaps(const NMAP_Exclusions* exclusions, const uint32_t first, const uint32_t last) {
+  const NMAP_Interval* const interval = exclusions_find(exclusions, first);
+
+  return interval && interval->first <= last;
+}
+
+bool exclusions_covers(const NMAP_Exclusions* exclusions, const uint32_t first, const uint32_t last) {
+  const NMAP_Interval* const interval = exclusions_find(exclusions, first);
+
+  return interval && interval->first <= first && interval->last >= last;
+}
@@ -0,0 +1,137 @@
+//
+// Created by loumouli on 4/23/24.
+//
+
+#include <ft_nmap.h>
+
+typedef struct s_query_options {
+  const char* path;
+  bool byPort;
+  uint16_t port;
+  bool byHost;
+  struct in_addr ip;
+  bool all;
+} QueryOptions;
+
+enum e_query_option_key {
+  QUERY_KEY_PORT = 'p',
+  QUERY_KEY_HOST = 'H',
+  QUERY_KEY_ALL = 'a',
+};
+
+static error_t parseOpt(int key, char* arg, struct argp_state* state) {
+  QueryOptions* const input = state->input;
+  unsigned long port;
+  char* endptr;
+
+  switch (key) {
+  case QUERY_KEY_PORT:
+    errno = 0;
+    port = strtoul(arg, &endptr, 0);
+    if (errno == ERANGE || *endptr || !*arg || port > UINT16_MAX)
+      argp_error(state, "Invalid port '%s'", arg);
+    input->byPort = true;
+    input->port = port;
+    break;
+
+  case QUERY_KEY_HOST:
+    if (inet_pton(AF_INET, arg, &input->ip) != 1)
+      argp_error(state, "Invalid IPv4 address '%s'", arg);
+    input->byHost = true;
+    break;
+
+  case QUERY_KEY_ALL:
+    input->all = true;
+    break;
+
+  case ARGP_KEY_ARG:
+    if (input->path)
+      argp_error(state, "Only one result file can be queried");
+    input->path = arg;
+    break;
+
+  case ARGP_KEY_END:
+    if (input->path == NULL)
+      argp_error(state, "No result file given");
+    if (input->byPort && input->byHost)
+      argp_error(state, "--port and --host can not be combined");
+    break;
+
+  default:
+    return ARGP_ERR_UNKNOWN;
+  }
+  return NMAP_SUCCESS;
+}
+
+/**
+ * @brief print the hosts a port is open on, one address per line.
+ * @param file {const NMAP_ResultFile*} - Mapping.
+ * @param port {uint16_t} - Port.
+ */
+static void query_port(const NMAP_ResultFile* file, const uint16_t port) {
+  uint32_t count;
+  const uint32_t* hosts = resultFile_findPort(file, port, &count);
+
+  for (uint32_t i = 0; i < count; ++i)
+    if (hosts[i] < file->header->hostCount)
+      puts(inet_ntoa(file->hosts[hosts[i]].ip));
+}
+
+/**
+ * @brief print the results of every host of an address.
+ * @param file {const NMAP_ResultFile*} - Mapping.
+ * @param ip {struct in_addr} - Address.
+ * @param all {bool} - Print every run, not only the open ports.
+ */
+static void query_host(const NMAP_ResultFile* file, const struct in_addr ip, const bool all) {
+  uint64_t count;
+  const NMAP_ResultIpEntry* entries = resultFile_findHost(file, ip, &count);
+
+  const char* const protocol = scan_protocol(file->header->scan);
+
+  for (uint64_t i = 0; i < count; ++i) {
+    const NMAP_ResultHost* host = file->hosts + entries[i].host;
+    NMAP_ResultRuns runs = resultFile_runs(file, entries[i].host);
+    NMAP_ResultRun run;
+    printf("host(%s), %u port have been analyzed, %u open\n", inet_ntoa(host->ip), host->analyzed, host->open);
+    while (resultFile_nextRun(&runs, &run)) {
+      if (all && run.length > 1)
+        printf("\t%u-%u/%s %s\n", run.first, run.first + run.length - 1, protocol, port_status_to_string(run.status));
+      else if (all)
+        printf("\t%u/%s %s\n", run.first, protocol, port_status_to_string(run.status));
+      for (uint32_t j = 0; all == false && run.status == NMAP_OPEN && j < run.length; ++j) {
+        const struct servent* serv = getservbyport(htons(run.first + j), protocol);
+        printf("\t%u/%s open %s\n", run.first + j, protocol, serv ? serv->s_name : "");
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  static const struct argp_option argOptions[] = {
+    {.name = "port", .key = QUERY_KEY_PORT, .arg = "PORT", .doc = "Print the hosts the port is open on"},
+    {.name = "host", .key = QUERY_KEY_HOST, .arg = "IP", .doc = "Print the ports open on the host"},
+    {.name = "all", .key = QUERY_KEY_ALL, .doc = "With --host, print the status of every analyzed port"},
+    {},
+  };
+  static const struct argp argp = {
+    .options = argOptions,
+    .parser = parseOpt,
+    .args_doc = "RESULT_FILE",
+    .doc = "Query a result file written by ft_nmap --result-file, without parsing it.",
+  };
+  QueryOptions options = {0};
+  NMAP_ResultFile file;
+
+  if (argp_parse(&argp, argc, argv, 0, NULL, &options) || resultFile_map(&file, options.path))
+    return NMAP_FAILURE;
+  if (options.byPort)
+    query_port(&file, options.port);
+  else if (options.byHost)
+    query_host(&file, options.ip, options.all);
+  else
+    printf("%lu hosts, %u ports scanned, %u ports open on at least one host\n", file.header->hostCount,
+           file.header->portCount, file.header->openPortCount);
+  resultFile_unmap(&file);
+  return NMAP_SUCCESS;
+}
@@ -0,0 +1,105 @@
+//
+// Created by loumouli on 4/12/24.
+//
+
+#include "ft_nmap.h"
+
+static int32_t ArrayFn_mapIpToTiming(unused const Array* arr, size_t i, void* dst, const void* src,
+                                     unused void* param) {
+  NMAP_HostTiming* const timing = dst;
+
+  memset(timing, 0, sizeof(NMAP_HostTiming));
+  timing->ip = *(const in_addr_t*)src;
+  timing->stripe = i % HOST_TABLE_STRIPES;
+  timing->ssthresh = HOST_INITIAL_SSTHRESH;
+  atomic_init(&timing->timeout, 1'000'000); // in micro seconds (1s/1000ms)
+  atomic_init(&timing->cwnd, HOST_INITIAL_CWND);
+  atomic_init(&timing->inFlight, 0);
+  return 0;
+}
+
+NMAP_HostTable* hostTable_create(void) {
+  NMAP_HostTable* table = malloc(sizeof(NMAP_HostTable));
+  if (table == NULL)
+    return NULL;
+  memset(table, 0, sizeof(NMAP_HostTable));
+  table->minTimeout = 100'000; // in micro seconds (0.1s/100ms)
+  table->maxTimeout = 10'000'000; // in micro seconds (10s/10.000ms)
+  for (uint64_t i = 0; i < HOST_TABLE_STRIPES; ++i)
+    pthread_mutex_init(&table->locks[i], NULL);
+  return table;
+}
+
+void hostTable_destroy(NMAP_HostTable* table) {
+  if (table == NULL)
+    return;
+  for (uint64_t i = 0; i < HOST_TABLE_STRIPES; ++i)
+    pthread_mutex_destroy(&table->locks[i]);
+  free(table);
+}
+
+Array* hostTable_createTimings(const Array* ips) {
+  return array_cMap(ips, sizeof(NMAP_HostTiming), NULL, ArrayFn_mapIpToTiming, NULL);
+}
+
+bool hostTable_canSend(const NMAP_HostTiming* timing) {
+  return atomic_load_explicit(&timing->inFlight, memory_order_relaxed) <
+    atomic_load_explicit(&timing->cwnd, memory_order_relaxed);
+}
+
+void hostTable_onSend(NMAP_HostTiming* timing) { atomic_fetch_add_explicit(&timing->inFlight, 1, memory_order_relaxed); }
+
+static void hostTable_releaseProbe(NMAP_HostTiming* timing) {
+  uint32_t inFlight = atomic_load_explicit(&timing->inFlight, memory_order_relaxed);
+  while (inFlight && !atomic_compare_exchange_weak_explicit(&timing->inFlight, &inFlight, inFlight - 1,
+                                                            memory_order_relaxed, memory_order_relaxed))
+    ;
+}
+
+void hostTable_onReply(NMAP_HostTable* table, NMAP_HostTiming* timing, const long double rtt) {
+  pthread_mutex_t* const lock = &table->locks[timing->stripe];
+
+  hostTable_releaseProbe(timing);
+  pthread_mutex_lock(lock);
+  if (timing->srtt == 0) {
+    timing->srtt = rtt;
+    timing->rttvar = rtt / 2;
+  }
+  else {
+    timing->srtt = timing->srtt + (rtt - timing->srtt) / 8;
+    timing->rttvar = timing->rttvar + (fabsl(rtt - timing->srtt) - timing->rttvar) / 4;
+  }
+  double timeout = timing->srtt + timing->rttvar * 5;
+  if (timeout < table->minTimeout)
+    timeout = table->minTimeout;
+  else if (timeout > table->maxTimeout)
+    timeout = table->maxTimeout;
+  atomic_store_explicit(&timing->timeout, timeout, memory_order_relaxed);
+  double cwnd = atomic_load_explicit(&timing->cwnd, memory_order_relaxed);
+  cwnd += cwnd < timing->ssthresh ? 1 : 1 / cwnd; // slow start, then congestion avoidance
+  if (cwnd > HOST_MAX_CWND)
+    cwnd = HOST_MAX_CWND;
+  atomic_store_explicit(&timing->cwnd, cwnd, memory_order_relaxed);
+  pthread_mutex_unlock(lock);
+}
+
+bool hostTable_onDrop(NMAP_HostTable* table, NMAP_HostTiming* timing) {
+  pthread_mutex_t* const lock = &table->locks[timing->stripe];
+
+  hostTable_releaseProbe(timing);
+  pthread_mutex_lock(lock);
+  // The host never answered, its silence says nothing about congestion: the window stays as it is
+  if (timing->srtt == 0) {
+    pthread_mutex_unlock(lock);
+    return false;
+  }
+  double cwnd = atomic_load_explicit(&timing->cwnd, memory_order_relaxed) / 2;
+  if (cwnd < HOST_MIN_CWND)
+    cwnd = HOST_MIN_CWND;
+  timing->ssthresh = cwnd;
+  atomic_store_explicit(&timing->cwnd, cwnd, memory_order_relaxed);
+  pthread_mutex_unlock(lock);
+  return true;
+}
+
+void hostTable_onSilence(NMAP_HostTiming* timing) { hostTable_releaseProbe(timing); }
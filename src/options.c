@@ -6,10 +6,18 @@ static int printPortElement(const Array* arr, size_t i, const void* value, void*
   return 0;
 }
 
+static int printTargetSource(const Array* arr, size_t i, const void* value, void* param) {
+  (void)arr, (void)i, (void)param;
+  const NMAP_TargetSource* source = value;
+  printf("    \"%s%s\",\n", source->file ? "file:" : "", source->spec);
+  return 0;
+}
+
 static int printIpElement(const Array* arr, size_t i, const void* value, void* param) {
   (void)arr, (void)i, (void)param;
   static char ipBuffer[INET_ADDRSTRLEN + 1] = {0};
-  if (getnameinfo((void*)(struct sockaddr_in[]){{.sin_family = AF_INET, .sin_addr.s_addr = *(in_addr_t*)value}},
+  const t_host* host = value;
+  if (getnameinfo((void*)(struct sockaddr_in[]){{.sin_family = AF_INET, .sin_addr = host->ip}},
                   sizeof(struct sockaddr_in), ipBuffer, INET_ADDRSTRLEN, NULL, 0, NI_NUMERICHOST) == -1)
     return 1;
   printf("    \"%s\",\n", ipBuffer);
@@ -35,10 +43,10 @@ void NMAP_printOptions(const NMAP_Options* options) {
 
   printf("  ],\n"
          "  speedup: %u,\n"
-         "  ips: [\n",
+         "  targets: [\n",
          options->speedup);
 
-  array_cForEach(options->ips, printIpElement, NULL);
+  array_cForEach(options->targets->sources, printTargetSource, NULL);
 
   puts("  ],\n"
        "  ports: [");
@@ -68,7 +76,7 @@ void NMAP_printWorkerOptions(const NMAP_WorkerOptions* options) {
   printf("  ],\n"
          "  ips: [\n");
 
-  array_cForEach(options->ips, printIpElement, NULL);
+  array_cForEach(options->hosts, printIpElement, NULL);
 
   printf("  ],\n"
          "  ports: [\n");
@@ -0,0 +1,210 @@
+//
+// Created by loumouli on 4/22/24.
+//
+
+#include "ft_nmap.h"
+
+bool output_isStreamed(const NMAP_OutputFormat format) { return format != NMAP_OUTPUT_TEXT; }
+
+/**
+ * @brief write the buffer out, retrying partial writes.
+ * @param output {NMAP_Output*} - Writer.
+ */
+static void output_flush(NMAP_Output* output) {
+  size_t written = 0;
+
+  while (written < output->used && atomic_load_explicit(&output->failed, memory_order_relaxed) == false) {
+    const ssize_t n = write(output->fd, output->buffer + written, output->used - written);
+    if (n >= 0)
+      written += n;
+    else if (errno != EINTR) {
+      perror("ft_nmap: failed to write the results");
+      atomic_store_explicit(&output->failed, true, memory_order_relaxed);
+    }
+  }
+  output->used = 0;
+}
+
+/**
+ * @brief format the summary of a host at the end of the buffer.
+ * @param output {NMAP_Output*} - Writer, with at least OUTPUT_MAX_LINE bytes left in its buffer.
+ * @param record {const NMAP_OutputRecord*} - OUTPUT_HOST record.
+ * @param ip {const char*} - Address of the host.
+ */
+static void output_formatHost(NMAP_Output* output, const NMAP_OutputRecord* record, const char* ip) {
+  char* const line = output->buffer + output->used;
+  const uint32_t unchanged = record->analyzed - record->opened - record->closed;
+  int length;
+
+  if (output->format == NMAP_OUTPUT_JSONL && record->diff)
+    length = snprintf(line, OUTPUT_MAX_LINE,
+                      "{\"ip\":\"%s\",\"status\":\"done\",\"analyzed\":%u,\"opened\":%u,\"closed\":%u,"
+                      "\"unchanged\":%u}\n",
+                      ip, record->analyzed, record->opened, record->closed, unchanged);
+  else if (output->format == NMAP_OUTPUT_JSONL)
+    length = snprintf(line, OUTPUT_MAX_LINE, "{\"ip\":\"%s\",\"status\":\"done\",\"analyzed\":%u}\n", ip,
+                      record->analyzed);
+  else if (output->format == NMAP_OUTPUT_GREPABLE && record->diff)
+    length = snprintf(line, OUTPUT_MAX_LINE,
+                      "Host: %s ()\tStatus: Done\tAnalyzed: %u\tOpened: %u\tClosed: %u\tUnchanged: %u\n", ip,
+                      record->analyzed, record->opened, record->closed, unchanged);
+  else if (output->format == NMAP_OUTPUT_GREPABLE)
+    length = snprintf(line, OUTPUT_MAX_LINE, "Host: %s ()\tStatus: Done\tAnalyzed: %u\n", ip, record->analyzed);
+  else if (record->diff)
+    length = snprintf(line, OUTPUT_MAX_LINE,
+                      "host(%s), %u port have been analyzed, %u newly open, %u newly closed, %u unchanged\n", ip,
+                      record->analyzed, record->opened, record->closed, unchanged);
+  else
+    length = snprintf(line, OUTPUT_MAX_LINE, "host(%s), %u port have been analyzed\n", ip, record->analyzed);
+  output->used += length;
+}
+
+/**
+ * @brief format a port whose state changed since the baseline at the end of the buffer.
+ * @param output {NMAP_Output*} - Writer, with at least OUTPUT_MAX_LINE bytes left in its buffer.
+ * @param record {const NMAP_OutputRecord*} - OUTPUT_CHANGE record.
+ * @param ip {const char*} - Address of the host.
+ */
+static void output_formatChange(NMAP_Output* output, const NMAP_OutputRecord* record, const char* ip) {
+  char* const line = output->buffer + output->used;
+  const char* const change = record->status == NMAP_OPEN ? "opened" : "closed";
+  const char* const status = port_status_to_string(record->status);
+  const char* const previous = port_status_to_string(record->previous);
+  int length;
+
+  if (output->format == NMAP_OUTPUT_JSONL)
+    length = snprintf(line, OUTPUT_MAX_LINE,
+                      "{\"ip\":\"%s\",\"port\":%u,\"proto\":\"%s\",\"change\":\"%s\",\"state\":\"%s\","
+                      "\"previous\":\"%s\"}\n",
+                      ip, record->port, output->protocol, change, status, previous);
+  else if (output->format == NMAP_OUTPUT_GREPABLE)
+    length = snprintf(line, OUTPUT_MAX_LINE, "Host: %s ()\tChanged: %u/%s/%s//%s///\n", ip, record->port, status,
+                      output->protocol, previous);
+  else
+    length = snprintf(line, OUTPUT_MAX_LINE, "\t%u/%s %s (was %s)\n", record->port, output->protocol, status,
+                      previous);
+  output->used += length;
+}
+
+/**
+ * @brief format a record at the end of the buffer.
+ * @param output {NMAP_Output*} - Writer, with at least OUTPUT_MAX_LINE bytes left in its buffer.
+ * @param record {const NMAP_OutputRecord*} - Record to format.
+ */
+static void output_format(NMAP_Output* output, const NMAP_OutputRecord* record) {
+  char* const line = output->buffer + output->used;
+  char ip[INET_ADDRSTRLEN];
+  int length = 0;
+
+  inet_ntop(AF_INET, &record->ip, ip, sizeof(ip));
+  if (record->type == OUTPUT_HOST) {
+    output_formatHost(output, record, ip);
+    return;
+  }
+  if (record->type == OUTPUT_CHANGE) {
+    output_formatChange(output, record, ip);
+    return;
+  }
+  // The writer is the only thread resolving services, getservbyport does not have to be reentrant
+  const struct servent* serv = getservbyport(htons(record->port), output->protocol);
+  const char* const name = serv ? serv->s_name : "";
+  const char* const status = port_status_to_string(record->status);
+  if (output->format == NMAP_OUTPUT_JSONL)
+    length = snprintf(line, OUTPUT_MAX_LINE,
+                      "{\"ip\":\"%s\",\"port\":%u,\"proto\":\"%s\",\"state\":\"%s\",\"service\":\"%s\"}\n", ip,
+                      record->port, output->protocol, status, name);
+  else if (output->format == NMAP_OUTPUT_GREPABLE)
+    length = snprintf(line, OUTPUT_MAX_LINE, "Host: %s ()\tPorts: %u/%s/%s//%s///\n", ip, record->port, status,
+                      output->protocol, name);
+  else if (serv)
+    length = snprintf(line, OUTPUT_MAX_LINE, "\t%u/%s %s %s\n", record->port, serv->s_proto, status, name);
+  output->used += length;
+}
+
+static void* output_main(void* arg) {
+  NMAP_Output* const output = arg;
+  NMAP_OutputRecord records[OUTPUT_BATCH];
+
+  while (true) {
+    // Everything pushed before the stop flag was raised is in the ring once it is seen
+    const bool stopping = atomic_load_explicit(&output->stop, memory_order_acquire);
+    const size_t n = ring_pop(output->records, records, OUTPUT_BATCH);
+    if (n == 0) {
+      output_flush(output);
+      if (stopping)
+        break;
+      usleep(OUTPUT_POLL_US);
+      continue;
+    }
+    for (size_t i = 0; i < n; ++i) {
+      const bool host = records[i].type == OUTPUT_HOST;
+      // A host is complete at its summary line, which comes first in the text report and last otherwise
+      if ((host && output->format == NMAP_OUTPUT_TEXT) || output->used + OUTPUT_MAX_LINE > OUTPUT_BUFFER_SIZE)
+        output_flush(output);
+      output_format(output, records + i);
+      if (host && output->format != NMAP_OUTPUT_TEXT)
+        output_flush(output);
+    }
+  }
+  return NULL;
+}
+
+int64_t output_init(NMAP_Output* output, const char* path, const NMAP_OutputFormat format, const char* protocol) {
+  memset(output, 0, sizeof(NMAP_Output));
+  output->format = format;
+  output->protocol = protocol;
+  output->fd = STDOUT_FILENO;
+  if (path && strcmp(path, "-")) {
+    output->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (output->fd == -1) {
+      fprintf(stderr, "ft_nmap: failed to open '%s': %s\n", path, strerror(errno));
+      return 1;
+    }
+    output->ownsFd = true;
+  }
+  output->records = ring(sizeof(NMAP_OutputRecord), OUTPUT_RING_CAPACITY, RING_MPSC);
+  output->buffer = malloc(OUTPUT_BUFFER_SIZE);
+  if (output->records == NULL || output->buffer == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  return 0;
+}
+
+void output_destroy(NMAP_Output* output) {
+  if (output->ownsFd)
+    close(output->fd);
+  ring_destroy(output->records);
+  free(output->buffer);
+  memset(output, 0, sizeof(NMAP_Output));
+}
+
+int64_t output_start(NMAP_Output* output) {
+  atomic_store(&output->stop, false);
+  atomic_store(&output->failed, false);
+  const int error = pthread_create(&output->thread, NULL, output_main, output);
+  if (error) {
+    fprintf(stderr, "pthread_create/output: %s\n", strerror(error));
+    return 1;
+  }
+  output->running = true;
+  return 0;
+}
+
+int64_t output_stop(NMAP_Output* output) {
+  if (output->running == false)
+    return 1;
+  atomic_store_explicit(&output->stop, true, memory_order_release);
+  pthread_join(output->thread, NULL);
+  output->running = false;
+  return atomic_load(&output->failed);
+}
+
+void output_push(NMAP_Output* output, const NMAP_OutputRecord* record) {
+  while (ring_push(output->records, record, 1) == 0) {
+    // A writer that failed does not drain the ring anymore, the record is lost either way
+    if (atomic_load_explicit(&output->failed, memory_order_relaxed))
+      return;
+    sched_yield();
+  }
+}
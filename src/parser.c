@@ -1,100 +1,66 @@
 #include <ft_nmap.h>
 
-static in_addr_t dnsLookup(const char* name) {
-  const struct addrinfo hints = {
-    .ai_family = AF_INET,
-  };
-  struct addrinfo* result;
-
-  if (getaddrinfo(name, NULL, &hints, &result))
-    return INADDR_NONE;
-
-  const in_addr_t ip = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
-  freeaddrinfo(result);
-  return ip;
-}
-
-static int ArrayFn_setUint16ToIndex(unused Array* arr, unused size_t i, void* value, unused void* param) {
-  *(uint16_t*)value = i;
-  return 0;
-}
-
 static error_t parseOpt(int key, char* arg, struct argp_state* state) {
   static bool duplicatePort = false;
-  static bool duplicateIp = false;
+  static bool seedSet = false;
+  static uint32_t topPorts = 0;
+  static double portRatio = -1;
+  static NMAP_PortSet ports;
+  static NMAP_PortSet excludedPorts;
   NMAP_Options* const input = state->input;
   const char* tok;
   char* cursor = arg;
   char* endptr;
-  in_addr_t ip;
-  char* name = NULL;
-  size_t nameLength = 0;
-  FILE* file;
-  ssize_t readRet;
   uint32_t scan;
+  uint32_t probe;
   unsigned long speedup;
+  unsigned long maxParallelism;
+  unsigned long minSpeedup, maxSpeedup;
+  unsigned long hostgroup;
+  unsigned long long seed;
+  unsigned long shard, shards;
+  unsigned long count;
+  double ratio;
+  int64_t excluded;
 
   switch (key) {
   case NMAP_KEY_IP:
     while ((tok = strsep(&cursor, ","))) {
-      if (!*tok) {
-        if (cursor)
-          cursor[-1] = ',';
-        argp_error(state, "Invalid argument for --ip: '%s'", arg);
-      }
-      if ((ip = dnsLookup(tok)) == INADDR_NONE)
-        argp_failure(state, 1, errno, "Failed to resolve hostname '%s'", tok);
+      const int64_t error = targets_addSpec(input->targets, tok);
       if (cursor)
         cursor[-1] = ',';
-      if (array_any(input->ips, &ip))
-        duplicateIp = true;
-      else if (array_pushBack(input->ips, &ip, 1))
+      if (error < 0)
         return NMAP_FAILURE;
+      if (error)
+        argp_error(state, "Invalid argument for --ip: '%s'", arg);
     }
     break;
 
   case NMAP_KEY_FILE:
-
-    if (!(file = fopen(arg, "r")))
+    if (targets_addFile(input->targets, arg))
       argp_failure(state, 1, errno, "Failed to open file '%s'", arg);
+    break;
 
-    while ((readRet = getline(&name, &nameLength, file)) != -1) {
-      if (!readRet)
-        continue;
-      if (name[readRet - 1] == '\n')
-        name[readRet - 1] = 0;
-      if ((ip = dnsLookup(name)) == INADDR_NONE) {
-        fprintf(stderr, "ft_nmap: Failed to resolve hostname '%s'\n", name);
-        free(name);
-        return NMAP_FAILURE;
-      }
-      if (array_any(input->ips, &ip))
-        duplicateIp = true;
-      else if (array_pushBack(input->ips, &ip, 1)) {
-        free(name);
+  case NMAP_KEY_EXCLUDE:
+    while ((tok = strsep(&cursor, ","))) {
+      const int64_t error = targets_addExclude(input->targets, tok);
+      if (cursor)
+        cursor[-1] = ',';
+      if (error < 0)
         return NMAP_FAILURE;
-      }
+      if (error == 2)
+        argp_error(state, "Failed to resolve hostname '%s' of --exclude", tok);
+      if (error)
+        argp_error(state, "Invalid argument for --exclude: '%s'", arg);
     }
-    if (errno == ENOMEM)
-      argp_failure(state, 1, errno, "Failed to read from file '%s'", arg);
+    break;
 
-    fclose(file);
-    if (readRet == -1) {
-      free(name);
-      argp_failure(state, 1, errno, "Failed to read from file '%s'", arg);
-    }
-    if (readRet && name[readRet - 1] == '\n')
-      name[readRet - 1] = '\0';
-    if ((ip = dnsLookup(name)) == INADDR_NONE) {
-      fprintf(stderr, "ft_nmap: Failed to resolve hostname '%s'\n", name);
-      free(name);
-      return NMAP_FAILURE;
-    }
-    if (array_pushBack(input->ips, &ip, 1)) {
-      free(name);
-      return NMAP_FAILURE;
-    }
-    free(name);
+  case NMAP_KEY_EXCLUDE_FILE:
+    excluded = targets_addExcludeFile(input->targets, arg);
+    if (excluded < 0)
+      argp_failure(state, 1, errno, "Failed to read file '%s'", arg);
+    if (excluded)
+      argp_error(state, "Invalid argument for --excludefile: '%s'", arg);
     break;
 
   case NMAP_KEY_SCAN:
@@ -108,6 +74,20 @@ static error_t parseOpt(int key, char* arg, struct argp_state* state) {
     }
     break;
 
+  case NMAP_KEY_DISCOVERY:
+    input->discovery = NMAP_DISCOVERY_NONE;
+    if (strcmp(arg, "none") == 0)
+      break;
+    while ((tok = strsep(&cursor, ","))) {
+      probe = discovery_getProbe(tok);
+      if (cursor)
+        cursor[-1] = ',';
+      if (probe == NMAP_DISCOVERY_NONE)
+        argp_error(state, "Invalid argument for --discovery: '%s'", arg);
+      input->discovery |= probe;
+    }
+    break;
+
   case NMAP_KEY_SPEEDUP:
     speedup = strtoul(arg, (char**)&endptr, 0);
     if (errno == ERANGE || *endptr || speedup < 1 || speedup > 250)
@@ -115,57 +95,192 @@ static error_t parseOpt(int key, char* arg, struct argp_state* state) {
     input->speedup = speedup;
     break;
 
+  case NMAP_KEY_MAX_PARALLELISM:
+    errno = 0;
+    maxParallelism = strtoul(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || maxParallelism < 1 || maxParallelism > UINT32_MAX)
+      argp_error(state, "Invalid max-parallelism value '%s' (should be a positive integer)", arg);
+    input->maxParallelism = maxParallelism;
+    break;
+
+  case NMAP_KEY_ELASTIC:
+    errno = 0;
+    minSpeedup = strtoul(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr != '-')
+      argp_error(state, "Invalid elastic range '%s' (should be MIN-MAX in the range [1, 250])", arg);
+    maxSpeedup = strtoul(endptr + 1, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || minSpeedup < 1 || maxSpeedup < minSpeedup || maxSpeedup > 250)
+      argp_error(state, "Invalid elastic range '%s' (should be MIN-MAX in the range [1, 250])", arg);
+    input->minSpeedup = minSpeedup;
+    input->maxSpeedup = maxSpeedup;
+    break;
+
+  case NMAP_KEY_RESOLVERS:
+    errno = 0;
+    count = strtoul(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || !*arg || count < 1 || count > RESOLVER_MAX_THREADS)
+      argp_error(state, "Invalid argument for --resolvers: '%s' (should be an integer in the range [1, %d])", arg,
+                 RESOLVER_MAX_THREADS);
+    targets_setResolver(input->targets, resolver_getaddrinfo, count);
+    break;
+
+  case NMAP_KEY_MIN_HOSTGROUP:
+  case NMAP_KEY_MAX_HOSTGROUP:
+    errno = 0;
+    hostgroup = strtoul(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || hostgroup < 1 || hostgroup > UINT32_MAX)
+      argp_error(state, "Invalid host group size '%s' (should be a positive integer)", arg);
+    if (key == NMAP_KEY_MIN_HOSTGROUP)
+      input->minHostgroup = hostgroup;
+    else
+      input->maxHostgroup = hostgroup;
+    break;
+
+  case NMAP_KEY_RANDOMIZE:
+    input->randomize = true;
+    break;
+
+  case NMAP_KEY_SEED:
+    errno = 0;
+    seed = strtoull(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || !*arg)
+      argp_error(state, "Invalid seed '%s' (should be an unsigned 64 bits integer)", arg);
+    input->seed = seed;
+    input->randomize = true;
+    seedSet = true;
+    break;
+
+  case NMAP_KEY_SHARD:
+    errno = 0;
+    shard = strtoul(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr != '/')
+      argp_error(state, "Invalid shard '%s' (should be K/N with K < N)", arg);
+    shards = strtoul(endptr + 1, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || shards < 1 || shard >= shards || shards > UINT32_MAX)
+      argp_error(state, "Invalid shard '%s' (should be K/N with K < N)", arg);
+    input->shard = shard;
+    input->shards = shards;
+    break;
+
+  case NMAP_KEY_TOP_PORTS:
+    errno = 0;
+    count = strtoul(arg, (char**)&endptr, 0);
+    if (errno == ERANGE || *endptr || !*arg || count < 1 || count > UINT16_MAX + 1)
+      argp_error(state, "Invalid argument for --top-ports: '%s' (should be an integer in the range [1, 65536])", arg);
+    topPorts = count;
+    break;
+
+  case NMAP_KEY_PORT_RATIO:
+    errno = 0;
+    ratio = strtod(arg, (char**)&endptr);
+    if (errno == ERANGE || *endptr || !*arg || !(ratio >= 0 && ratio <= 1))
+      argp_error(state, "Invalid argument for --port-ratio: '%s' (should be a decimal number in [0, 1])", arg);
+    portRatio = ratio;
+    break;
+
+  case NMAP_KEY_STATS:
+    input->stats = true;
+    break;
+
+  case NMAP_KEY_OUTPUT:
+    input->outputPath = arg;
+    break;
+
+  case NMAP_KEY_RESULT_FILE:
+    input->resultPath = arg;
+    break;
+
+  case NMAP_KEY_CHECKPOINT:
+    input->checkpointPath = arg;
+    break;
+
+  case NMAP_KEY_RESUME:
+    input->resume = true;
+    break;
+
+  case NMAP_KEY_BASELINE:
+    input->baselinePath = arg;
+    break;
+
+  case NMAP_KEY_OUTPUT_FORMAT:
+    if (strcmp(arg, "text") == 0)
+      input->outputFormat = NMAP_OUTPUT_TEXT;
+    else if (strcmp(arg, "jsonl") == 0)
+      input->outputFormat = NMAP_OUTPUT_JSONL;
+    else if (strcmp(arg, "grepable") == 0)
+      input->outputFormat = NMAP_OUTPUT_GREPABLE;
+    else
+      argp_error(state, "Invalid output format '%s' (should be text, jsonl or grepable)", arg);
+    break;
+
   case NMAP_KEY_PORTS:
-    if (!*arg)
-      argp_error(state, "Invalid argument for --ports: ''");
-
-    const char* cursor = arg;
-
-    while (*cursor) {
-      unsigned long begin = strtoul(cursor, &endptr, 0);
-      if (errno == ERANGE || begin > UINT16_MAX)
-        argp_error(state, "Invalid argument for --ports: '%s'", arg);
-      if (*endptr == '-') {
-        unsigned long end = strtoul(endptr + 1, &endptr, 0);
-        if (errno == ERANGE || end < begin || end > UINT16_MAX || (*endptr && *endptr != ','))
-          argp_error(state, "Invalid argument for --ports: '%s'", arg);
-        for (uint16_t port = begin; port <= end; ++port)
-          if (!array_any(input->ports, &port) && array_pushBack(input->ports, &port, 1))
-            return NMAP_FAILURE;
-      }
-      else if (*endptr) {
-        if (*endptr != ',')
-          argp_error(state, "Invalid argument for --ports: '%s'", arg);
-        const uint16_t port = begin;
-        if (!array_any(input->ports, &port) && array_pushBack(input->ports, &port, 1))
-          return NMAP_FAILURE;
-      }
-      cursor = endptr + !!*endptr;
-    }
+    if (portSet_parse(&ports, arg, &duplicatePort))
+      argp_error(state, "Invalid argument for --ports: '%s'", arg);
+    break;
+
+  case NMAP_KEY_EXCLUDE_PORTS:
+    if (portSet_parse(&excludedPorts, arg, &(bool){false}))
+      argp_error(state, "Invalid argument for --exclude-ports: '%s'", arg);
     break;
 
   case ARGP_KEY_END:
     if (input->scan == NMAP_SCAN_NONE)
-      input->scan = NMAP_SCAN_ALL;
-    if (array_empty(input->ips))
+      input->scan = NMAP_SCAN_TCP;
+    if (targets_empty(input->targets))
       argp_error(state, "No destination found, either --file or --ip must be provided");
-    if (duplicateIp)
-      fputs("WARNING: Duplicate destination address(es) specified.  Are you alert enough to be using Nmap?  Have some "
-            "coffee "
-            "or Jolt(tm).\n",
-            stderr);
     if (duplicatePort)
       fputs("WARNING: Duplicate port number(s) specified.  Are you alert enough to be using Nmap?  Have some coffee "
             "or Jolt(tm).\n",
             stderr);
-    duplicateIp = duplicatePort = false;
-    if (array_empty(input->ports)) {
-      if (array_resize(input->ports, UINT16_MAX + 1))
+    if (input->resume && input->checkpointPath == NULL)
+      argp_error(state, "--resume needs the --checkpoint to resume from");
+    // The result file is truncated when the scan starts, while the baseline is read until the end
+    if (input->baselinePath && input->resultPath && strcmp(input->baselinePath, input->resultPath) == 0)
+      argp_error(state, "--baseline and --result-file can not be the same file");
+    // A resumed scan walks the targets in the order of the checkpoint, unless another seed is forced
+    if (input->resume && seedSet == false) {
+      const int64_t error = checkpoint_readOrder(input->checkpointPath, &input->randomize, &input->seed);
+      if (error > 0)
         return NMAP_FAILURE;
-      array_forEach(input->ports, ArrayFn_setUint16ToIndex, NULL);
+      seedSet = error == 0 && input->randomize;
     }
-    array_shrink(input->ips);
-    array_shrink(input->ports);
+    // Every shard has to walk the targets in the same order to stay disjoint from the others
+    if (input->randomize && input->shards > 1 && seedSet == false)
+      argp_error(state, "--shard with --randomize needs the same --seed on every shard");
+    if (input->randomize && seedSet == false && getentropy(&input->seed, sizeof(input->seed)))
+      argp_failure(state, 1, errno, "Failed to draw a seed");
+    targets_setOrder(input->targets, input->randomize, input->seed, input->shard, input->shards);
+    duplicatePort = seedSet = false;
+    if (input->minHostgroup > input->maxHostgroup) {
+      // An explicit bound wins over the default of the other one
+      if (input->maxHostgroup == HOSTGROUP_DEFAULT_MAX)
+        input->maxHostgroup = input->minHostgroup;
+      else if (input->minHostgroup == HOSTGROUP_DEFAULT_MIN)
+        input->minHostgroup = input->maxHostgroup;
+      else
+        argp_error(state, "--min-hostgroup (%u) is larger than --max-hostgroup (%u)", input->minHostgroup,
+                   input->maxHostgroup);
+    }
+    if ((topPorts || portRatio >= 0) && ports.size)
+      argp_error(state, "--top-ports and --port-ratio can not be combined with --ports");
+    if (topPorts && portRatio >= 0)
+      argp_error(state, "--top-ports and --port-ratio can not be combined");
+    if (portRatio >= 0)
+      services_portRatio(&ports, portRatio);
+    else if (ports.size == 0)
+      services_topPorts(&ports, topPorts ? topPorts : UINT16_MAX + 1, &excludedPorts);
+    portSet_subtract(&ports, &excludedPorts);
+    if (ports.size == 0 && portRatio >= 0)
+      argp_error(state, "No port of the services table is open as often as --port-ratio %g", portRatio);
+    if (ports.size == 0)
+      argp_error(state, "Every port is excluded by --exclude-ports");
+    // Every port list is walked by decreasing frequency, the most valuable results come first
+    if (services_sortPorts(&ports, input->ports))
+      return NMAP_FAILURE;
+    topPorts = 0;
+    portRatio = -1;
+    portSet_clear(&ports);
+    portSet_clear(&excludedPorts);
     break;
 
   default:
@@ -178,7 +293,7 @@ static void NMAP_destroyOptions(int status, void* arg) {
   (void)status;
   NMAP_Options* options = arg;
 
-  array_destroy(options->ips);
+  targets_destroy(options->targets);
   array_destroy(options->ports);
   free(options);
 }
@@ -190,19 +305,112 @@ NMAP_Options* NMAP_parseArgs(int argc, char** argv) {
 
   memset(options, 0, sizeof(NMAP_Options));
   options->speedup = 1;
-  options->ips = array(sizeof(in_addr_t), 1, 0, NULL, NULL);
-  options->ports = array(sizeof(uint16_t), UINT16_MAX + 1, 0, NULL, NULL);
+  options->minHostgroup = HOSTGROUP_DEFAULT_MIN;
+  options->maxHostgroup = HOSTGROUP_DEFAULT_MAX;
+  options->shards = 1;
+  options->discovery = NMAP_DISCOVERY_DEFAULT;
+  options->targets = targets_create();
+  options->ports = array(sizeof(uint16_t), 0, 0, NULL, NULL);
 
   on_exit(NMAP_destroyOptions, options);
-  if (!options->ips || !options->ports)
+  if (!options->targets || !options->ports)
     return NULL;
 
   static const struct argp_option argOptions[] = {
-    {.name = "ip", .key = NMAP_KEY_IP, .arg = "IP_OR_DOMAIN_NAME", .doc = "The IP address to scan"},
-    {.name = "file", .key = NMAP_KEY_FILE, .arg = "PATH", .doc = "The file containing the IP address to scan"},
+    {.name = "ip",
+     .key = NMAP_KEY_IP,
+     .arg = "TARGETS",
+     .doc = "The targets to scan: IP addresses or domain names, with an optional CIDR prefix (eg: 10.0.0.0/16), or "
+            "octet ranges (eg: 10.0.1-3.*)"},
+    {.name = "file",
+     .key = NMAP_KEY_FILE,
+     .arg = "PATH",
+     .doc = "The file containing the targets to scan, one per line (- for the standard input)"},
+    {.name = "exclude",
+     .key = NMAP_KEY_EXCLUDE,
+     .arg = "TARGETS",
+     .doc = "Targets never to scan, with the syntax of --ip, whichever source lists them"},
+    {.name = "excludefile",
+     .key = NMAP_KEY_EXCLUDE_FILE,
+     .arg = "PATH",
+     .doc = "The file containing the targets never to scan, one per line"},
     {.name = "scan", .key = NMAP_KEY_SCAN, .arg = "SYN|NULL|ACK|FIN|XMAS|UDP", .doc = "The type of scan to perform"},
     {.name = "speedup", .key = NMAP_KEY_SPEEDUP, .arg = "THREADS", .doc = "The number of threads to use"},
     {.name = "ports", .key = NMAP_KEY_PORTS, .arg = "PORTS", .doc = "The ports to scan (eg: 1-10 or 1,2,3 or 1,5-15)"},
+    {.name = "exclude-ports",
+     .key = NMAP_KEY_EXCLUDE_PORTS,
+     .arg = "PORTS",
+     .doc = "Ports never scanned, whichever option selects the others (eg: 9100-9107,515)"},
+    {.name = "top-ports",
+     .key = NMAP_KEY_TOP_PORTS,
+     .arg = "N",
+     .doc = "Scan the N ports most frequently found open, instead of every port (default)"},
+    {.name = "port-ratio",
+     .key = NMAP_KEY_PORT_RATIO,
+     .arg = "RATIO",
+     .doc = "Scan the ports found open at least this often, RATIO in [0, 1]"},
+    {.name = "max-parallelism",
+     .key = NMAP_KEY_MAX_PARALLELISM,
+     .arg = "PROBES",
+     .doc = "The maximum number of probes in flight across all threads"},
+    {.name = "elastic",
+     .key = NMAP_KEY_ELASTIC,
+     .arg = "MIN-MAX",
+     .doc = "Resize the thread pool during the scan between MIN and MAX threads (overrides --speedup)"},
+    {.name = "resolvers",
+     .key = NMAP_KEY_RESOLVERS,
+     .arg = "THREADS",
+     .doc = "The number of hostnames of the targets resolved concurrently, ahead of the scan (default 8)"},
+    {.name = "min-hostgroup",
+     .key = NMAP_KEY_MIN_HOSTGROUP,
+     .arg = "HOSTS",
+     .doc = "The size of the first host group, groups grow while the scan is healthy (default 16)"},
+    {.name = "max-hostgroup",
+     .key = NMAP_KEY_MAX_HOSTGROUP,
+     .arg = "HOSTS",
+     .doc = "The maximum number of hosts scanned together in a group (default 1024)"},
+    {.name = "randomize",
+     .key = NMAP_KEY_RANDOMIZE,
+     .doc = "Scan the hosts of each target specification and the ports in a pseudo-random order"},
+    {.name = "seed",
+     .key = NMAP_KEY_SEED,
+     .arg = "SEED",
+     .doc = "The seed of the random order, the same seed gives the same order (implies --randomize)"},
+    {.name = "shard",
+     .key = NMAP_KEY_SHARD,
+     .arg = "K/N",
+     .doc = "Only scan the K-th of N disjoint shards of the targets (use the same --seed on every shard)"},
+    {.name = "output",
+     .key = NMAP_KEY_OUTPUT,
+     .arg = "PATH",
+     .doc = "The file to write the results to (default: the standard output)"},
+    {.name = "output-format",
+     .key = NMAP_KEY_OUTPUT_FORMAT,
+     .arg = "text|jsonl|grepable",
+     .doc = "The format of the results, jsonl and grepable are written as soon as each port is final (default text)"},
+    {.name = "result-file",
+     .key = NMAP_KEY_RESULT_FILE,
+     .arg = "PATH",
+     .doc = "Also archive the results in a binary file, queried with ft_nmap_query"},
+    {.name = "checkpoint",
+     .key = NMAP_KEY_CHECKPOINT,
+     .arg = "PATH",
+     .doc = "Save the progress of the scan in this file every second, so that it can be resumed"},
+    {.name = "resume",
+     .key = NMAP_KEY_RESUME,
+     .doc = "Resume the scan saved in the --checkpoint file: the targets it completed are reported again, not "
+            "scanned"},
+    {.name = "baseline",
+     .key = NMAP_KEY_BASELINE,
+     .arg = "PATH",
+     .doc = "Rescan against a previous --result-file: its open ports are confirmed first, its closed and filtered "
+            "ports retried less, and the ports that changed are reported"},
+    {.name = "discovery",
+     .key = NMAP_KEY_DISCOVERY,
+     .arg = "echo,syn,ack,timestamp,arp|none",
+     .doc = "The probes finding the live hosts, only they are scanned: ICMP echo, TCP SYN to 443, TCP ACK to 80, ICMP "
+            "timestamp, ARP on the local subnet. none scans every target (default echo,syn,ack,timestamp)"},
+    {.name = "stats", .key = NMAP_KEY_STATS, .doc = "Print engine metrics on stderr at the end of the scan"},
     {},
   };
   static const struct argp argp = {.options = argOptions, .parser = parseOpt, .doc = "Nmap, but worse."};
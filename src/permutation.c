@@ -0,0 +1,45 @@
+//
+// Created by loumouli on 4/22/24.
+//
+
+#include "ft_nmap.h"
+
+uint64_t permutation_mix(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+void permutation_init(NMAP_Permutation* permutation, const uint64_t range, const bool randomize, uint64_t seed) {
+  uint32_t bits = 2;
+
+  while (bits < 64 && (1ULL << bits) < range)
+    bits += 2;
+  permutation->range = range;
+  permutation->halfBits = bits / 2;
+  permutation->rounds = randomize && range > 1 ? PERMUTATION_ROUNDS : 0;
+  for (uint32_t i = 0; i < PERMUTATION_ROUNDS; ++i) {
+    seed = permutation_mix(seed);
+    permutation->keys[i] = seed;
+  }
+}
+
+uint64_t permutation_at(const NMAP_Permutation* permutation, uint64_t i) {
+  const uint64_t mask = (1ULL << permutation->halfBits) - 1;
+
+  if (permutation->rounds == 0)
+    return i;
+  // The network is a bijection on [0, 4^halfBits) and range covers more than a quarter of it: a few walks at most
+  do {
+    uint64_t left = i >> permutation->halfBits;
+    uint64_t right = i & mask;
+    for (uint32_t round = 0; round < permutation->rounds; ++round) {
+      const uint64_t next = left ^ (permutation_mix(right ^ permutation->keys[round]) & mask);
+      left = right;
+      right = next;
+    }
+    i = left << permutation->halfBits | right;
+  } while (i >= permutation->range);
+  return i;
+}
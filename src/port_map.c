@@ -0,0 +1,53 @@
+//
+// Created by loumouli on 4/18/24.
+//
+
+#include "ft_nmap.h"
+
+size_t portMap_words(const uint32_t count) { return count / PORT_MAP_PER_WORD + 1; }
+
+int64_t portMap_init(NMAP_PortMap* map, const uint32_t count) {
+  map->count = count;
+  map->words = calloc(portMap_words(count), sizeof(uint64_t));
+  return map->words == NULL;
+}
+
+void portMap_destroy(NMAP_PortMap* map) {
+  free(map->words);
+  map->words = NULL;
+  map->count = 0;
+}
+
+NMAP_PortStatus portMap_get(const NMAP_PortMap* map, const uint32_t i) {
+  const uint64_t code = map->words[i / PORT_MAP_PER_WORD] >> (i % PORT_MAP_PER_WORD * PORT_MAP_BITS) & PORT_MAP_MASK;
+  return code ? 1U << code : NMAP_UNKNOWN;
+}
+
+void portMap_set(NMAP_PortMap* map, const uint32_t i, const NMAP_PortStatus status) {
+  const uint64_t code = status ? __builtin_ctz(status) : 0;
+  const uint32_t shift = i % PORT_MAP_PER_WORD * PORT_MAP_BITS;
+  uint64_t* const word = map->words + i / PORT_MAP_PER_WORD;
+
+  *word = (*word & ~(PORT_MAP_MASK << shift)) | code << shift;
+}
+
+void portMap_fold(NMAP_PortMap* map, const uint32_t i, const NMAP_PortStatus status) {
+  static const uint64_t openCode = __builtin_ctz(NMAP_OPEN);
+  const uint64_t code = status ? __builtin_ctz(status) : 0;
+  const uint32_t shift = i % PORT_MAP_PER_WORD * PORT_MAP_BITS;
+  _Atomic uint64_t* const word = (_Atomic uint64_t*)(map->words + i / PORT_MAP_PER_WORD);
+  uint64_t old = atomic_load_explicit(word, memory_order_relaxed);
+
+  do {
+    const uint64_t oldCode = old >> shift & PORT_MAP_MASK;
+    // The silence of a UDP port does not tell anything against a reply to another scan type
+    if (oldCode == openCode || (status == NMAP_OPEN_FILTERED && oldCode))
+      return;
+  } while (!atomic_compare_exchange_weak_explicit(word, &old, (old & ~(PORT_MAP_MASK << shift)) | code << shift,
+                                                  memory_order_relaxed, memory_order_relaxed));
+}
+
+void portMap_copy(NMAP_PortMap* dst, const uint32_t offset, const NMAP_PortMap* src) {
+  for (uint32_t i = 0; i < src->count; ++i)
+    portMap_set(dst, offset + i, portMap_get(src, i));
+}
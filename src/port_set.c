@@ -0,0 +1,92 @@
+//
+// Created by loumouli on 4/29/24.
+//
+
+#include "ft_nmap.h"
+
+void portSet_clear(NMAP_PortSet* set) {
+  memset(set, 0, sizeof(NMAP_PortSet));
+}
+
+bool portSet_has(const NMAP_PortSet* set, const uint16_t port) {
+  return set->words[port / 64] >> port % 64 & 1;
+}
+
+uint32_t portSet_addRange(NMAP_PortSet* set, const uint16_t first, const uint16_t last) {
+  uint32_t already = 0;
+
+  for (uint32_t i = first / 64; i <= last / 64U; ++i) {
+    uint64_t mask = ~0ULL;
+    if (i == first / 64U)
+      mask &= ~0ULL << first % 64;
+    if (i == last / 64U)
+      mask &= ~0ULL >> (63 - last % 64);
+    already += __builtin_popcountll(set->words[i] & mask);
+    set->size += __builtin_popcountll(~set->words[i] & mask);
+    set->words[i] |= mask;
+  }
+  return already;
+}
+
+/**
+ * @brief count the ports of a set again, after its words were combined with another set.
+ * @param set {NMAP_PortSet*} - Set.
+ */
+static void portSet_count(NMAP_PortSet* set) {
+  set->size = 0;
+  for (uint32_t i = 0; i < PORTSET_WORDS; ++i)
+    set->size += __builtin_popcountll(set->words[i]);
+}
+
+void portSet_subtract(NMAP_PortSet* set, const NMAP_PortSet* other) {
+  for (uint32_t i = 0; i < PORTSET_WORDS; ++i)
+    set->words[i] &= ~other->words[i];
+  portSet_count(set);
+}
+
+void portSet_intersect(NMAP_PortSet* set, const NMAP_PortSet* other) {
+  for (uint32_t i = 0; i < PORTSET_WORDS; ++i)
+    set->words[i] &= other->words[i];
+  portSet_count(set);
+}
+
+int32_t portSet_next(const NMAP_PortSet* set, const uint32_t from) {
+  if (from > UINT16_MAX)
+    return -1;
+
+  uint32_t i = from / 64;
+  uint64_t word = set->words[i] & ~0ULL << from % 64;
+  while (word == 0) {
+    if (++i == PORTSET_WORDS)
+      return -1;
+    word = set->words[i];
+  }
+  return i * 64 + __builtin_ctzll(word);
+}
+
+int64_t portSet_parse(NMAP_PortSet* set, const char* spec, bool* duplicate) {
+  const char* cursor = spec;
+  char* endptr;
+
+  if (*spec == '\0')
+    return 1;
+  while (*cursor) {
+    errno = 0;
+    const unsigned long first = strtoul(cursor, &endptr, 0);
+    if (errno == ERANGE || endptr == cursor || first > UINT16_MAX)
+      return 1;
+    unsigned long last = first;
+    if (*endptr == '-') {
+      cursor = endptr + 1;
+      last = strtoul(cursor, &endptr, 0);
+      if (errno == ERANGE || endptr == cursor || last < first || last > UINT16_MAX)
+        return 1;
+    }
+    if (*endptr && *endptr != ',')
+      return 1;
+    if (portSet_addRange(set, first, last))
+      *duplicate = true;
+    cursor = endptr + !!*endptr;
+  }
+  return 0;
+}
@@ -0,0 +1,109 @@
+//
+// Created by loumouli on 4/20/24.
+//
+
+#include "ft_nmap.h"
+
+static uint32_t probeSlab_hash(const NMAP_ProbeSlab* slab, const uint32_t host, const uint16_t port) {
+  const uint64_t key = (uint64_t)host << 16 | port;
+  return (key * 0x9E3779B97F4A7C15ULL) >> 32 & (2 * slab->capacity - 1);
+}
+
+int64_t probeSlab_init(NMAP_ProbeSlab* slab, const uint32_t capacity) {
+  uint32_t slots = PROBE_SLAB_ALIGN;
+  while (slots < capacity)
+    slots <<= 1;
+  // every column is a multiple of PROBE_SLAB_ALIGN bytes since slots is
+  uint8_t* block = aligned_alloc(PROBE_SLAB_ALIGN, (size_t)slots * (sizeof(uint64_t) + 5 * sizeof(uint32_t) +
+                                                                 sizeof(uint16_t) + 2 * sizeof(uint8_t)));
+  if (block == NULL)
+    return 1;
+  slab->capacity = slots;
+  slab->sendNs = (uint64_t*)block;
+  slab->index = (uint32_t*)(slab->sendNs + slots);
+  slab->host = slab->index + 2 * slots;
+  slab->portIdx = slab->host + slots;
+  slab->freeSlots = slab->portIdx + slots;
+  slab->port = (uint16_t*)(slab->freeSlots + slots);
+  slab->state = (uint8_t*)(slab->port + slots);
+  slab->attempts = slab->state + slots;
+  probeSlab_clear(slab);
+  return 0;
+}
+
+void probeSlab_destroy(NMAP_ProbeSlab* slab) {
+  // every column lives in the block of sendNs
+  free(slab->sendNs);
+  memset(slab, 0, sizeof(NMAP_ProbeSlab));
+}
+
+void probeSlab_clear(NMAP_ProbeSlab* slab) {
+  slab->used = 0;
+  memset(slab->index, 0, 2 * slab->capacity * sizeof(uint32_t));
+  memset(slab->state, 0, slab->capacity);
+  // slot 0 is handed out first
+  for (uint32_t i = 0; i < slab->capacity; ++i)
+    slab->freeSlots[i] = slab->capacity - 1 - i;
+}
+
+int64_t probeSlab_insert(NMAP_ProbeSlab* slab, const uint32_t host, const uint32_t portIdx, const uint16_t port) {
+  if (slab->used == slab->capacity)
+    return -1;
+  const uint32_t slot = slab->freeSlots[slab->capacity - slab->used - 1];
+  const uint32_t mask = 2 * slab->capacity - 1;
+  uint32_t pos = probeSlab_hash(slab, host, port);
+
+  ++slab->used;
+  slab->host[slot] = host;
+  slab->portIdx[slot] = portIdx;
+  slab->port[slot] = port;
+  slab->state[slot] = SLOT_SENT;
+  slab->attempts[slot] = 0;
+  // the index is twice as large as the slab, there is always an empty entry
+  while (slab->index[pos])
+    pos = (pos + 1) & mask;
+  slab->index[pos] = slot + 1;
+  return slot;
+}
+
+int64_t probeSlab_find(const NMAP_ProbeSlab* slab, const uint32_t host, const uint16_t port) {
+  const uint32_t mask = 2 * slab->capacity - 1;
+
+  for (uint32_t pos = probeSlab_hash(slab, host, port); slab->index[pos]; pos = (pos + 1) & mask) {
+    const uint32_t slot = slab->index[pos] - 1;
+    if (slab->host[slot] == host && slab->port[slot] == port)
+      return slot;
+  }
+  return -1;
+}
+
+void probeSlab_remove(NMAP_ProbeSlab* slab, const uint32_t slot) {
+  const uint32_t mask = 2 * slab->capacity - 1;
+  uint32_t hole = probeSlab_hash(slab, slab->host[slot], slab->port[slot]);
+
+  while (slab->index[hole] != slot + 1)
+    hole = (hole + 1) & mask;
+  // backward shift: move up every entry of the cluster that would not be found anymore across the hole
+  for (uint32_t next = (hole + 1) & mask; slab->index[next]; next = (next + 1) & mask) {
+    const uint32_t other = slab->index[next] - 1;
+    const uint32_t home = probeSlab_hash(slab, slab->host[other], slab->port[other]);
+    if (((next - home) & mask) >= ((next - hole) & mask)) {
+      slab->index[hole] = slab->index[next];
+      hole = next;
+    }
+  }
+  slab->index[hole] = 0;
+  slab->state[slot] = SLOT_FREE;
+  --slab->used;
+  slab->freeSlots[slab->capacity - slab->used - 1] = slot;
+}
+
+bool probeSlab_hasExpired(const NMAP_ProbeSlab* slab, const uint64_t nowNs, const uint64_t timeoutNs) {
+  const uint64_t* const sendNs = slab->sendNs;
+  const uint8_t* const state = slab->state;
+  uint64_t expired = 0;
+
+  for (uint32_t i = 0; i < slab->capacity; ++i)
+    expired |= (uint64_t)(state[i] == SLOT_SENT) & (nowNs - sendNs[i] > timeoutNs);
+  return expired;
+}
@@ -0,0 +1,226 @@
+//
+// Created by loumouli on 4/28/24.
+//
+
+#include "ft_nmap.h"
+
+in_addr_t resolver_getaddrinfo(const char* name) {
+  const struct addrinfo hints = {
+    .ai_family = AF_INET,
+  };
+  struct addrinfo* result;
+
+  if (getaddrinfo(name, NULL, &hints, &result))
+    return INADDR_NONE;
+
+  const in_addr_t ip = ((struct sockaddr_in*)result->ai_addr)->sin_addr.s_addr;
+  freeaddrinfo(result);
+  return ip;
+}
+
+static uint64_t resolver_hash(const char* name) {
+  uint64_t hash = 0xcbf29ce484222325ULL; // FNV-1a
+
+  for (; *name; ++name)
+    hash = (hash ^ (uint8_t)*name) * 0x100000001b3ULL;
+  return hash;
+}
+
+/**
+ * @brief find the slot of a hostname in the cache.
+ * @param resolver {const NMAP_Resolver*} - Resolver, locked.
+ * @param name {const char*} - Hostname.
+ * @return {NMAP_ResolverEntry**} - Its slot, or the empty slot it goes to.
+ */
+static NMAP_ResolverEntry** resolver_slot(const NMAP_Resolver* resolver, const char* name) {
+  uint64_t i = resolver_hash(name) & (resolver->capacity - 1);
+
+  while (resolver->table[i] && strcmp(resolver->table[i]->name, name))
+    i = (i + 1) & (resolver->capacity - 1);
+  return resolver->table + i;
+}
+
+/**
+ * @brief double the capacity of the cache.
+ * @param resolver {NMAP_Resolver*} - Resolver, locked.
+ * @return {int64_t} - 0 if success, -1 on allocation failure.
+ */
+static int64_t resolver_grow(NMAP_Resolver* resolver) {
+  NMAP_ResolverEntry** const table = resolver->table;
+  const uint64_t capacity = resolver->capacity;
+
+  resolver->table = calloc(capacity * 2, sizeof(NMAP_ResolverEntry*));
+  if (resolver->table == NULL) {
+    resolver->table = table;
+    return -1;
+  }
+  resolver->capacity = capacity * 2;
+  for (uint64_t i = 0; i < capacity; ++i)
+    if (table[i])
+      *resolver_slot(resolver, table[i]->name) = table[i];
+  free(table);
+  return 0;
+}
+
+static void* resolver_main(void* arg) {
+  NMAP_Resolver* const resolver = arg;
+
+  pthread_mutex_lock(&resolver->lock);
+  while (true) {
+    while (resolver->stop == false && resolver->nextJob == array_size(resolver->jobs))
+      pthread_cond_wait(&resolver->queued, &resolver->lock);
+    if (resolver->stop)
+      break;
+    NMAP_ResolverEntry* const entry = *(NMAP_ResolverEntry**)array_get(resolver->jobs, resolver->nextJob++);
+    if (resolver->nextJob == array_size(resolver->jobs)) {
+      array_clear(resolver->jobs);
+      resolver->nextJob = 0;
+    }
+    // The name of an entry never changes and the entry is never moved, it is read without the lock
+    pthread_mutex_unlock(&resolver->lock);
+    const in_addr_t ip = resolver->resolve(entry->name);
+    pthread_mutex_lock(&resolver->lock);
+    entry->ip = ip;
+    entry->done = true;
+    resolver->lookups += 1;
+    pthread_cond_broadcast(&resolver->resolved);
+  }
+  pthread_mutex_unlock(&resolver->lock);
+  return NULL;
+}
+
+/**
+ * @brief start the threads, a resolver without any falls back to resolving in resolver_wait.
+ * @param resolver {NMAP_Resolver*} - Resolver, locked.
+ */
+static void resolver_start(NMAP_Resolver* resolver) {
+  resolver->threads = calloc(resolver->nThreads, sizeof(pthread_t));
+  if (resolver->threads == NULL) {
+    perror("malloc");
+    return;
+  }
+  for (uint32_t i = 0; i < resolver->nThreads; ++i) {
+    const int error = pthread_create(resolver->threads + resolver->running, NULL, resolver_main, resolver);
+    if (error) {
+      fprintf(stderr, "pthread_create/resolver: %s\n", strerror(error));
+      break;
+    }
+    resolver->running += 1;
+  }
+}
+
+NMAP_Resolver* resolver_create(NMAP_ResolveFunction* resolve, const uint32_t nThreads) {
+  NMAP_Resolver* const resolver = calloc(1, sizeof(NMAP_Resolver));
+
+  if (resolver == NULL)
+    return NULL;
+  resolver->resolve = resolve;
+  resolver->nThreads = nThreads;
+  resolver->capacity = RESOLVER_MIN_CAPACITY;
+  resolver->table = calloc(resolver->capacity, sizeof(NMAP_ResolverEntry*));
+  resolver->jobs = array(sizeof(NMAP_ResolverEntry*), 0, 0, NULL, NULL);
+  if (resolver->table == NULL || resolver->jobs == NULL) {
+    free(resolver->table);
+    array_destroy(resolver->jobs);
+    free(resolver);
+    return NULL;
+  }
+  pthread_mutex_init(&resolver->lock, NULL);
+  pthread_cond_init(&resolver->queued, NULL);
+  pthread_cond_init(&resolver->resolved, NULL);
+  return resolver;
+}
+
+void resolver_destroy(NMAP_Resolver* resolver) {
+  if (resolver == NULL)
+    return;
+  pthread_mutex_lock(&resolver->lock);
+  resolver->stop = true;
+  pthread_cond_broadcast(&resolver->queued);
+  pthread_mutex_unlock(&resolver->lock);
+  // A thread stuck in a lookup is waited for, getaddrinfo gives up after its own timeout
+  for (uint32_t i = 0; i < resolver->running; ++i)
+    pthread_join(resolver->threads[i], NULL);
+  for (uint64_t i = 0; i < resolver->capacity; ++i) {
+    if (resolver->table[i] == NULL)
+      continue;
+    free(resolver->table[i]->name);
+    free(resolver->table[i]);
+  }
+  free(resolver->table);
+  free(resolver->threads);
+  array_destroy(resolver->jobs);
+  pthread_cond_destroy(&resolver->resolved);
+  pthread_cond_destroy(&resolver->queued);
+  pthread_mutex_destroy(&resolver->lock);
+  free(resolver);
+}
+
+/**
+ * @brief find a hostname in the cache, queueing it if it is not there yet.
+ * @param resolver {NMAP_Resolver*} - Resolver, locked.
+ * @param name {const char*} - Hostname.
+ * @return {NMAP_ResolverEntry*} - Its entry, NULL on allocation failure.
+ */
+static NMAP_ResolverEntry* resolver_find(NMAP_Resolver* resolver, const char* name) {
+  NMAP_ResolverEntry** slot = resolver_slot(resolver, name);
+
+  if (*slot) {
+    resolver->hits += 1;
+    return *slot;
+  }
+  if ((resolver->count + 1) * 2 > resolver->capacity) {
+    if (resolver_grow(resolver))
+      return NULL;
+    slot = resolver_slot(resolver, name);
+  }
+  NMAP_ResolverEntry* const entry = calloc(1, sizeof(NMAP_ResolverEntry));
+  if (entry == NULL || (entry->name = strdup(name)) == NULL || array_pushBack(resolver->jobs, &entry, 1)) {
+    if (entry)
+      free(entry->name);
+    free(entry);
+    return NULL;
+  }
+  *slot = entry;
+  resolver->count += 1;
+  if (resolver->threads == NULL)
+    resolver_start(resolver);
+  pthread_cond_signal(&resolver->queued);
+  return entry;
+}
+
+int64_t resolver_submit(NMAP_Resolver* resolver, const char* name) {
+  pthread_mutex_lock(&resolver->lock);
+  const NMAP_ResolverEntry* const entry = resolver_find(resolver, name);
+  pthread_mutex_unlock(&resolver->lock);
+  return entry ? 0 : -1;
+}
+
+in_addr_t resolver_wait(NMAP_Resolver* resolver, const char* name) {
+  pthread_mutex_lock(&resolver->lock);
+  // A hostname read ahead is already queued, it is not a cache hit
+  NMAP_ResolverEntry* entry = *resolver_slot(resolver, name);
+  if (entry == NULL)
+    entry = resolver_find(resolver, name);
+  while (entry && entry->done == false) {
+    if (resolver->running) {
+      pthread_cond_wait(&resolver->resolved, &resolver->lock);
+      continue;
+    }
+    // No thread could be started, the job is done here (and left in the queue for nobody)
+    pthread_mutex_unlock(&resolver->lock);
+    const in_addr_t ip = resolver->resolve(entry->name);
+    pthread_mutex_lock(&resolver->lock);
+    entry->ip = ip;
+    entry->done = true;
+    resolver->lookups += 1;
+  }
+  const in_addr_t ip = entry ? entry->ip : INADDR_NONE;
+  pthread_mutex_unlock(&resolver->lock);
+  return ip;
+}
+
+void resolver_printStats(const NMAP_Resolver* resolver, FILE* stream) {
+  fprintf(stream, "dns: %lu hostnames resolved by %u threads, %lu cache hits\n", resolver->lookups,
+          resolver->running, resolver->hits);
+}
@@ -0,0 +1,363 @@
+//
+// Created by loumouli on 4/23/24.
+//
+
+#include "ft_nmap.h"
+
+static uint8_t* writeVarint(uint8_t* out, uint32_t value) {
+  while (value >= 0x80) {
+    *out++ = value | 0x80;
+    value >>= 7;
+  }
+  *out++ = value;
+  return out;
+}
+
+static bool readVarint(const uint8_t** cursor, const uint8_t* end, uint32_t* value) {
+  *value = 0;
+  for (uint32_t shift = 0; *cursor < end && shift < 32; shift += 7) {
+    const uint8_t byte = *(*cursor)++;
+    *value |= (uint32_t)(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief append bytes to the file, remembering the first failure.
+ * @param writer {NMAP_ResultWriter*} - Writer.
+ * @param data {const void*} - Bytes to write.
+ * @param size {size_t} - Number of bytes.
+ */
+static void resultWriter_write(NMAP_ResultWriter* writer, const void* data, const size_t size) {
+  if (writer->failed == false && size && fwrite(data, 1, size, writer->file) != size) {
+    perror("ft_nmap: failed to write the result file");
+    writer->failed = true;
+  }
+  writer->offset += size;
+}
+
+static void resultWriter_align(NMAP_ResultWriter* writer) {
+  static const uint8_t zeros[8] = {0};
+  resultWriter_write(writer, zeros, -writer->offset & 7);
+}
+
+uint32_t* resultFile_sortPorts(const Array* ports) {
+  uint32_t* byPort = malloc(array_size(ports) * sizeof(uint32_t) + 1);
+  uint32_t* position = malloc((UINT16_MAX + 1) * sizeof(uint32_t));
+
+  if (byPort && position) {
+    // The ports are unique, sorting them is a walk over the whole port space
+    memset(position, 0xff, (UINT16_MAX + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < array_size(ports); ++i)
+      position[*(const uint16_t*)array_cGet(ports, i)] = i;
+    for (uint32_t port = 0, n = 0; port <= UINT16_MAX; ++port)
+      if (position[port] != UINT32_MAX)
+        byPort[n++] = position[port];
+  }
+  else {
+    free(byPort);
+    byPort = NULL;
+  }
+  free(position);
+  return byPort;
+}
+
+uint32_t resultFile_encodeRuns(const NMAP_PortMap* results, const Array* ports, const uint32_t* byPort,
+                               uint8_t* out) {
+  const uint32_t nPorts = array_size(ports);
+  uint8_t* const start = out;
+  uint32_t next = 0;
+
+  for (uint32_t k = 0; k < nPorts;) {
+    const NMAP_PortStatus status = portMap_get(results, byPort[k]);
+    const uint16_t first = *(const uint16_t*)array_cGet(ports, byPort[k]);
+    uint32_t length = 1;
+    if (status == NMAP_UNKNOWN) {
+      ++k;
+      continue;
+    }
+    while (k + length < nPorts && *(const uint16_t*)array_cGet(ports, byPort[k + length]) == first + length &&
+           portMap_get(results, byPort[k + length]) == status)
+      ++length;
+    out = writeVarint(out, first - next);
+    out = writeVarint(out, (length - 1) << 3 | __builtin_ctz(status));
+    next = first + length;
+    k += length;
+  }
+  return out - start;
+}
+
+int64_t resultWriter_open(NMAP_ResultWriter* writer, const char* path, const Array* ports, const uint32_t scan) {
+  memset(writer, 0, sizeof(NMAP_ResultWriter));
+  writer->ports = ports;
+  writer->header.scan = scan;
+  writer->header.portCount = array_size(ports);
+  writer->file = fopen(path, "wb");
+  if (writer->file == NULL) {
+    fprintf(stderr, "ft_nmap: failed to open '%s': %s\n", path, strerror(errno));
+    return 1;
+  }
+  setvbuf(writer->file, NULL, _IOFBF, RESULT_FILE_BUFFER);
+  // Two varints of at most 3 bytes per run, and there are at most as many runs as ports
+  writer->runs = malloc(6 * (size_t)writer->header.portCount + 1);
+  writer->byPort = resultFile_sortPorts(ports);
+  writer->hosts = array(sizeof(NMAP_ResultHost), 0, 0, NULL, NULL);
+  writer->open = array(sizeof(uint32_t[2]), 0, 0, NULL, NULL);
+  if (writer->runs == NULL || writer->byPort == NULL || writer->hosts == NULL || writer->open == NULL) {
+    perror("malloc");
+    return 1;
+  }
+  // Written again once every offset is known
+  resultWriter_write(writer, &writer->header, sizeof(NMAP_ResultHeader));
+  return writer->failed;
+}
+
+void resultWriter_addHost(NMAP_ResultWriter* writer, const t_host* host) {
+  NMAP_ResultHost entry = {.ip = host->ip, .runsOffset = writer->offset};
+  const uint32_t hostIdx = array_size(writer->hosts);
+  NMAP_ResultRun run;
+
+  if (writer->failed)
+    return;
+  entry.runsSize = resultFile_encodeRuns(&host->results, writer->ports, writer->byPort, writer->runs);
+  NMAP_ResultRuns runs = {.cursor = writer->runs, .end = writer->runs + entry.runsSize};
+  while (resultFile_nextRun(&runs, &run)) {
+    entry.analyzed += run.length;
+    for (uint32_t j = 0; run.status == NMAP_OPEN && j < run.length; ++j) {
+      const uint32_t pair[2] = {run.first + j, hostIdx};
+      if (array_pushBack(writer->open, pair, 1))
+        writer->failed = true;
+    }
+    entry.open += run.status == NMAP_OPEN ? run.length : 0;
+  }
+  resultWriter_write(writer, writer->runs, entry.runsSize);
+  if (array_pushBack(writer->hosts, &entry, 1))
+    writer->failed = true;
+  if (writer->failed)
+    perror("ft_nmap: failed to add a host to the result file");
+}
+
+static int ArrayFn_compareIpEntry(const void* lhs, const void* rhs, unused void* param) {
+  const NMAP_ResultIpEntry* a = lhs;
+  const NMAP_ResultIpEntry* b = rhs;
+  return (a->ip > b->ip) - (a->ip < b->ip);
+}
+
+static int ArrayFn_compareOpenPort(const void* lhs, const void* rhs, unused void* param) {
+  const uint32_t* a = lhs;
+  const uint32_t* b = rhs;
+  return (a[0] > b[0]) - (a[0] < b[0]);
+}
+
+static int ArrayFn_mapHostToIpEntry(unused const Array* arr, const size_t i, void* dst, const void* src,
+                                    unused void* param) {
+  const NMAP_ResultHost* host = src;
+  *(NMAP_ResultIpEntry*)dst = (NMAP_ResultIpEntry){.ip = ntohl(host->ip.s_addr), .host = i};
+  return 0;
+}
+
+/**
+ * @brief write every section after the runs, each one built from the host table and the open ports.
+ * @param writer {NMAP_ResultWriter*} - Writer.
+ */
+static void resultWriter_writeIndices(NMAP_ResultWriter* writer) {
+  NMAP_ResultHeader* const header = &writer->header;
+  Array* ipIndex = array_cMap(writer->hosts, sizeof(NMAP_ResultIpEntry), NULL, ArrayFn_mapHostToIpEntry, NULL);
+  Array* portIndex = array(sizeof(NMAP_ResultPortEntry), 0, 0, NULL, NULL);
+
+  // Merge sorts: the hosts of an address and the postings of a port stay in scan order
+  if (ipIndex == NULL || portIndex == NULL || array_sort(ipIndex, ArrayFn_compareIpEntry, NULL) ||
+      array_sort(writer->open, ArrayFn_compareOpenPort, NULL)) {
+    perror("malloc");
+    writer->failed = true;
+  }
+  for (uint64_t i = 0; writer->failed == false && i < array_size(writer->open); ++i) {
+    const uint32_t* pair = array_cGet(writer->open, i);
+    NMAP_ResultPortEntry* last = array_empty(portIndex) ? NULL : array_back(portIndex);
+    if (last && last->port == pair[0])
+      ++last->count;
+    else if (array_pushBack(portIndex, &(NMAP_ResultPortEntry){.port = pair[0], .count = 1, .postings = i}, 1))
+      writer->failed = true;
+  }
+  if (writer->failed == false) {
+    resultWriter_align(writer);
+    header->hostCount = array_size(writer->hosts);
+    header->hostsOffset = writer->offset;
+    resultWriter_write(writer, array_cData(writer->hosts), header->hostCount * sizeof(NMAP_ResultHost));
+    header->ipIndexOffset = writer->offset;
+    resultWriter_write(writer, array_cData(ipIndex), header->hostCount * sizeof(NMAP_ResultIpEntry));
+    header->portsOffset = writer->offset;
+    for (uint32_t k = 0; k < header->portCount; ++k)
+      resultWriter_write(writer, array_cGet(writer->ports, writer->byPort[k]), sizeof(uint16_t));
+    resultWriter_align(writer);
+    header->openPortCount = array_size(portIndex);
+    header->portIndexOffset = writer->offset;
+    resultWriter_write(writer, array_cData(portIndex), header->openPortCount * sizeof(NMAP_ResultPortEntry));
+    header->postingsOffset = writer->offset;
+    for (uint64_t i = 0; i < array_size(writer->open); ++i)
+      resultWriter_write(writer, (const uint32_t*)array_cGet(writer->open, i) + 1, sizeof(uint32_t));
+    header->fileSize = writer->offset;
+  }
+  array_destroy(ipIndex);
+  array_destroy(portIndex);
+}
+
+int64_t resultWriter_close(NMAP_ResultWriter* writer) {
+  bool failed = writer->failed || writer->file == NULL;
+
+  if (failed == false) {
+    resultWriter_writeIndices(writer);
+    memcpy(writer->header.magic, RESULT_FILE_MAGIC, sizeof(writer->header.magic));
+    writer->header.version = RESULT_FILE_VERSION;
+    if (writer->failed == false && fseek(writer->file, 0, SEEK_SET) == 0)
+      resultWriter_write(writer, &writer->header, sizeof(NMAP_ResultHeader));
+    failed = writer->failed || fflush(writer->file);
+  }
+  if (writer->file && fclose(writer->file) && failed == false) {
+    perror("ft_nmap: failed to write the result file");
+    failed = true;
+  }
+  free(writer->runs);
+  free(writer->byPort);
+  array_destroy(writer->hosts);
+  array_destroy(writer->open);
+  memset(writer, 0, sizeof(NMAP_ResultWriter));
+  return failed;
+}
+
+/**
+ * @brief check that a section of count elements lies within the file, aligned for its elements.
+ * @param file {const NMAP_ResultFile*} - Mapping.
+ * @param offset {uint64_t} - Offset of the section.
+ * @param count {uint64_t} - Number of elements.
+ * @param size {size_t} - Size of an element.
+ * @return {bool} - true if the section is valid.
+ */
+static bool resultFile_fits(const NMAP_ResultFile* file, const uint64_t offset, const uint64_t count,
+                            const size_t size) {
+  return offset % 8 == 0 && offset <= file->size && count <= (file->size - offset) / size;
+}
+
+int64_t resultFile_map(NMAP_ResultFile* file, const char* path) {
+  const int fd = open(path, O_RDONLY | O_CLOEXEC);
+  struct stat st;
+
+  memset(file, 0, sizeof(NMAP_ResultFile));
+  if (fd == -1 || fstat(fd, &st)) {
+    fprintf(stderr, "ft_nmap: failed to open '%s': %s\n", path, strerror(errno));
+    if (fd != -1)
+      close(fd);
+    return 1;
+  }
+  if ((size_t)st.st_size < sizeof(NMAP_ResultHeader)) {
+    fprintf(stderr, "ft_nmap: '%s' is not a result file\n", path);
+    close(fd);
+    return 1;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) {
+    fprintf(stderr, "ft_nmap: failed to map '%s': %s\n", path, strerror(errno));
+    return 1;
+  }
+  file->data = data;
+  file->size = st.st_size;
+  const NMAP_ResultHeader* header = file->header = data;
+  if (memcmp(header->magic, RESULT_FILE_MAGIC, sizeof(header->magic)) || header->version != RESULT_FILE_VERSION ||
+      header->fileSize != file->size || !resultFile_fits(file, header->hostsOffset, header->hostCount,
+                                                         sizeof(NMAP_ResultHost)) ||
+      !resultFile_fits(file, header->ipIndexOffset, header->hostCount, sizeof(NMAP_ResultIpEntry)) ||
+      !resultFile_fits(file, header->portsOffset, header->portCount, sizeof(uint16_t)) ||
+      !resultFile_fits(file, header->portIndexOffset, header->openPortCount, sizeof(NMAP_ResultPortEntry)) ||
+      !resultFile_fits(file, header->postingsOffset, 0, sizeof(uint32_t))) {
+    fprintf(stderr, "ft_nmap: '%s' is not a result file of version %u, or is corrupted\n", path,
+            RESULT_FILE_VERSION);
+    resultFile_unmap(file);
+    return 1;
+  }
+  file->hosts = (const NMAP_ResultHost*)(file->data + header->hostsOffset);
+  file->ipIndex = (const NMAP_ResultIpEntry*)(file->data + header->ipIndexOffset);
+  file->ports = (const uint16_t*)(file->data + header->portsOffset);
+  file->portIndex = (const NMAP_ResultPortEntry*)(file->data + header->portIndexOffset);
+  file->postings = (const uint32_t*)(file->data + header->postingsOffset);
+  return 0;
+}
+
+void resultFile_unmap(NMAP_ResultFile* file) {
+  if (file->data)
+    munmap((void*)file->data, file->size);
+  memset(file, 0, sizeof(NMAP_ResultFile));
+}
+
+const NMAP_ResultIpEntry* resultFile_findHost(const NMAP_ResultFile* file, const struct in_addr ip,
+                                              uint64_t* count) {
+  const uint32_t key = ntohl(ip.s_addr);
+  uint64_t lo = 0, hi = file->header->hostCount;
+
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if (file->ipIndex[mid].ip < key)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  *count = 0;
+  while (lo + *count < file->header->hostCount && file->ipIndex[lo + *count].ip == key &&
+         file->ipIndex[lo + *count].host < file->header->hostCount)
+    ++*count;
+  return file->ipIndex + lo;
+}
+
+const uint32_t* resultFile_findPort(const NMAP_ResultFile* file, const uint16_t port, uint32_t* count) {
+  const uint64_t nPostings = (file->size - file->header->postingsOffset) / sizeof(uint32_t);
+  uint64_t lo = 0, hi = file->header->openPortCount;
+
+  *count = 0;
+  while (lo < hi) {
+    const uint64_t mid = lo + (hi - lo) / 2;
+    if (file->portIndex[mid].port < port)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == file->header->openPortCount || file->portIndex[lo].port != port)
+    return NULL;
+  const NMAP_ResultPortEntry* entry = file->portIndex + lo;
+  if (entry->postings > nPostings || entry->count > nPostings - entry->postings)
+    return NULL;
+  *count = entry->count;
+  return file->postings + entry->postings;
+}
+
+NMAP_ResultRuns resultFile_runs(const NMAP_ResultFile* file, const uint64_t host) {
+  if (host >= file->header->hostCount)
+    return (NMAP_ResultRuns){0};
+  const NMAP_ResultHost* entry = file->hosts + host;
+  if (entry->runsOffset < sizeof(NMAP_ResultHeader) ||
+      entry->runsOffset > file->header->hostsOffset || entry->runsSize > file->header->hostsOffset - entry->runsOffset)
+    return (NMAP_ResultRuns){0};
+  const uint8_t* runs = file->data + entry->runsOffset;
+  return (NMAP_ResultRuns){.cursor = runs, .end = runs + entry->runsSize, .next = 0};
+}
+
+bool resultFile_nextRun(NMAP_ResultRuns* runs, NMAP_ResultRun* run) {
+  uint32_t gap, code;
+
+  if (runs->cursor == runs->end || readVarint(&runs->cursor, runs->end, &gap) == false ||
+      readVarint(&runs->cursor, runs->end, &code) == false)
+    return false;
+  const uint64_t first = (uint64_t)runs->next + gap;
+  const uint64_t length = (code >> 3) + 1ULL;
+  const uint32_t status = code & 7;
+  if (first + length > UINT16_MAX + 1ULL || status == 0 || status > __builtin_ctz(NMAP_OPEN_FILTERED)) {
+    runs->cursor = runs->end;
+    return false;
+  }
+  run->first = first;
+  run->length = length;
+  run->status = 1 << status;
+  runs->next = first + length;
+  return true;
+}
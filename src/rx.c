@@ -0,0 +1,197 @@
+//
+// Created by loumouli on 4/17/24.
+//
+
+#include "ft_nmap.h"
+
+/**
+ * @brief bytes of a reply the analyses and the port lookup read past its IP header.
+ * @param protocol {uint8_t} - Protocol of the reply.
+ * @return {uint32_t} - Minimum size of the IP payload, 0 for a protocol that never answers a probe.
+ */
+static uint32_t rx_minPayload(const uint8_t protocol) {
+  switch (protocol) {
+  case IPPROTO_TCP:
+    return sizeof(struct tcphdr);
+  case IPPROTO_UDP:
+    return sizeof(struct udphdr);
+  case IPPROTO_ICMP:
+    // The error quotes the IP header of the probe and at least the 8 first bytes of its payload
+    return sizeof(struct icmphdr) + sizeof(struct iphdr) + sizeof(struct udphdr);
+  default:
+    return 0;
+  }
+}
+
+bool rx_parse(const NMAP_ScanType scanType, const struct pcap_pkthdr* head, const uint8_t* packet,
+              NMAP_Reply* reply) {
+  if (head->caplen < sizeof(struct ether_header) + sizeof(struct iphdr))
+    return false;
+  const struct iphdr* iphdr = (struct iphdr*)(packet + sizeof(struct ether_header));
+  const uint32_t iphdrLen = iphdr->ihl * 4;
+  const uint32_t minPayload = rx_minPayload(iphdr->protocol);
+  if (iphdrLen < sizeof(struct iphdr) || minPayload == 0 ||
+      head->caplen < sizeof(struct ether_header) + iphdrLen + minPayload)
+    return false;
+  const void* payload = (void*)((const uint8_t*)iphdr + iphdrLen);
+  NMAP_PortStatus result = NMAP_UNKNOWN;
+  switch (scanType) {
+  case NMAP_SCAN_SYN:
+    result = tcp_syn_analysis(iphdr, payload);
+    break;
+  case NMAP_SCAN_ACK:
+    result = tcp_ack_analysis(iphdr, payload);
+    break;
+  case NMAP_SCAN_NULL:
+    result = tcp_null_analysis(iphdr, payload);
+    break;
+  case NMAP_SCAN_FIN:
+    result = tcp_fin_analysis(iphdr, payload);
+    break;
+  case NMAP_SCAN_XMAS:
+    result = tcp_xmas_analysis(iphdr, payload);
+    break;
+  case NMAP_SCAN_UDP:
+    result = udp_analysis(iphdr, payload);
+    break;
+  default:
+    fprintf(stderr, "WTF are you doing\n");
+  }
+  // The filter admits any traffic to the interface, a packet that is not a reply to a probe is skipped silently
+  if (result == NMAP_UNKNOWN)
+    return false;
+  struct in_addr ip = *(struct in_addr*)&iphdr->saddr;
+  uint16_t src_port = 0;
+  if (iphdr->protocol == IPPROTO_TCP) {
+    const struct tcphdr* tcp_tmp = (struct tcphdr*)payload;
+    // The filter admits any TCP segment to the interface: a RST or SYN/ACK of a local connection is not a reply
+    if (ntohs(tcp_tmp->dest) != TCP_SOURCE_PORT)
+      return false;
+    src_port = ntohs(tcp_tmp->source);
+  }
+  if (iphdr->protocol == IPPROTO_UDP) {
+    const struct udphdr* udp_hdr = (struct udphdr*)payload;
+    src_port = ntohs(udp_hdr->source);
+  }
+  if (iphdr->protocol == IPPROTO_ICMP) {
+    const struct icmphdr* icmp_hdr = (struct icmphdr*)payload;
+    if (icmp_hdr->type == ICMP_DEST_UNREACH) {
+      const struct iphdr* original_ip_hdr = (struct iphdr*)((unsigned char*)icmp_hdr + sizeof(struct icmphdr));
+      const uint32_t original_ip_hdr_len = original_ip_hdr->ihl * 4;
+      // A malformed quoted header is skipped silently, like any packet that is not a reply
+      if (original_ip_hdr_len < 20)
+        return false;
+      if (head->caplen < sizeof(struct ether_header) + iphdrLen + sizeof(struct icmphdr) + original_ip_hdr_len +
+                             sizeof(struct udphdr))
+        return false;
+      // A late error about a probe of another scan type (a UDP port closed during a TCP scan) is not a reply
+      if (original_ip_hdr->protocol != (scanType == NMAP_SCAN_UDP ? IPPROTO_UDP : IPPROTO_TCP))
+        return false;
+      // we only have access to the first 8 bytes of the probe header -> src_port + dest_port + (seq_nbr or len + sum)
+      const void* original_hdr = (unsigned char*)original_ip_hdr + original_ip_hdr_len;
+      uint16_t probePort;
+      if (scanType == NMAP_SCAN_UDP) {
+        probePort = ntohs(((const struct udphdr*)original_hdr)->source);
+        src_port = ntohs(((const struct udphdr*)original_hdr)->dest);
+      }
+      else {
+        probePort = ntohs(((const struct tcphdr*)original_hdr)->source);
+        src_port = ntohs(((const struct tcphdr*)original_hdr)->dest);
+      }
+      // An error about local traffic that is not a probe says nothing about the port
+      if (probePort != (scanType == NMAP_SCAN_UDP ? UDP_SOURCE_PORT : TCP_SOURCE_PORT))
+        return false;
+      // The error can come from a router or a firewall on the way, the probe it quotes tells the target
+      ip.s_addr = original_ip_hdr->daddr;
+    }
+  }
+  reply->ip = ip;
+  reply->port = src_port;
+  reply->result = result;
+  reply->recvTime = head->ts;
+  return true;
+}
+
+static void rx_onPacket(u_char* arg, const struct pcap_pkthdr* head, const u_char* packet) {
+  NMAP_Rx* rx = (NMAP_Rx*)arg;
+  NMAP_Reply reply;
+
+  if (rx_parse(rx->scanType, head, packet, &reply) == false)
+    return;
+  atomic_fetch_add_explicit(&rx->signals->replies, 1, memory_order_relaxed);
+  if (ring_push(rx->replies, &reply, 1))
+    return;
+  // The worker is behind, wait for it rather than dropping a reply it is waiting for
+  atomic_fetch_add_explicit(&rx->signals->rxStalls, 1, memory_order_relaxed);
+  while (ring_push(rx->replies, &reply, 1) == 0) {
+    if (atomic_load_explicit(&rx->stop, memory_order_relaxed))
+      return;
+    sched_yield();
+  }
+}
+
+/**
+ * @brief - Forward the capture buffer drops of the pcap handle to the pool signals
+ * @param rx {NMAP_Rx*} - RX stage
+ */
+static void rx_updateCaptureDrops(NMAP_Rx* rx) {
+  struct pcap_stat stats;
+  if (pcap_stats(rx->handle, &stats) || stats.ps_drop == rx->captureDrops)
+    return;
+  atomic_fetch_add_explicit(&rx->signals->captureDrops, stats.ps_drop - rx->captureDrops, memory_order_relaxed);
+  rx->captureDrops = stats.ps_drop;
+}
+
+static void* rx_main(void* arg) {
+  NMAP_Rx* rx = arg;
+
+  while (atomic_load_explicit(&rx->stop, memory_order_acquire) == false) {
+    const int64_t ready = pcap_poll(rx->handle, RX_POLL_US);
+    if (ready < 0 && errno != EINTR) {
+      perror("poll/rx");
+      break;
+    }
+    if (ready > 0 && pcap_dispatch(rx->handle, -1, rx_onPacket, (u_char*)rx) == PCAP_ERROR) {
+      fprintf(stderr, "pcap_dispatch: %s\n", pcap_geterr(rx->handle));
+      break;
+    }
+    rx_updateCaptureDrops(rx);
+  }
+  if (atomic_load_explicit(&rx->stop, memory_order_relaxed) == false)
+    atomic_store_explicit(&rx->failed, true, memory_order_release);
+  return NULL;
+}
+
+int64_t rx_init(NMAP_Rx* rx, pcap_t* handle, NMAP_PoolSignals* signals) {
+  memset(rx, 0, sizeof(NMAP_Rx));
+  rx->handle = handle;
+  rx->signals = signals;
+  rx->replies = ring(sizeof(NMAP_Reply), RX_RING_CAPACITY, RING_SPSC);
+  if (rx->replies == NULL) {
+    perror("ring");
+    return 1;
+  }
+  return 0;
+}
+
+void rx_destroy(NMAP_Rx* rx) {
+  ring_destroy(rx->replies);
+  rx->replies = NULL;
+}
+
+int64_t rx_start(NMAP_Rx* rx, const NMAP_ScanType scanType) {
+  rx->scanType = scanType;
+  atomic_store(&rx->stop, false);
+  atomic_store(&rx->failed, false);
+  const int error = pthread_create(&rx->thread, NULL, rx_main, rx);
+  if (error) {
+    fprintf(stderr, "pthread_create/rx: %s\n", strerror(error));
+    return 1;
+  }
+  return 0;
+}
+
+void rx_stop(NMAP_Rx* rx) {
+  atomic_store_explicit(&rx->stop, true, memory_order_release);
+  pthread_join(rx->thread, NULL);
+}
@@ -0,0 +1,178 @@
+//
+// Created by loumouli on 4/26/24.
+//
+
+#include "ft_nmap.h"
+
+/*
+** Most frequently open TCP services, ranked like nmap-services. The frequencies are rounded and only meant to order
+** the ports and to cut the list with --port-ratio.
+*/
+static const NMAP_Service services[] = {
+  {80, 0.484143f, "http"},
+  {23, 0.221265f, "telnet"},
+  {443, 0.208669f, "https"},
+  {21, 0.197667f, "ftp"},
+  {22, 0.182286f, "ssh"},
+  {25, 0.131314f, "smtp"},
+  {3389, 0.083904f, "ms-wbt-server"},
+  {110, 0.077142f, "pop3"},
+  {445, 0.056944f, "microsoft-ds"},
+  {139, 0.050809f, "netbios-ssn"},
+  {143, 0.050420f, "imap"},
+  {53, 0.048463f, "domain"},
+  {135, 0.047798f, "msrpc"},
+  {3306, 0.045390f, "mysql"},
+  {8080, 0.042052f, "http-proxy"},
+  {1723, 0.039351f, "pptp"},
+  {111, 0.030034f, "rpcbind"},
+  {995, 0.029921f, "pop3s"},
+  {993, 0.027199f, "imaps"},
+  {5900, 0.023280f, "vnc"},
+  {1025, 0.019722f, "NFS-or-IIS"},
+  {587, 0.019721f, "submission"},
+  {8888, 0.016171f, "sun-answerbook"},
+  {199, 0.015859f, "smux"},
+  {1720, 0.014277f, "h323q931"},
+  {465, 0.013888f, "smtps"},
+  {548, 0.012370f, "afp"},
+  {113, 0.012169f, "ident"},
+  {81, 0.012056f, "hosts2-ns"},
+  {6001, 0.011730f, "X11:1"},
+  {10000, 0.011638f, "snet-sensor-mgmt"},
+  {514, 0.011078f, "shell"},
+  {5060, 0.010613f, "sip"},
+  {179, 0.010538f, "bgp"},
+  {1026, 0.010527f, "LSA-or-nterm"},
+  {2000, 0.010226f, "cisco-sccp"},
+  {8443, 0.009955f, "https-alt"},
+  {8000, 0.009538f, "http-alt"},
+  {32768, 0.009061f, "filenet-tms"},
+  {554, 0.008953f, "rtsp"},
+  {26, 0.008713f, "rsftp"},
+  {1433, 0.007929f, "ms-sql-s"},
+  {49152, 0.007850f, "unknown"},
+  {2001, 0.007836f, "dc"},
+  {515, 0.007768f, "printer"},
+  {8008, 0.007447f, "http"},
+  {49154, 0.007409f, "unknown"},
+  {1027, 0.007262f, "IIS"},
+  {5666, 0.007191f, "nrpe"},
+  {646, 0.007048f, "ldp"},
+  {5000, 0.006983f, "upnp"},
+  {5631, 0.006946f, "pcanywheredata"},
+  {631, 0.006935f, "ipp"},
+  {49153, 0.006883f, "unknown"},
+  {8081, 0.006733f, "blackice-icecap"},
+  {2049, 0.006575f, "nfs"},
+  {88, 0.006369f, "kerberos-sec"},
+  {79, 0.006307f, "finger"},
+  {5800, 0.006300f, "vnc-http"},
+  {106, 0.006167f, "pop3pw"},
+  {2121, 0.006123f, "ccproxy-ftp"},
+  {1110, 0.006078f, "nfsd-status"},
+  {49155, 0.006052f, "unknown"},
+  {6000, 0.006012f, "X11"},
+  {513, 0.005995f, "login"},
+  {990, 0.005906f, "ftps"},
+  {5357, 0.005872f, "wsdapi"},
+  {427, 0.005813f, "svrloc"},
+  {49156, 0.005700f, "unknown"},
+  {543, 0.005634f, "klogin"},
+  {544, 0.005619f, "kshell"},
+  {5101, 0.005520f, "admdog"},
+  {144, 0.005440f, "news"},
+  {7, 0.005415f, "echo"},
+  {389, 0.005267f, "ldap"},
+  {8009, 0.005213f, "ajp13"},
+  {3128, 0.005131f, "squid-http"},
+  {444, 0.005050f, "snpp"},
+  {9999, 0.005012f, "abyss"},
+  {5009, 0.004967f, "airport-admin"},
+  {7070, 0.004910f, "realserver"},
+  {5190, 0.004874f, "aol"},
+  {3000, 0.004815f, "ppp"},
+  {5432, 0.004760f, "postgresql"},
+  {1900, 0.004722f, "upnp"},
+  {3986, 0.004676f, "mapper-ws_ethd"},
+  {13, 0.004635f, "daytime"},
+  {1029, 0.004600f, "ms-lsa"},
+  {9, 0.004580f, "discard"},
+  {5051, 0.004540f, "ida-agent"},
+  {6646, 0.004500f, "unknown"},
+  {49157, 0.004470f, "unknown"},
+  {1028, 0.004440f, "unknown"},
+  {873, 0.004400f, "rsync"},
+  {1755, 0.004370f, "wms"},
+  {2717, 0.004340f, "pn-requester"},
+  {4899, 0.004310f, "radmin"},
+  {9100, 0.004280f, "jetdirect"},
+  {119, 0.004250f, "nntp"},
+  {37, 0.004220f, "time"},
+  {1000, 0.004100f, "cadlock"},
+  {3001, 0.003900f, "nessus"},
+  {5001, 0.003800f, "commplex-link"},
+  {82, 0.003700f, "xfer"},
+  {10010, 0.003600f, "rxapi"},
+  {1030, 0.003500f, "iad1"},
+  {9090, 0.003400f, "zeus-admin"},
+  {2107, 0.003300f, "msmq-mgmt"},
+  {1024, 0.003200f, "kdm"},
+  {2103, 0.003100f, "zephyr-clt"},
+  {6004, 0.003000f, "X11:4"},
+  {1801, 0.002900f, "msmq"},
+  {5050, 0.002800f, "mmcc"},
+  {19, 0.002700f, "chargen"},
+  {8031, 0.002600f, "unknown"},
+  {1041, 0.002500f, "danf-ak2"},
+  {255, 0.002400f, "unknown"},
+  {6379, 0.002000f, "redis"},
+  {5985, 0.001900f, "wsman"},
+  {9200, 0.001800f, "wap-wsp"},
+  {27017, 0.001700f, "mongod"},
+  {11211, 0.001600f, "memcache"},
+  {6443, 0.001500f, "sun-sr-https"},
+  {2375, 0.001400f, "docker"},
+  {5986, 0.001300f, "wsmans"},
+  {8880, 0.001200f, "cddbp-alt"},
+  {1521, 0.001100f, "oracle"},
+  {5672, 0.001000f, "amqp"},
+};
+
+const NMAP_Service* services_table(size_t* count) {
+  *count = COUNTOF(services);
+  return services;
+}
+
+void services_topPorts(NMAP_PortSet* ports, const uint32_t count, const NMAP_PortSet* excluded) {
+  for (size_t i = 0; i < COUNTOF(services) && ports->size < count; ++i)
+    if (portSet_has(excluded, services[i].port) == false)
+      portSet_addRange(ports, services[i].port, services[i].port);
+  for (uint32_t port = 0; port <= UINT16_MAX && ports->size < count; ++port)
+    if (portSet_has(excluded, port) == false)
+      portSet_addRange(ports, port, port);
+}
+
+void services_portRatio(NMAP_PortSet* ports, const double ratio) {
+  for (size_t i = 0; i < COUNTOF(services) && services[i].frequency >= ratio; ++i)
+    portSet_addRange(ports, services[i].port, services[i].port);
+}
+
+int64_t services_sortPorts(const NMAP_PortSet* ports, Array* list) {
+  NMAP_PortSet listed = {0};
+  uint16_t* out;
+
+  if (array_resize(list, ports->size))
+    return 1;
+  out = array_data(list);
+  // The ports of the table first, by rank, then the others in numeric order
+  for (size_t i = 0; i < COUNTOF(services); ++i) {
+    const uint16_t port = services[i].port;
+    if (portSet_has(ports, port) && portSet_addRange(&listed, port, port) == 0)
+      *out++ = port;
+  }
+  for (int32_t port = portSet_next(ports, 0); port >= 0; port = portSet_next(ports, port + 1))
+    if (portSet_has(&listed, port) == false)
+      *out++ = port;
+  return 0;
+}
@@ -4,24 +4,65 @@
 
 #include "ft_nmap.h"
 
-static bool ArrayFn_portIsPending(unused const Array* arr, unused size_t i, const void* value, unused void* param) {
-  const t_port* const port = value;
-  return port->probeStatus == PROBE_PENDING;
+bool host_hasPortPendingLeft(const t_host* host) { return host->idx_ports < host->portEnd; }
+
+bool host_hasPortLeft(const t_host* host) { return host_hasPortPendingLeft(host) || host->inSlab; }
+
+void host_resetPorts(t_host* host) {
+  host->idx_ports = 0;
+  host->inSlab = 0;
+  host->done = false;
+}
+
+void host_foldResult(t_host* host, const uint32_t idx, const NMAP_PortStatus result) {
+  // An open port stays open, any other result but open|filtered is overridden by the latest scan type
+  portMap_fold(&host->results, idx, result);
 }
 
-bool host_hasPortPendingLeft(const t_host* host) { return array_anyIf(host->ports, ArrayFn_portIsPending, NULL); }
+Array* host_createArray(const Array* ips, Array* timings, const uint32_t nPorts, const bool baseline) {
+  const size_t nHosts = array_size(ips);
+  const size_t words = portMap_words(nPorts);
+  Array* hosts = array(sizeof(t_host), 0, nHosts, NULL, NULL);
+  uint64_t* block = calloc(nHosts * words * (1 + baseline) + 1, sizeof(uint64_t));
 
-static bool ArrayFn_portIsLeft(unused const Array* arr, unused size_t i, const void* value, unused void* param) {
-  const t_port* const port = value;
-  return port->probeStatus == PROBE_PENDING || port->probeStatus == PROBE_SENT;
+  if (hosts == NULL || block == NULL) {
+    free(block);
+    array_destroy(hosts);
+    return NULL;
+  }
+  if (nHosts == 0)
+    free(block);
+  for (size_t i = 0; i < nHosts; ++i) {
+    t_host* host = array_get(hosts, i);
+    host->ip = *(const struct in_addr*)array_cGet(ips, i);
+    host->timing = array_get(timings, i);
+    host->portEnd = nPorts;
+    host->results = (NMAP_PortMap){.words = block + i * words, .count = nPorts};
+    if (baseline)
+      host->baseline = (NMAP_PortMap){.words = block + (nHosts + i) * words, .count = nPorts};
+  }
+  return hosts;
 }
 
-bool host_hasPortLeft(const t_host* host) { return array_anyIf(host->ports, ArrayFn_portIsLeft, NULL); }
+void host_destroyArray(Array* hosts) {
+  if (hosts && array_empty(hosts) == false) {
+    t_host* first = array_get(hosts, 0);
+    free(first->results.words);
+  }
+  array_destroy(hosts);
+}
+
+static int32_t ArrayFn_mapHostToView(unused const Array* arr, unused size_t i, void* dst, const void* src,
+                                     void* param) {
+  const uint32_t nPorts = *(const uint32_t*)param;
+  t_host* const view = dst;
+
+  memcpy(view, src, sizeof(t_host));
+  view->portEnd = view->baseline.words ? nPorts * 2 : nPorts;
+  host_resetPorts(view);
+  return 0;
+}
 
-t_port* host_nextIncPort(t_host* host) {
-  t_port* result = array_get(host->ports, host->idx_ports);
-  host->idx_ports += 1;
-  if (host->idx_ports >= array_size(host->ports))
-    host->idx_ports = 0;
-  return result;
+Array* host_createViews(const Array* store, uint32_t nPorts) {
+  return array_cMap(store, sizeof(t_host), NULL, ArrayFn_mapHostToView, &nPorts);
 }
@@ -0,0 +1,751 @@
+//
+// Created by loumouli on 4/21/24.
+//
+
+#include "ft_nmap.h"
+
+static void sourceDestructor(unused Array* arr, void* data, const size_t n) {
+  NMAP_TargetSource* const sources = data;
+  for (size_t i = 0; i < n; ++i) {
+    if (sources[i].data)
+      munmap(sources[i].data, sources[i].size);
+    if (sources[i].file && sources[i].file != stdin)
+      fclose(sources[i].file);
+    free(sources[i].spec);
+  }
+}
+
+/**
+ * @brief set the range of the block of an address: the octets above the prefix are fixed, the one it cuts is a
+ * contiguous range and the ones below it are free.
+ * @param range {NMAP_TargetRange*} - Range to set.
+ * @param ip {in_addr_t} - Address in the block.
+ * @param bits {uint32_t} - Prefix length, 32 for the address alone.
+ */
+static void targets_setBlock(NMAP_TargetRange* range, const in_addr_t ip, const uint32_t bits) {
+  const uint32_t mask = bits ? UINT32_MAX << (32 - bits) : 0;
+  const uint32_t first = ntohl(ip) & mask;
+  const uint32_t last = first | ~mask;
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    range->lo[i] = first >> (24 - 8 * i);
+    range->hi[i] = last >> (24 - 8 * i);
+  }
+}
+
+/**
+ * @brief parse a plain dotted address, the bulk of a large target list, without going through targets_parse.
+ * @param str {const char*} - Specification, not null terminated.
+ * @param length {size_t} - Length of the specification.
+ * @param ip {in_addr_t*} - Set to the address.
+ * @return {bool} - false if the specification is anything else (ranges, prefix, hostname or invalid).
+ */
+static bool targets_parseAddress(const char* str, const size_t length, in_addr_t* ip) {
+  uint8_t* const octets = (uint8_t*)ip;
+  uint32_t octet = 0, digits = 0, dots = 0;
+
+  for (size_t i = 0; i < length; ++i) {
+    if (str[i] >= '0' && str[i] <= '9' && digits < 3) {
+      octet = octet * 10 + str[i] - '0';
+      digits += 1;
+      continue;
+    }
+    if (str[i] != '.' || digits == 0 || octet > 255 || dots == 3)
+      return false;
+    octets[dots++] = octet;
+    octet = digits = 0;
+  }
+  if (digits == 0 || octet > 255 || dots != 3)
+    return false;
+  octets[3] = octet;
+  return true;
+}
+
+/**
+ * @brief parse one octet of a range specification: N, N-M, N-, -M or *.
+ * @param cursor {const char**} - Start of the octet, moved after it.
+ * @param lo {uint8_t*} - First value.
+ * @param hi {uint8_t*} - Last value.
+ * @return {bool} - true if the octet is valid.
+ */
+static bool targets_parseOctet(const char** cursor, uint8_t* lo, uint8_t* hi) {
+  const char* str = *cursor;
+  unsigned long first = 0, last = 255;
+  char* end;
+
+  if (*str == '*') {
+    *lo = 0;
+    *hi = 255;
+    *cursor = str + 1;
+    return true;
+  }
+  if (*str != '-') {
+    if (*str < '0' || *str > '9')
+      return false;
+    first = strtoul(str, &end, 10);
+    str = end;
+    last = first;
+  }
+  if (*str == '-') {
+    ++str;
+    last = 255;
+    if (*str >= '0' && *str <= '9') {
+      last = strtoul(str, &end, 10);
+      str = end;
+    }
+  }
+  if (first > last || last > 255)
+    return false;
+  *lo = first;
+  *hi = last;
+  *cursor = str;
+  return true;
+}
+
+/**
+ * @brief get the hostname of a target specification, the part before its prefix length.
+ * @param spec {const char*} - Specification, valid.
+ * @param name {char[NI_MAXHOST]} - Set to the hostname, empty if it is too long.
+ * @return {bool} - false if the specification is made of addresses and ranges only.
+ */
+static bool targets_hostname(const char* spec, char* name) {
+  const char* slash = strchr(spec, '/');
+  const size_t length = slash ? (size_t)(slash - spec) : strlen(spec);
+
+  // Anything but digits and range characters is a hostname
+  if (strspn(spec, "0123456789.-*/") == strlen(spec))
+    return false;
+  *name = 0;
+  if (length < NI_MAXHOST) {
+    memcpy(name, spec, length);
+    name[length] = 0;
+  }
+  return true;
+}
+
+/**
+ * @brief parse a target specification into a range.
+ * @param spec {const char*} - Specification.
+ * @param range {NMAP_TargetRange*} - Range to fill, NULL to only check the syntax (hostnames are not resolved).
+ * @param resolver {NMAP_Resolver*} - Resolver of the hostnames, unused without range.
+ * @return {int64_t} - 0 if success, 1 if the specification is invalid, 2 if its hostname can not be resolved.
+ */
+static int64_t targets_parse(const char* spec, NMAP_TargetRange* range, NMAP_Resolver* resolver) {
+  const char* slash = strchr(spec, '/');
+  NMAP_TargetRange parsed;
+  const char* cursor = spec;
+  unsigned long bits = 32;
+  char* end;
+
+  if (*spec == 0)
+    return 1;
+  if (slash) {
+    errno = 0;
+    bits = strtoul(slash + 1, &end, 10);
+    if (slash[1] < '0' || slash[1] > '9' || *end || errno == ERANGE || bits > 32 || slash == spec)
+      return 1;
+  }
+  char name[NI_MAXHOST];
+  if (targets_hostname(spec, name)) {
+    if (range == NULL)
+      return 0;
+    // Resolved ahead by the resolver threads, most of the time
+    const in_addr_t ip = *name ? resolver_wait(resolver, name) : INADDR_NONE;
+    if (ip == INADDR_NONE)
+      return 2;
+    targets_setBlock(range, ip, bits);
+    return 0;
+  }
+  for (uint32_t i = 0; i < 4; ++i) {
+    if ((i && *cursor++ != '.') || targets_parseOctet(&cursor, parsed.lo + i, parsed.hi + i) == false)
+      return 1;
+  }
+  if (cursor != (slash ? slash : spec + strlen(spec)))
+    return 1;
+  if (slash) {
+    // A prefix only applies to an address, not to octet ranges
+    if (memcmp(parsed.lo, parsed.hi, sizeof(parsed.lo)))
+      return 1;
+    in_addr_t ip;
+    memcpy(&ip, parsed.lo, sizeof(ip));
+    targets_setBlock(&parsed, ip, bits);
+  }
+  if (range)
+    *range = parsed;
+  return 0;
+}
+
+NMAP_Targets* targets_create(void) {
+  NMAP_Targets* targets = calloc(1, sizeof(NMAP_Targets));
+  if (targets == NULL)
+    return NULL;
+  targets->sources = array(sizeof(NMAP_TargetSource), 1, 0, NULL, &(ArrayFactory){.destructor = sourceDestructor});
+  targets->window = ring(sizeof(NMAP_TargetEntry), RESOLVER_WINDOW, RING_SPSC);
+  targets->resolver = resolver_create(resolver_getaddrinfo, RESOLVER_DEFAULT_THREADS);
+  targets->covered = exclusions_create();
+  targets->sparse = array(sizeof(NMAP_TargetRange), 0, 0, NULL, NULL);
+  if (targets->sources == NULL || targets->window == NULL || targets->resolver == NULL || targets->covered == NULL ||
+      targets->sparse == NULL) {
+    targets_destroy(targets);
+    return NULL;
+  }
+  targets->shards = 1;
+  return targets;
+}
+
+void targets_setOrder(NMAP_Targets* targets, const bool randomize, const uint64_t seed, const uint32_t shard,
+                      const uint32_t shards) {
+  targets->randomize = randomize;
+  targets->seed = seed;
+  targets->shard = shard;
+  targets->shards = shards;
+}
+
+void targets_setResolver(NMAP_Targets* targets, NMAP_ResolveFunction* resolve, const uint32_t nThreads) {
+  targets->resolver->resolve = resolve;
+  targets->resolver->nThreads = nThreads;
+}
+
+void targets_destroy(NMAP_Targets* targets) {
+  NMAP_TargetEntry entry;
+
+  if (targets == NULL)
+    return;
+  // The threads are stopped before the specifications they may be resolving are freed
+  resolver_destroy(targets->resolver);
+  while (targets->window && ring_pop(targets->window, &entry, 1))
+    free(entry.spec);
+  ring_destroy(targets->window);
+  array_destroy(targets->sources);
+  free(targets->line);
+  free(targets->seen);
+  exclusions_destroy(targets->covered);
+  array_destroy(targets->sparse);
+  exclusions_destroy(targets->exclusions);
+  free(targets);
+}
+
+int64_t targets_addSpec(NMAP_Targets* targets, const char* spec) {
+  if (targets_parse(spec, NULL, NULL))
+    return 1;
+  NMAP_TargetSource source = {.spec = strdup(spec), .file = NULL};
+  if (source.spec == NULL || array_pushBack(targets->sources, &source, 1)) {
+    free(source.spec);
+    return -1;
+  }
+  return 0;
+}
+
+int64_t targets_addFile(NMAP_Targets* targets, const char* path) {
+  NMAP_TargetSource source = {.spec = strdup(path), .file = strcmp(path, "-") ? fopen(path, "r") : stdin};
+  struct stat info;
+
+  if (source.spec == NULL || source.file == NULL) {
+    sourceDestructor(NULL, &source, 1);
+    return 1;
+  }
+  // A regular file is mapped and split in place, the standard input and pipes are streamed
+  if (source.file != stdin && fstat(fileno(source.file), &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+    void* const data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(source.file), 0);
+    if (data != MAP_FAILED) {
+      madvise(data, info.st_size, MADV_SEQUENTIAL);
+      source.data = data;
+      source.size = info.st_size;
+      fclose(source.file);
+      source.file = NULL;
+    }
+  }
+  if (array_pushBack(targets->sources, &source, 1)) {
+    sourceDestructor(NULL, &source, 1);
+    return 1;
+  }
+  return 0;
+}
+
+/**
+ * @brief exclude the addresses of a range, in as few intervals as its octets allow.
+ * @param exclusions {NMAP_Exclusions*} - List.
+ * @param range {const NMAP_TargetRange*} - Range.
+ * @return {int64_t} - 0 if success, 1 on allocation failure.
+ */
+static int64_t targets_excludeRange(NMAP_Exclusions* exclusions, const NMAP_TargetRange* range) {
+  uint8_t octets[4];
+  int32_t split = 3;
+
+  // The octets after split are full, each combination of the octets before it starts one interval
+  while (split > 0 && range->lo[split] == 0 && range->hi[split] == 255)
+    --split;
+  const uint32_t shift = 24 - 8 * split;
+  const uint32_t ones = (uint32_t)((1ULL << shift) - 1);
+  memcpy(octets, range->lo, sizeof(octets));
+  while (true) {
+    uint32_t prefix = 0;
+    for (int32_t i = 0; i < split; ++i)
+      prefix |= (uint32_t)octets[i] << (24 - 8 * i);
+    if (exclusions_add(exclusions, prefix | (uint32_t)range->lo[split] << shift,
+                       prefix | (uint32_t)range->hi[split] << shift | ones))
+      return 1;
+    int32_t i = split - 1;
+    while (i >= 0 && octets[i] == range->hi[i]) {
+      octets[i] = range->lo[i];
+      --i;
+    }
+    if (i < 0)
+      return 0;
+    octets[i] += 1;
+  }
+}
+
+/**
+ * @brief exclude the addresses of a specification, without sealing the list.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param spec {const char*} - Specification.
+ * @return {int64_t} - 0 if success, 1 if the specification is invalid, 2 if its hostname can not be resolved, -1 on
+ * allocation failure.
+ */
+static int64_t targets_exclude(NMAP_Targets* targets, const char* spec) {
+  NMAP_TargetRange range;
+
+  if (targets->exclusions == NULL && (targets->exclusions = exclusions_create()) == NULL)
+    return -1;
+  const int64_t error = targets_parse(spec, &range, targets->resolver);
+  if (error)
+    return error;
+  return targets_excludeRange(targets->exclusions, &range) ? -1 : 0;
+}
+
+int64_t targets_addExclude(NMAP_Targets* targets, const char* spec) {
+  const int64_t error = targets_exclude(targets, spec);
+
+  if (error)
+    return error;
+  return exclusions_seal(targets->exclusions) ? -1 : 0;
+}
+
+int64_t targets_addExcludeFile(NMAP_Targets* targets, const char* path) {
+  FILE* const file = fopen(path, "r");
+  char* line = NULL;
+  size_t lineSize = 0;
+  uint64_t lineNumber = 0;
+  int64_t error = 0;
+
+  if (file == NULL)
+    return -1;
+  while (error == 0 && getline(&line, &lineSize, file) != -1) {
+    char* const spec = line + strspn(line, " \t");
+    spec[strcspn(spec, " \t\r\n")] = 0;
+    lineNumber += 1;
+    if (*spec == 0 || *spec == '#')
+      continue;
+    error = targets_exclude(targets, spec);
+    if (error > 0)
+      fprintf(stderr, "ft_nmap: %s '%s' (%s:%lu)\n", error == 1 ? "Invalid exclusion" : "Failed to resolve hostname",
+              spec, path, lineNumber);
+  }
+  if (error == 0 && ferror(file))
+    error = -1;
+  fclose(file);
+  free(line);
+  if (error == 0 && targets->exclusions && exclusions_seal(targets->exclusions))
+    error = -1;
+  return error > 0 ? 1 : error;
+}
+
+bool targets_empty(const NMAP_Targets* targets) { return array_empty(targets->sources); }
+
+/**
+ * @brief record the address of a single address target, so that it is scanned once however many times it is listed.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param ip {in_addr_t} - Address.
+ * @return {bool} - true if the address was already recorded.
+ */
+static bool targets_see(NMAP_Targets* targets, const in_addr_t ip) {
+  if (ip == 0) {
+    const bool seen = targets->seenZero;
+    targets->seenZero = true;
+    return seen;
+  }
+  if ((targets->seenCount + 1) * 4 > targets->seenCapacity * 3) {
+    const uint64_t capacity = targets->seenCapacity ? targets->seenCapacity * 2 : TARGETS_SEEN_MIN_CAPACITY;
+    in_addr_t* const seen = calloc(capacity, sizeof(in_addr_t));
+    // Without memory, the duplicates are scanned again
+    if (seen == NULL)
+      return false;
+    for (uint64_t i = 0; i < targets->seenCapacity; ++i) {
+      if (targets->seen[i] == 0)
+        continue;
+      uint64_t j = (targets->seen[i] * 0x9E3779B97F4A7C15ULL >> 32) & (capacity - 1);
+      while (seen[j])
+        j = (j + 1) & (capacity - 1);
+      seen[j] = targets->seen[i];
+    }
+    free(targets->seen);
+    targets->seen = seen;
+    targets->seenCapacity = capacity;
+  }
+  uint64_t i = (ip * 0x9E3779B97F4A7C15ULL >> 32) & (targets->seenCapacity - 1);
+  while (targets->seen[i]) {
+    if (targets->seen[i] == ip)
+      return true;
+    i = (i + 1) & (targets->seenCapacity - 1);
+  }
+  targets->seen[i] = ip;
+  targets->seenCount += 1;
+  return false;
+}
+
+/**
+ * @brief look up an address among the single address targets recorded so far.
+ * @param targets {const NMAP_Targets*} - Generator.
+ * @param ip {in_addr_t} - Address.
+ * @return {bool} - true if the address was recorded.
+ */
+static bool targets_seen(const NMAP_Targets* targets, const in_addr_t ip) {
+  if (ip == 0)
+    return targets->seenZero;
+  if (targets->seenCount == 0)
+    return false;
+  uint64_t i = (ip * 0x9E3779B97F4A7C15ULL >> 32) & (targets->seenCapacity - 1);
+  while (targets->seen[i]) {
+    if (targets->seen[i] == ip)
+      return true;
+    i = (i + 1) & (targets->seenCapacity - 1);
+  }
+  return false;
+}
+
+/**
+ * @brief merge the pending intervals into the sorted list of the walked ranges.
+ * @param targets {NMAP_Targets*} - Generator.
+ */
+static void targets_flushPending(NMAP_Targets* targets) {
+  uint32_t i = 0;
+
+  while (i < targets->pendingCount &&
+         exclusions_add(targets->covered, targets->pending[i].first, targets->pending[i].last) == 0)
+    ++i;
+  if (exclusions_seal(targets->covered)) {
+    // Without memory, the ranges walked so far are forgotten: their addresses are scanned again if listed again
+    array_clear(targets->covered->intervals);
+    exclusions_seal(targets->covered);
+  }
+  targets->pendingCount = 0;
+}
+
+/**
+ * @brief record a range once it is walked, so that its addresses are skipped if another specification lists them. The
+ * range is cut into the intervals of its contiguous addresses: one for a CIDR block or a dash range on the last octet.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param range {const NMAP_TargetRange*} - Range walked.
+ */
+static void targets_record(NMAP_Targets* targets, const NMAP_TargetRange* range) {
+  // Octets after k cover every value, each value of the octets before it starts another interval
+  uint32_t k = 3;
+  while (k > 0 && range->lo[k] == 0 && range->hi[k] == UINT8_MAX)
+    --k;
+  uint64_t runs = 1;
+  for (uint32_t j = 0; j < k; ++j)
+    runs *= range->hi[j] - range->lo[j] + 1;
+  // A sparse range would take one interval per address or so, it is matched octet by octet instead
+  if (runs > TARGETS_PENDING_RUNS) {
+    array_pushBack(targets->sparse, range, 1);
+    return;
+  }
+  if (targets->pendingCount + runs > TARGETS_PENDING_RUNS)
+    targets_flushPending(targets);
+  const uint32_t shift = (3 - k) * 8;
+  const uint32_t low = (uint32_t)range->lo[k] << shift;
+  const uint32_t high = (uint32_t)((((uint64_t)range->hi[k] + 1) << shift) - 1);
+  for (uint64_t r = 0; r < runs; ++r) {
+    uint64_t index = r;
+    uint32_t prefix = 0;
+    for (int32_t j = k - 1; j >= 0; --j) {
+      const uint32_t span = range->hi[j] - range->lo[j] + 1;
+      prefix |= (uint32_t)(range->lo[j] + index % span) << (24 - 8 * j);
+      index /= span;
+    }
+    targets->pending[targets->pendingCount++] = (NMAP_Interval){.first = prefix | low, .last = prefix | high};
+  }
+}
+
+/**
+ * @brief test if a range may hold addresses of the ranges walked so far. The pending intervals it crosses are merged
+ * first, so that its addresses are only looked up in the sorted list.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param range {const NMAP_TargetRange*} - Range, its bounds stand for the whole of it.
+ * @return {bool} - true if the range crosses a walked range.
+ */
+static bool targets_crossesWalked(NMAP_Targets* targets, const NMAP_TargetRange* range) {
+  in_addr_t lo, hi;
+
+  memcpy(&lo, range->lo, sizeof(lo));
+  memcpy(&hi, range->hi, sizeof(hi));
+  const uint32_t first = ntohl(lo);
+  const uint32_t last = ntohl(hi);
+  for (uint32_t i = 0; i < targets->pendingCount; ++i) {
+    if (targets->pending[i].first <= last && targets->pending[i].last >= first) {
+      targets_flushPending(targets);
+      break;
+    }
+  }
+  if (exclusions_overlaps(targets->covered, first, last))
+    return true;
+  for (uint64_t i = 0; i < array_size(targets->sparse); ++i) {
+    const NMAP_TargetRange* sparse = array_cGet(targets->sparse, i);
+    uint32_t j = 0;
+    while (j < 4 && sparse->lo[j] <= range->hi[j] && sparse->hi[j] >= range->lo[j])
+      ++j;
+    if (j == 4)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief test if an address was listed as a single address or walked by a previous range.
+ * @param targets {const NMAP_Targets*} - Generator, its pending intervals do not cross the range being walked.
+ * @param ip {in_addr_t} - Address.
+ * @return {bool} - true if the address was already generated.
+ */
+static bool targets_walked(const NMAP_Targets* targets, const in_addr_t ip) {
+  const uint8_t* const octets = (const uint8_t*)&ip;
+
+  if (targets_seen(targets, ip))
+    return true;
+  if (exclusions_contains(targets->covered, ntohl(ip)))
+    return true;
+  for (uint64_t i = 0; i < array_size(targets->sparse); ++i) {
+    const NMAP_TargetRange* sparse = array_cGet(targets->sparse, i);
+    uint32_t j = 0;
+    while (j < 4 && sparse->lo[j] <= octets[j] && sparse->hi[j] >= octets[j])
+      ++j;
+    if (j == 4)
+      return true;
+  }
+  return false;
+}
+
+/**
+ * @brief make a specification of the window the range being generated.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param entry {const NMAP_TargetEntry*} - Specification.
+ * @return {bool} - true if success, false if the specification was skipped (reported unless it is a duplicate).
+ */
+static bool targets_load(NMAP_Targets* targets, const NMAP_TargetEntry* entry) {
+  if (entry->spec) {
+    const int64_t error = targets_parse(entry->spec, &targets->range, targets->resolver);
+    if (error) {
+      fprintf(stderr, "ft_nmap: %s '%s', skipped\n", error == 1 ? "Invalid target" : "Failed to resolve hostname",
+              entry->spec);
+      return false;
+    }
+  }
+  else
+    targets->range = entry->range;
+  targets->size = 1;
+  for (uint32_t i = 0; i < 4; ++i)
+    targets->size *= targets->range.hi[i] - targets->range.lo[i] + 1;
+  targets->filter = false;
+  if (targets->exclusions) {
+    in_addr_t first, last;
+    memcpy(&first, targets->range.lo, sizeof(first));
+    memcpy(&last, targets->range.hi, sizeof(last));
+    // Only a range crossing the list checks its addresses one by one, one inside it is skipped at once
+    targets->filter = exclusions_overlaps(targets->exclusions, ntohl(first), ntohl(last));
+    if (targets->filter && exclusions_covers(targets->exclusions, ntohl(first), ntohl(last)))
+      return false;
+  }
+  targets->dedupe = false;
+  if (targets->size == 1) {
+    in_addr_t ip;
+    memcpy(&ip, targets->range.lo, sizeof(ip));
+    if (targets_crossesWalked(targets, &targets->range) || targets_see(targets, ip))
+      return false;
+  }
+  else {
+    in_addr_t first, last;
+    memcpy(&first, targets->range.lo, sizeof(first));
+    memcpy(&last, targets->range.hi, sizeof(last));
+    // A range already walked as a whole is skipped at once, one crossing a previous specification checks its addresses
+    targets->dedupe = targets_crossesWalked(targets, &targets->range);
+    if (targets->dedupe && exclusions_covers(targets->covered, ntohl(first), ntohl(last)))
+      return false;
+    targets->dedupe = targets->dedupe || targets->seenCount || targets->seenZero;
+    targets->record = true;
+  }
+  targets->position = 0;
+  permutation_init(&targets->order, targets->size, targets->randomize, targets->seed + targets->ranges++);
+  targets->active = true;
+  return true;
+}
+
+/**
+ * @brief read the next specification of the sources: the next line of the current file, or the next source.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @param length {size_t*} - Set to the length of the specification.
+ * @return {const char*} - The specification, not null terminated and only valid until the next read. NULL once every
+ * source is consumed.
+ */
+static const char* targets_read(NMAP_Targets* targets, size_t* length) {
+  const char* line;
+  const char* eol;
+
+  while (true) {
+    if (targets->cursor) {
+      if (targets->cursor == targets->end) {
+        targets->cursor = NULL;
+        continue;
+      }
+      line = targets->cursor;
+      eol = memchr(line, '\n', targets->end - line);
+      if (eol == NULL)
+        eol = targets->end;
+      targets->cursor = eol + (eol != targets->end);
+    }
+    else if (targets->stream) {
+      const ssize_t size = getline(&targets->line, &targets->lineSize, targets->stream);
+      if (size == -1) {
+        if (ferror(targets->stream))
+          perror("ft_nmap: failed to read the targets");
+        targets->stream = NULL;
+        continue;
+      }
+      line = targets->line;
+      eol = line + size;
+    }
+    else {
+      if (targets->nextSource == array_size(targets->sources))
+        return NULL;
+      const NMAP_TargetSource* source = array_cGet(targets->sources, targets->nextSource++);
+      if (source->data) {
+        targets->cursor = source->data;
+        targets->end = source->data + source->size;
+      }
+      else if (source->file)
+        targets->stream = source->file;
+      else {
+        *length = strlen(source->spec);
+        return source->spec;
+      }
+      continue;
+    }
+    while (line < eol && (*line == ' ' || *line == '\t'))
+      ++line;
+    const char* last = line;
+    while (last < eol && *last != ' ' && *last != '\t' && *last != '\r' && *last != '\n')
+      ++last;
+    if (last == line || *line == '#')
+      continue;
+    *length = last - line;
+    return line;
+  }
+}
+
+/**
+ * @brief read specifications ahead until the window is full, their hostnames are resolved by the resolver threads
+ * until the generator reaches them.
+ * @param targets {NMAP_Targets*} - Generator.
+ */
+static void targets_readAhead(NMAP_Targets* targets) {
+  char name[NI_MAXHOST];
+  NMAP_TargetEntry entry;
+  size_t length;
+  in_addr_t ip;
+
+  while (targets->sourcesRead == false && ring_size(targets->window) < ring_capacity(targets->window)) {
+    const char* const spec = targets_read(targets, &length);
+    if (spec == NULL) {
+      targets->sourcesRead = true;
+      break;
+    }
+    entry.spec = NULL;
+    if (targets_parseAddress(spec, length, &ip)) {
+      targets_setBlock(&entry.range, ip, 32);
+      ring_push(targets->window, &entry, 1);
+      continue;
+    }
+    if ((entry.spec = strndup(spec, length)) == NULL) {
+      perror("malloc");
+      continue;
+    }
+    // Only the hostnames (and the invalid specifications, reported in order) keep their text until they are loaded
+    if (targets_hostname(entry.spec, name) == false && targets_parse(entry.spec, &entry.range, NULL) == 0) {
+      free(entry.spec);
+      entry.spec = NULL;
+    }
+    // A hostname that fails to be queued is resolved when the generator reaches it
+    else if (targets_parse(entry.spec, NULL, NULL) == 0 && targets_hostname(entry.spec, name) && *name)
+      resolver_submit(targets->resolver, name);
+    ring_push(targets->window, &entry, 1);
+  }
+}
+
+/**
+ * @brief move to the next valid specification of the window.
+ * @param targets {NMAP_Targets*} - Generator.
+ * @return {bool} - true if a range is ready, false once every source is consumed.
+ */
+static bool targets_advance(NMAP_Targets* targets) {
+  NMAP_TargetEntry entry;
+
+  // The range just walked is recorded before the next one is loaded, which may list its addresses again
+  if (targets->record) {
+    targets_record(targets, &targets->range);
+    targets->record = false;
+  }
+  targets_readAhead(targets);
+  while (ring_pop(targets->window, &entry, 1)) {
+    const bool loaded = targets_load(targets, &entry);
+    free(entry.spec);
+    targets_readAhead(targets);
+    if (loaded)
+      return true;
+  }
+  return false;
+}
+
+uint64_t targets_next(NMAP_Targets* targets, in_addr_t* ips, const uint64_t count) {
+  uint64_t n = 0;
+
+  while (n < count) {
+    if (targets->active == false && (targets->exhausted || targets_advance(targets) == false)) {
+      targets->exhausted = true;
+      break;
+    }
+    // The position is decoded in mixed radix over the octet ranges, the last octet moves fastest
+    uint64_t index = permutation_at(&targets->order, targets->position++);
+    if (targets->position == targets->size)
+      targets->active = false;
+    // A duplicate is dropped before the shards are split, so that they share the addresses listed once each
+    if (targets->dedupe == false && targets->walked++ % targets->shards != targets->shard)
+      continue;
+    uint8_t* const octets = (uint8_t*)(ips + n);
+    for (int32_t i = 3; i >= 0; --i) {
+      const uint32_t span = targets->range.hi[i] - targets->range.lo[i] + 1;
+      octets[i] = targets->range.lo[i] + index % span;
+      index /= span;
+    }
+    if (targets->dedupe && (targets_walked(targets, ips[n]) || targets->walked++ % targets->shards != targets->shard))
+      continue;
+    // An excluded address is dropped here, before the scan allocates anything for it
+    if (targets->filter && exclusions_contains(targets->exclusions, ntohl(ips[n])))
+      continue;
+    ++n;
+  }
+  targets->generated += n;
+  return n;
+}
+
+uint64_t targets_skip(NMAP_Targets* targets, const uint64_t count) {
+  in_addr_t ips[256];
+  uint64_t skipped = 0;
+
+  while (skipped < count) {
+    const uint64_t batch = count - skipped < COUNTOF(ips) ? count - skipped : COUNTOF(ips);
+    const uint64_t n = targets_next(targets, ips, batch);
+    skipped += n;
+    if (n < batch)
+      break;
+  }
+  return skipped;
+}
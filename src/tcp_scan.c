@@ -21,7 +21,7 @@ uint64_t send_packet(const int sck, const uint8_t* packet, const uint64_t size_p
 }
 
 static void tcp_craft_payload(struct tcphdr* tcp_hdr, const uint16_t port) {
-  tcp_hdr->source = htons(49152); // Source port, Likely unused port
+  tcp_hdr->source = htons(TCP_SOURCE_PORT);
   tcp_hdr->dest = htons(port); // Target port
   tcp_hdr->seq = 0;
   tcp_hdr->syn = 1;
@@ -62,44 +62,42 @@ uint16_t tcp_checksum(const void* vdata, const size_t length, const struct in_ad
   return chcksm;
 }
 
-static int32_t tcp_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src,
+static int32_t tcp_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src,
                               uint16_t tcp_flag) {
   struct sockaddr_in dest = {0};
   struct tcphdr tcp_hdr = {0};
-  struct timeval tmpTime = {0};
 
   dest.sin_addr = ip_dest;
-  dest.sin_port = htons(port->port);
+  dest.sin_port = htons(port);
   dest.sin_family = AF_INET;
   const int32_t sock = us->sock;
-  tcp_craft_payload(&tcp_hdr, port->port);
+  tcp_craft_payload(&tcp_hdr, port);
   tcp_hdr.th_flags = tcp_flag;
   tcp_hdr.check = tcp_checksum(&tcp_hdr, sizeof(tcp_hdr), ip_src, ip_dest);
-  gettimeofday(&tmpTime, NULL);
-  memcpy(&port->sendTime, &tmpTime, sizeof(struct timeval)); // we use a tmp timeval to avoid alignment issue
   if (send_packet(sock, (uint8_t*)&tcp_hdr, sizeof(tcp_hdr), 0, (struct sockaddr*)&dest)) {
-    perror("send_packet/retval");
+    if (errno != ENOBUFS && errno != EAGAIN) // a full send queue is handled by the caller
+      perror("send_packet/retval");
     return 1;
   }
   return 0;
 }
 
-int32_t tcp_syn_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src) {
+int32_t tcp_syn_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src) {
   return tcp_send_probe(us, port, ip_dest, ip_src, TH_SYN);
 }
 
-int32_t tcp_ack_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src) {
+int32_t tcp_ack_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src) {
   return tcp_send_probe(us, port, ip_dest, ip_src, TH_ACK);
 }
 
-int32_t tcp_fin_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src) {
+int32_t tcp_fin_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src) {
   return tcp_send_probe(us, port, ip_dest, ip_src, TH_FIN);
 }
 
-int32_t tcp_xmas_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src) {
+int32_t tcp_xmas_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src) {
   return tcp_send_probe(us, port, ip_dest, ip_src, TH_FIN | TH_PUSH | TH_URG);
 }
 
-int32_t tcp_null_send_probe(const NMAP_UltraScan* us, t_port* port, struct in_addr ip_dest, struct in_addr ip_src) {
+int32_t tcp_null_send_probe(const NMAP_UltraScan* us, uint16_t port, struct in_addr ip_dest, struct in_addr ip_src) {
   return tcp_send_probe(us, port, ip_dest, ip_src, 0);
 }
\ No newline at end of file
@@ -13,109 +13,93 @@ static bool us_allHostDone(const NMAP_UltraScan* us) {
   return true;
 }
 
-void us_updateSRTT(NMAP_UltraScan* us, const t_port* port) {
-  us->srtt = us->srtt + (TIMEVAL_TO_MICROSC(port->recvTime) - TIMEVAL_TO_MICROSC(port->sendTime) - us->srtt) / 8;
+static uint64_t realtimeNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  return ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
 }
 
+void us_updateTimeout(NMAP_UltraScan* us, const t_host* host, const uint32_t slot, const struct timeval recvTime) {
+  const long double rtt = ((long double)TIMEVAL_TO_MICROSC(recvTime) * 1000 - us->slab.sendNs[slot]) / 1000;
 
-void us_updateRTTVAR(NMAP_UltraScan* us, const t_port* port) {
-  us->rttvar = us->rttvar +
-    (fabsl(TIMEVAL_TO_MICROSC(port->recvTime) - TIMEVAL_TO_MICROSC(port->sendTime) - us->srtt) - us->rttvar) / 4;
-}
-
-void us_updateTimeout(NMAP_UltraScan* us, const t_port* port) {
-  us_updateSRTT(us, port);
-  us_updateRTTVAR(us, port);
-  us->timeout = us->srtt + us->rttvar * 5;
-  if (us->timeout < us->minTimeout)
-    us->timeout = us->minTimeout;
-  else if (us->timeout > us->maxTimeout)
-    us->timeout = us->maxTimeout;
+  hostTable_onReply(us->hostTable, host->timing, rtt);
+  us->timeout = atomic_load_explicit(&host->timing->timeout, memory_order_relaxed);
 }
 
 void us_default_init(NMAP_UltraScan* us) {
-  us->srtt = 0; // in micro seconds
-  us->rttvar = 0; // in micro seconds
   us->timeout = 1'000'000; // in micro seconds (1s/1000ms)
-  us->maxTimeout = 10'000'000; // in micro seconds (10s/10.000ms)
-  us->minTimeout = 100'000; // in micro seconds (0.1s/100ms)
   us->maxRetries = 10;
+  us->baselineRetries = US_BASELINE_RETRIES;
+  us->udpMaxRetries = US_UDP_MAX_RETRIES;
 }
 
-int32_t ArrayFn_mapPortNumToHostPort(const Array* arr, size_t i, void* dst, const void* src, void* param) {
-  memset(dst, 0, sizeof(t_port));
-  (void)arr, (void)param, (void)i;
-  ((t_port*)dst)->port = *(uint16_t*)src;
+int64_t us_createHost(NMAP_UltraScan* us, const NMAP_WorkerOptions* options) {
+  us->hosts = host_createViews(options->hosts, array_size(options->ports));
+  if (us->hosts == NULL)
+    return 1;
+  us->ports = array_cData(options->ports);
+  us->resultOrder = options->portOrder;
+  us->portOffset = options->portOffset;
+  permutation_init(&us->portOrder, array_size(options->ports), options->randomize, options->seed);
+  // The slab only has to hold what the congestion windows and the global credits let fly
+  uint64_t capacity = array_size(us->hosts) * (uint64_t)HOST_MAX_CWND;
+  if (us->credits->limit && us->credits->limit < capacity)
+    capacity = us->credits->limit;
+  if (probeSlab_init(&us->slab, capacity < PROBE_SLAB_MAX ? capacity : PROBE_SLAB_MAX)) {
+    array_destroy(us->hosts);
+    us->hosts = NULL;
+    return 1;
+  }
   return 0;
 }
 
-int32_t ArrayFn_mapIpToHost(unused const Array* arr, unused size_t i, void* dst, const void* src, void* param) {
-  t_host* const host = dst;
-
-  memset(host, 0, sizeof(t_host));
-  host->ip = *(struct in_addr*)src;
-  host->ports = array_cMap(param, sizeof(t_port), NULL, ArrayFn_mapPortNumToHostPort, NULL);
-  if (host->ports == NULL)
-    return 1;
-  return 0;
+uint32_t us_resultIndex(const NMAP_UltraScan* us, const uint32_t portIdx) {
+  return permutation_at(us->resultOrder, us->portOffset + portIdx);
 }
 
-int64_t us_createHost(NMAP_UltraScan* us, const Array* ips, const Array* ports) {
-  us->hosts = array_cMap(ips, sizeof(t_host), NULL, ArrayFn_mapIpToHost, (void*)ports);
-  if (us->hosts == NULL)
-    return 1;
-  return 0;
+uint32_t us_portIndex(const NMAP_UltraScan* us, const uint32_t hostIdx, const uint32_t position) {
+  const uint64_t count = us->portOrder.range;
+
+  if (us->portOrder.rounds == 0)
+    return position;
+  // The hosts are spread over the permutation so that they do not all probe the same port at the same time
+  const uint64_t start = hostIdx * count / array_size(us->hosts);
+  return permutation_at(&us->portOrder, (position + start) % count);
 }
 
-int64_t init_sniffer(NMAP_UltraScan* us) {
-  const uint64_t nbrHosts = array_size(us->hosts);
-  char errbuf[PCAP_ERRBUF_SIZE];
-  pcap_if_t* devs;
-  char dst_hosts[4096] = {0};
-  char pcap_filter[4096] = {0};
-  const bpf_u_int32 net = 0;
-  struct bpf_program fp;
-
-  if (pcap_findalldevs(&devs, errbuf) == -1) {
-    fprintf(stderr, "pcap_findalldevs: %s\n", errbuf);
-    return 1;
-  }
-  us->inter_ip = get_interface_ip(devs->name);
-  for (uint64_t targetno = 0; targetno < nbrHosts; ++targetno) {
-    if (targetno == 0)
-      strcat(dst_hosts, "");
-    else
-      strcat(dst_hosts, " or ");
-    strcat(dst_hosts, "src host ");
-    const t_host* host = array_cGet(us->hosts, targetno);
-    const char* str = inet_ntoa(host->ip);
-    strcat(dst_hosts, str);
-  }
-  us->handle = pcap_open_live(devs->name, 10000, 1, 1, errbuf);
-  if (us->handle == NULL) {
-    pcap_freealldevs(devs);
-    fprintf(stderr, "pcap_open_live: %s\n", errbuf);
-    return 1;
-  }
-  strcat(pcap_filter, "dst host ");
-  strcat(pcap_filter, inet_ntoa(get_interface_ip(devs->name)));
-  pcap_freealldevs(devs);
-  strcat(pcap_filter, " and (icmp or (tcp and (");
-  strcat(pcap_filter, dst_hosts);
-  strcat(pcap_filter, ")))");
-  if (pcap_compile(us->handle, &fp, pcap_filter, 0, net) == -1) {
-    pcap_close(us->handle);
-    fprintf(stdout, "Cant parse filter %s\n", pcap_geterr(us->handle));
-    return 1;
-  }
-  if (pcap_setfilter(us->handle, &fp) == -1) {
-    pcap_close(us->handle);
-    fprintf(stderr, "Couldnt apply filter %s\n", pcap_geterr(us->handle));
-    return 1;
+void us_skipPorts(const NMAP_UltraScan* us, t_host* host) {
+  const uint32_t hostIdx = host - (const t_host*)array_cData(us->hosts);
+  const uint32_t count = us->portOrder.range;
+
+  if (host->baseline.words == NULL)
+    return;
+  // The first pass over the probe order only probes the ports open in the baseline, the second one the others
+  while (host->idx_ports < host->portEnd) {
+    const uint32_t portIdx = us_portIndex(us, hostIdx, host->idx_ports % count);
+    const bool open = portMap_get(&host->baseline, us_resultIndex(us, portIdx)) == NMAP_OPEN;
+    if (open == (host->idx_ports < count))
+      return;
+    host->idx_ports += 1;
   }
-  // printf("filter = [%s]\n", pcap_filter);
-  free(fp.bf_insns);
-  return 0;
+}
+
+/**
+ * @brief number of times a port is probed before it is deemed filtered.
+ * @param us {const NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param host {const t_host*} - Host of the port.
+ * @param portIdx {uint32_t} - Index of the port in the chunk.
+ * @return {uint64_t} - baselineRetries for a port closed or filtered in the baseline, udpMaxRetries or maxRetries
+ * otherwise.
+ */
+static uint64_t us_maxAttempts(const NMAP_UltraScan* us, const t_host* host, const uint32_t portIdx) {
+  const uint64_t maxRetries = us->scanType == NMAP_SCAN_UDP ? us->udpMaxRetries : us->maxRetries;
+
+  if (host->baseline.words == NULL)
+    return maxRetries;
+  const NMAP_PortStatus previous = portMap_get(&host->baseline, us_resultIndex(us, portIdx));
+  if (previous == NMAP_CLOSE || previous == NMAP_FILTERED || previous == NMAP_OPEN_FILTERED)
+    return us->baselineRetries < maxRetries ? us->baselineRetries : maxRetries;
+  return maxRetries;
 }
 
 t_host* us_nextHost(NMAP_UltraScan* us) {
@@ -126,9 +110,18 @@ t_host* us_nextHost(NMAP_UltraScan* us) {
   return result;
 }
 
-int64_t sendNextScanProbe(NMAP_UltraScan* us, t_host* host) {
-  t_port* port = host_nextIncPort(host);
+/**
+ * @brief send the probe of a slot and record it as in flight.
+ * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param host {t_host*} - Host of the slot.
+ * @param slot {uint32_t} - Slot of the probe.
+ * @return {int64_t} - 0 if success, 1 otherwise (errno is set).
+ */
+static int64_t us_transmit(NMAP_UltraScan* us, t_host* host, const uint32_t slot) {
+  const uint16_t port = us->slab.port[slot];
   us->packet_sent += 1;
+  us->slab.sendNs[slot] = realtimeNs();
+  atomic_fetch_add_explicit(&us->signals->probesSent, 1, memory_order_relaxed);
   switch (us->scanType) {
   case NMAP_SCAN_SYN:
     if (tcp_syn_send_probe(us, port, host->ip, us->inter_ip))
@@ -150,13 +143,78 @@ int64_t sendNextScanProbe(NMAP_UltraScan* us, t_host* host) {
     if (tcp_xmas_send_probe(us, port, host->ip, us->inter_ip))
       return 1;
     break;
+  case NMAP_SCAN_UDP:
+    if (udp_send_probe(us, port, host->ip, us->inter_ip))
+      return 1;
+    break;
   default:
     fprintf(stderr, "Unsuported scan type\n");
     fprintf(stderr, "got scan = %d\n", us->scanType);
-    exit(4);
+    errno = EINVAL;
+    return 1;
   }
-  port->probeStatus = PROBE_SENT;
-  port->nprobes_sent += 1;
+  us->slab.state[slot] = SLOT_SENT;
+  us->slab.attempts[slot] += 1;
+  hostTable_onSend(host->timing);
+  engine_onProbeSent(us->engine);
+  return 0;
+}
+
+/**
+ * @brief take a global credit for the next probe, and account for the time spent without one.
+ * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @return {bool} - true if a probe can be sent, false if the worker has to wait for replies or timeouts.
+ */
+static bool us_acquireCredit(NMAP_UltraScan* us) {
+  if (credits_tryAcquire(us->credits) == false) {
+    if (us->stallStart.tv_sec == 0)
+      gettimeofday(&us->stallStart, NULL);
+    return false;
+  }
+  if (us->stallStart.tv_sec) {
+    gettimeofday(&us->now, NULL);
+    credits_addStall(us->credits, TIMEVAL_SUBTRACT(us->now, us->stallStart));
+    us->stallStart = (struct timeval){0};
+  }
+  return true;
+}
+
+/**
+ * @brief send the probe of a slot under a global credit.
+ * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @param host {t_host*} - Host of the slot.
+ * @param slot {uint32_t} - Slot of the probe.
+ * @return {int64_t} - 0 if sent, -1 if the worker has to wait (no credit or full send queue), 1 on error.
+ */
+static int64_t us_sendSlot(NMAP_UltraScan* us, t_host* host, const uint32_t slot) {
+  if (us_acquireCredit(us) == false)
+    return -1;
+  if (us_transmit(us, host, slot)) {
+    credits_release(us->credits);
+    if (errno != ENOBUFS && errno != EAGAIN)
+      return 1;
+    // The socket send queue is full, the probe stays pending until the next round
+    atomic_fetch_add_explicit(&us->signals->sendErrors, 1, memory_order_relaxed);
+    return -1;
+  }
+  return 0;
+}
+
+int64_t sendNextScanProbe(NMAP_UltraScan* us, t_host* host) {
+  const uint32_t hostIdx = host - (t_host*)array_data(us->hosts);
+  const uint32_t portIdx = us_portIndex(us, hostIdx, host->idx_ports % us->portOrder.range);
+  const int64_t slot = probeSlab_insert(&us->slab, hostIdx, portIdx, us->ports[portIdx]);
+  // A full slab waits for replies or timeouts, like a lack of credit
+  if (slot < 0)
+    return -1;
+  const int64_t status = us_sendSlot(us, host, slot);
+  if (status) {
+    probeSlab_remove(&us->slab, slot);
+    return status;
+  }
+  host->idx_ports += 1;
+  host->inSlab += 1;
+  us_skipPorts(us, host);
   return 0;
 }
 
@@ -164,9 +222,10 @@ int64_t doAnyNewProbe(NMAP_UltraScan* us) {
   t_host* host = us_nextHost(us);
   const t_host* unableToSend = NULL;
   while (host != NULL && host != unableToSend) {
-    if (host_hasPortPendingLeft(host)) {
-      if (sendNextScanProbe(us, host))
-        return 1;
+    if (hostTable_canSend(host->timing) && host_hasPortPendingLeft(host)) {
+      const int64_t status = sendNextScanProbe(us, host);
+      if (status)
+        return status > 0;
       unableToSend = NULL;
     }
     else if (unableToSend == NULL)
@@ -186,185 +245,197 @@ int64_t pcap_poll(pcap_t* p, const int64_t to_usec) {
   return poll(&fds, 1, to_usec / 1000); // we convert to milliseconds
 }
 
-int64_t read_reply_pcap(pcap_t* handle, const int64_t to_usec, const uint8_t** packet, struct pcap_pkthdr** head,
-                        struct timeval* rcvdtime) {
-  bool timeout = false;
-  struct timeval tv_start, tv_end;
-  gettimeofday(&tv_start, NULL);
-
-  while (timeout == false) {
-    int pcap_status = 0;
-    *packet = NULL;
-    if (pcap_poll(handle, to_usec) == 0)
-      timeout = true;
-    else
-      pcap_status = pcap_next_ex(handle, head, packet);
-    if (pcap_status == PCAP_ERROR)
-      return 1;
-    if (pcap_status == 1 && *packet != NULL) // if its a good packet
-      break;
-    if (pcap_status == 0 || *packet == NULL) {
-      gettimeofday(&tv_end, NULL);
-      if (TIMEVAL_SUBTRACT(tv_end, tv_start) >= to_usec)
-        timeout = 1;
+void us_applyReply(NMAP_UltraScan* us, const NMAP_Reply* reply) {
+  us->packet_recv += 1;
+  for (uint64_t i = 0; i < array_size(us->hosts); ++i) {
+    t_host* host = array_get(us->hosts, i);
+    if (host->ip.s_addr != reply->ip.s_addr)
+      continue;
+    // A probe that is not in the slab already has its result (duplicate or late reply), or was sent to another
+    // host of the group with the same address
+    const int64_t slot = probeSlab_find(&us->slab, i, reply->port);
+    if (slot < 0)
+      continue;
+    if (us->slab.state[slot] == SLOT_SENT) {
+      credits_release(us->credits);
+      us_updateTimeout(us, host, slot, reply->recvTime);
     }
+    else
+      us->retries -= 1;
+    host_foldResult(host, us_resultIndex(us, us->slab.portIdx[slot]), reply->result);
+    host->inSlab -= 1;
+    probeSlab_remove(&us->slab, slot);
+    break;
   }
-  if (timeout)
-    return 1;
-  rcvdtime->tv_sec = (*head)->ts.tv_sec;
-  rcvdtime->tv_usec = (*head)->ts.tv_usec;
-  return 0;
 }
 
-bool get_pcap_result(NMAP_UltraScan* us, const struct timeval* stime) {
-  struct timeval rcvdtime;
-  struct pcap_pkthdr* head;
-  const uint8_t* packet;
+uint64_t us_drainReplies(NMAP_UltraScan* us) {
+  NMAP_Reply replies[RX_BATCH];
+  uint64_t total = 0;
+  size_t count;
 
-  gettimeofday(&us->now, NULL);
-  long to_usec = TIMEVAL_SUBTRACT(*stime, us->now);
-  if (to_usec < 2000)
-    to_usec = 2000;
-
-  if (read_reply_pcap(us->handle, to_usec, &packet, &head, &rcvdtime))
-    return false;
-  struct iphdr* iphdr = (struct iphdr*)(packet + sizeof(struct ether_header));
-  gettimeofday(&us->now, NULL);
-  if (iphdr == NULL || TIMEVAL_SUBTRACT(us->now, *stime) > us->timeout)
-    return false;
-  us->packet_recv += 1;
-  const void* payload = (void*)(packet + sizeof(struct ether_header) + sizeof(struct iphdr));
-  NMAP_PortStatus result = NMAP_UNKNOWN;
-  switch (us->scanType) {
-  case NMAP_SCAN_SYN:
-    result = tcp_syn_analysis(iphdr, payload);
-    break;
-  case NMAP_SCAN_ACK:
-    result = tcp_ack_analysis(iphdr, payload);
-    break;
-  case NMAP_SCAN_NULL:
-    result = tcp_null_analysis(iphdr, payload);
-    break;
-  case NMAP_SCAN_FIN:
-    result = tcp_fin_analysis(iphdr, payload);
-    break;
-  case NMAP_SCAN_XMAS:
-    result = tcp_xmas_analysis(iphdr, payload);
-    break;
-  default:
-    fprintf(stderr, "WTF are you doing\n");
-  }
-  if (result == NMAP_UNKNOWN) {
-    printf("unknown state\n");
-    return false;
-  }
-  uint16_t src_port = 0;
-  if (iphdr->protocol == IPPROTO_TCP) {
-    const struct tcphdr* tcp_tmp = (struct tcphdr*)payload;
-    src_port = ntohs(tcp_tmp->source);
-  }
-  if (iphdr->protocol == IPPROTO_ICMP) {
-    struct icmphdr* icmp_hdr = (struct icmphdr*)payload;
-    if (icmp_hdr->type == ICMP_DEST_UNREACH) {
-      struct iphdr* original_ip_hdr = (struct iphdr*)((unsigned char*)icmp_hdr + sizeof(struct icmphdr));
-      int original_ip_hdr_len = (original_ip_hdr->ihl & 0x0f) * 4;
-      if (original_ip_hdr_len < 20) {
-        printf("Invalid IP header length.\n");
-        return false;
-      }
-      struct tcphdr* original_tcp_hdr = (struct tcphdr*)((unsigned char*)original_ip_hdr + original_ip_hdr_len);
-      // we only have access to the first 8 bytes tcp_header so -> src_port + dest_port + seq_nbr
-      src_port = ntohs(original_tcp_hdr->dest);
-    }
+  while ((count = ring_pop(us->rx.replies, replies, RX_BATCH)) > 0) {
+    for (size_t i = 0; i < count; ++i)
+      us_applyReply(us, replies + i);
+    total += count;
   }
+  return total;
+}
 
-  const struct in_addr ip_src = *(struct in_addr*)&iphdr->saddr;
-  //  printf("recv packet from %s\n", inet_ntoa(ip_src));
-  for (uint64_t i = 0; i < array_size(us->hosts); ++i) {
-    t_host* host = array_get(us->hosts, i);
-    if (memcmp(&host->ip.s_addr, &ip_src, sizeof(ip_src)) != 0)
+/**
+ * @brief send again the probes that timed out, as the congestion windows and the credits allow.
+ * @param us {NMAP_UltraScan*} - NMAP_UltraScan structure.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+static int64_t us_resendRetries(NMAP_UltraScan* us) {
+  NMAP_ProbeSlab* const slab = &us->slab;
+
+  for (uint32_t slot = 0; us->retries && slot < slab->capacity; ++slot) {
+    if (slab->state[slot] != SLOT_RETRY)
       continue;
-    for (uint64_t j = 0; j < array_size(host->ports); ++j) {
-      t_port* port = array_get(host->ports, j);
-      if (port->port != src_port)
-        continue;
-      port->result = result;
-      port->probeStatus = PROBE_RECV;
-      port->recvTime = rcvdtime;
-      us_updateTimeout(us, port);
-      break;
-    }
+    t_host* host = array_get(us->hosts, slab->host[slot]);
+    if (hostTable_canSend(host->timing) == false)
+      continue;
+    const int64_t status = us_sendSlot(us, host, slot);
+    if (status)
+      return status > 0;
+    us->retries -= 1;
   }
-  return true;
+  return 0;
 }
 
-void waitForResponses(NMAP_UltraScan* us) {
-  bool gotone = true;
-  struct timeval stime = {0};
-  gettimeofday(&stime, NULL);
-  while (gotone) {
-    gettimeofday(&us->now, NULL);
-    gotone = get_pcap_result(us, &stime);
-  }
-}
+int64_t doAnyOustandingRetransmit(NMAP_UltraScan* us) {
+  const uint64_t nowNs = realtimeNs();
+  NMAP_ProbeSlab* const slab = &us->slab;
+  double minTimeout = INFINITY;
 
-void doAnyOustandingRetransmit(NMAP_UltraScan* us) {
-  gettimeofday(&us->now, NULL);
   for (uint64_t i = 0; i < array_size(us->hosts); ++i) {
     const t_host* host = array_get(us->hosts, i);
-    for (uint64_t j = 0; j < array_size(host->ports); ++j) {
-      t_port* port = array_get(host->ports, j);
-      if (port->probeStatus == PROBE_SENT) {
-        if (TIMEVAL_SUBTRACT(us->now, port->sendTime) > us->timeout) {
-          if (port->nprobes_sent < us->maxRetries) {
-            us->packet_retransmit += 1;
-            port->probeStatus = PROBE_PENDING;
-          }
-          else {
-            us->port_timeout += 1;
-            port->result = NMAP_FILTERED;
-            port->probeStatus = PROBE_TIMEOUT;
-          }
-        }
+    const double timeout = atomic_load_explicit(&host->timing->timeout, memory_order_relaxed);
+    if (timeout < minTimeout)
+      minTimeout = timeout;
+  }
+  // Most sweeps find nothing, only walk the slots one by one when a probe did time out
+  if (slab->used && probeSlab_hasExpired(slab, nowNs, minTimeout * 1000)) {
+    for (uint32_t slot = 0; slot < slab->capacity; ++slot) {
+      if (slab->state[slot] != SLOT_SENT)
+        continue;
+      t_host* host = array_get(us->hosts, slab->host[slot]);
+      const uint64_t timeoutNs = atomic_load_explicit(&host->timing->timeout, memory_order_relaxed) * 1000;
+      if (nowNs - slab->sendNs[slot] <= timeoutNs)
+        continue;
+      // Most UDP ports stay silent whatever their state: their silence is the answer, not a sign of congestion
+      bool lost = false;
+      if (us->scanType == NMAP_SCAN_UDP)
+        hostTable_onSilence(host->timing);
+      else
+        lost = hostTable_onDrop(us->hostTable, host->timing);
+      credits_release(us->credits);
+      if (slab->attempts[slot] < us_maxAttempts(us, host, slab->portIdx[slot])) {
+        us->packet_retransmit += 1;
+        atomic_fetch_add_explicit(&us->signals->retransmits, 1, memory_order_relaxed);
+        if (lost)
+          atomic_fetch_add_explicit(&us->signals->losses, 1, memory_order_relaxed);
+        slab->state[slot] = SLOT_RETRY;
+        us->retries += 1;
+      }
+      else {
+        us->port_timeout += 1;
+        host_foldResult(host, us_resultIndex(us, slab->portIdx[slot]),
+                        us->scanType == NMAP_SCAN_UDP ? NMAP_OPEN_FILTERED : NMAP_FILTERED);
+        host->inSlab -= 1;
+        probeSlab_remove(slab, slot);
+      }
+    }
+  }
+  return us_resendRetries(us);
+}
+
+/**
+ * @brief run one scan type until every host is done.
+ * @param us {NMAP_UltraScan*} - UltraScan structure, hosts reset for this scan type.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+static int64_t us_run(NMAP_UltraScan* us) {
+  while (us_allHostDone(us) == false) {
+    if (atomic_load_explicit(&us->rx.failed, memory_order_acquire))
+      return 1;
+    const uint64_t sent = us->packet_sent;
+    if (doAnyOustandingRetransmit(us))
+      return 1;
+    if (doAnyNewProbe(us))
+      return 1;
+    // Nothing to send and nothing received: give the RX thread the CPU instead of spinning
+    if (us_drainReplies(us) == 0 && sent == us->packet_sent)
+      usleep(US_IDLE_US);
+    for (uint64_t i = 0; i < array_size(us->hosts); ++i) {
+      t_host* host = array_get(us->hosts, i);
+      if (host_hasPortLeft(host) == false) {
+        host->done = true;
       }
     }
   }
+  return 0;
 }
 
-int64_t ultra_scan(const Array* ips, const Array* ports, const NMAP_ScanType scanType, Array* thread_result) {
+int64_t ultra_scan(const NMAP_WorkerOptions* options) {
+  static const NMAP_ScanType scanTypes[] = {NMAP_SCAN_SYN, NMAP_SCAN_NULL, NMAP_SCAN_ACK, NMAP_SCAN_FIN,
+                                            NMAP_SCAN_XMAS, NMAP_SCAN_UDP};
+  NMAP_Engine* const engine = options->engine;
   NMAP_UltraScan us = {0};
-  us.scanType = scanType;
+  bool error = false;
+  us.engine = engine;
+  us.inter_ip = engine->inter_ip;
+  us.sock = engine->sock;
+  us.udpSock = engine->udpSock;
+  us.hostTable = engine->hostTable;
+  us.credits = &engine->credits;
+  us.signals = &engine->signals;
 
   us_default_init(&us);
-  us.sock = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
-  if (us.sock < 0) {
-    perror("socket/ultra_scan");
+  if (us_createHost(&us, options)) {
+    perror("malloc");
     return 1;
   }
-  if (us_createHost(&us, ips, ports)) {
-    perror(array_strerror());
+  us.handle = engine_borrowHandle(engine);
+  if (us.handle == NULL) {
+    probeSlab_destroy(&us.slab);
+    array_destroy(us.hosts);
     return 1;
   }
-  if (init_sniffer(&us)) {
-    printf("init sniffer failed\n");
+  if (rx_init(&us.rx, us.handle, us.signals)) {
+    engine_returnHandle(engine, us.handle);
+    probeSlab_destroy(&us.slab);
+    array_destroy(us.hosts);
     return 1;
   }
-  while (us_allHostDone(&us) == false) {
-    doAnyOustandingRetransmit(&us);
-    if (doAnyNewProbe(&us)) {
-      array_destroy(us.hosts);
-      return 1;
+  // The hosts and the pcap handle are reused by every scan type, only the probe state is reset
+  for (uint64_t i = 0; i < COUNTOF(scanTypes); ++i) {
+    if ((options->scan & scanTypes[i]) == 0)
+      continue;
+    us.scanType = scanTypes[i];
+    us.idxNextHosts = 0;
+    us.retries = 0;
+    probeSlab_clear(&us.slab);
+    for (uint64_t j = 0; j < array_size(us.hosts); ++j) {
+      host_resetPorts(array_get(us.hosts, j));
+      us_skipPorts(&us, array_get(us.hosts, j));
     }
-    waitForResponses(&us);
-    for (uint64_t i = 0; i < array_size(us.hosts); ++i) {
-      t_host* host = array_get(us.hosts, i);
-      if (host_hasPortLeft(host) == false) {
-        host->done = true;
-      }
+    engine_drainHandle(us.handle);
+    if (rx_start(&us.rx, us.scanType)) {
+      error = true;
+      break;
     }
+    // The RX thread reads the replies while this thread keeps sending and sweeping for timeouts
+    error = us_run(&us);
+    rx_stop(&us.rx);
+    if (error)
+      break;
+    us_drainReplies(&us);
   }
-  pcap_close(us.handle);
-  close(us.sock);
-  array_pushBack(thread_result, &us.hosts, 1);
-  return 0;
-}
\ No newline at end of file
+  rx_destroy(&us.rx);
+  engine_returnHandle(engine, us.handle);
+  probeSlab_destroy(&us.slab);
+  array_destroy(us.hosts);
+  return error;
+}
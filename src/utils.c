@@ -59,8 +59,12 @@ char* port_status_to_string(const NMAP_PortStatus status) {
     return "filtered";
   case NMAP_UNFILTERED:
     return "unfiltered";
+  case NMAP_OPEN_FILTERED:
+    return "open|filtered";
   case NMAP_UNKNOWN:
     return "unknown";
   }
   return "REALY REALY WEIRD STUFF IS HAPENING RIGHT NOW IN PORT STATUS TO STRING";
 }
+
+const char* scan_protocol(const uint32_t scan) { return scan == NMAP_SCAN_UDP ? "udp" : "tcp"; }
@@ -1,236 +1,756 @@
 #include <ft_nmap.h>
 
-static bool ArrayFn_hostFind(const Array* arr, size_t i, const void* value, void* param) {
-  (void)arr, (void)i;
-  return ((const t_host*)value)->ip.s_addr == ((const t_host*)param)->ip.s_addr;
+static void destroyWorkers(int status, void* arg) {
+  (void)status;
+  array_destroy(arg);
+}
+
+/**
+ * @brief Targets scanned together: every port slice of the group is scanned before its hosts are reported and freed.
+ * @param {Array<NMAP_HostTiming>} timings - Timing of every host, shared by the workers scanning the group.
+ * @param {Array<t_host>} hosts - Result store of the group, created before its first chunk is handed out. Every
+ * worker folds its results straight into the maps of the store, at the index of the port in the scan.
+ * @param {uint32_t} targets - Targets pulled from the generator for the group, the dead ones included.
+ * @param {uint64_t} handedOut - Port slices handed out to the workers.
+ * @param {uint64_t} scanned - Port slices scanned (or failed).
+ * @param {uint64_t} probesSent - Probes sent by the engine when the group was opened.
+ * @param {uint64_t} losses - Probes lost by the engine when the group was opened.
+ */
+typedef struct s_nmap_host_group {
+  Array* timings;
+  Array* hosts;
+  uint32_t targets;
+  uint64_t handedOut;
+  uint64_t scanned;
+  uint64_t probesSent;
+  uint64_t losses;
+} NMAP_HostGroup;
+
+/**
+ * @brief Work shared by all the workers: the targets are cut in host groups opened one after the other, each group
+ * is scanned one port slice at a time. Only the open groups are in memory.
+ * @param {Array<NMAP_WorkerOptions>} chunks - Port slices, each one scanned by a single worker for a given group.
+ * @param {NMAP_Permutation} portOrder - Order of the ports of options, chunk i takes its next positions.
+ * @param {Array<NMAP_HostGroup*>} groups - Open groups, in target order. Only the last one has slices to hand out.
+ * @param {const NMAP_Options*} options - Targets, ports and host group bounds.
+ * @param {uint32_t} groupSize - Size of the next group, adapted to the health of the scan.
+ * @param {uint64_t} groupsOpened - Number of groups opened so far.
+ * @param {uint32_t} peakGroupSize - Largest group opened so far.
+ * @param {pthread_mutex_t} lock - Lock protecting the groups and every field above.
+ * @param {bool} discovering - A worker is discovering the next group with the lock released, the others wait for it
+ * to be open.
+ * @param {pthread_cond_t} discovered - Signaled when the next group is open.
+ * @param {_Atomic bool} error - Set by a worker that failed, stops the others after their current chunk.
+ * @param {NMAP_Engine*} engine - Shared engine, its signals drive the elastic controller and the group size.
+ * @param {NMAP_Output} output - Writer of the results, fed by the workers as chunks and groups complete.
+ * @param {NMAP_ResultWriter} archive - Writer of the binary result file, fed as groups complete (with --result-file).
+ * @param {NMAP_Checkpoint} checkpoint - Progress of the scan, fed as groups complete (with --checkpoint).
+ * @param {NMAP_Baseline} baseline - Previous scan the groups are scanned and reported against (with --baseline).
+ * @param {NMAP_Discovery} discovery - Discovery of the live hosts of every group (unless --discovery none).
+ * @param {uint32_t*} byPort - Result indices of the ports sorted by port, the order the ports of a host are reported
+ * in.
+ */
+struct s_nmap_worker_pool {
+  Array* chunks;
+  NMAP_Permutation portOrder;
+  Array* groups;
+  const NMAP_Options* options;
+  uint32_t groupSize;
+  uint64_t groupsOpened;
+  uint32_t peakGroupSize;
+  pthread_mutex_t lock;
+  bool discovering;
+  pthread_cond_t discovered;
+  _Atomic bool error;
+  NMAP_Engine* engine;
+  NMAP_Output output;
+  NMAP_ResultWriter archive;
+  NMAP_Checkpoint checkpoint;
+  NMAP_Baseline baseline;
+  NMAP_Discovery discovery;
+  uint32_t* byPort;
+};
+
+static void group_destroy(NMAP_HostGroup* group) {
+  if (group == NULL)
+    return;
+  host_destroyArray(group->hosts);
+  array_destroy(group->timings);
+  free(group);
+}
+
+static void pool_flushGroups(NMAP_WorkerPool* pool, bool force);
+
+/**
+ * @brief find the live targets of the next group with the pool unlocked, so that the workers keep reporting the
+ * groups they scan meanwhile.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked.
+ * @param ips {Array<in_addr_t>*} - Targets of the group, only the live ones are left in it.
+ * @param rtts {Array<uint32_t>*} - Set to the discovery round-trip time of every live target.
+ * @return {int64_t} - 0 if success, 1 otherwise.
+ */
+static int64_t pool_discoverGroup(NMAP_WorkerPool* pool, Array* ips, Array* rtts) {
+  pool->discovering = true;
+  pthread_mutex_unlock(&pool->lock);
+  const int64_t error = discovery_run(&pool->discovery, ips, rtts);
+  pthread_mutex_lock(&pool->lock);
+  pool->discovering = false;
+  pthread_cond_broadcast(&pool->discovered);
+  return error;
+}
+
+/**
+ * @brief pull the next targets of the generator, and keep the live ones.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked.
+ * @param ips {Array<in_addr_t>*} - Set to the live targets.
+ * @param rtts {Array<uint32_t>*} - Set to their discovery round-trip time in microseconds, 0 when unknown (empty
+ * without discovery).
+ * @return {uint32_t} - Number of targets pulled, 0 when the generator is exhausted or on failure (pool->error is then
+ * set).
+ */
+static uint32_t pool_pullTargets(NMAP_WorkerPool* pool, Array* ips, Array* rtts) {
+  NMAP_Targets* const targets = pool->options->targets;
+
+  array_clear(rtts);
+  if (targets->exhausted)
+    return 0;
+  if (array_resize(ips, pool->groupSize)) {
+    perror("malloc");
+    atomic_store(&pool->error, true);
+    return 0;
+  }
+  const uint32_t pulled = targets_next(targets, array_data(ips), pool->groupSize);
+  array_resize(ips, pulled);
+  if (pulled && pool->options->discovery && pool_discoverGroup(pool, ips, rtts)) {
+    atomic_store(&pool->error, true);
+    return 0;
+  }
+  return pulled;
 }
 
 /**
- * merge the result of all scan for an host at the end of a thread
- * @param thread_result {Array<Array<t_host>> - An array of array of host, each host contains an array of t_port with
- * their status
- * @return {Array<t_host>} - return an array of unique t_host (thread_result can contains multiple time the same t_host)
+ * @brief create the group of the live targets pulled.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked.
+ * @param ips {const Array<in_addr_t>*} - Live targets.
+ * @param rtts {const Array<uint32_t>*} - Their discovery round-trip time, seeding their timeout.
+ * @param targets {uint32_t} - Targets pulled, the dead ones included.
+ * @return {NMAP_HostGroup*} - The group, pushed at the back of pool->groups. NULL on allocation failure (pool->error
+ * is then set).
  */
-static Array* merge_thread_result(Array* thread_result) {
-  // result == Array<t_host>
-  Array* result = array(sizeof(t_host), array_size(thread_result), 0, NULL, NULL);
-  if (result == NULL) {
-    array_destroy(thread_result);
+static NMAP_HostGroup* pool_pushGroup(NMAP_WorkerPool* pool, const Array* ips, const Array* rtts,
+                                      const uint32_t targets) {
+  NMAP_HostGroup* const group = calloc(1, sizeof(NMAP_HostGroup));
+
+  if (group) {
+    group->targets = targets;
+    group->timings = hostTable_createTimings(ips);
+  }
+  // The first probes to a host that replied to the discovery time out after a few of its round-trips, not after 1s
+  for (uint64_t i = 0; group && group->timings && i < array_size(rtts); ++i) {
+    const uint32_t rtt = *(const uint32_t*)array_cGet(rtts, i);
+    if (rtt)
+      hostTable_onReply(pool->engine->hostTable, array_get(group->timings, i), rtt);
+  }
+  if (group && group->timings)
+    group->hosts = host_createArray(ips, group->timings, array_size(pool->options->ports), pool->baseline.open);
+  if (group && group->hosts)
+    pool->peakGroupSize = array_size(ips) > pool->peakGroupSize ? array_size(ips) : pool->peakGroupSize;
+  for (uint64_t i = 0; group && group->hosts && pool->baseline.open && i < array_size(group->hosts); ++i) {
+    t_host* host = array_get(group->hosts, i);
+    // A host new to the baseline is scanned like without one
+    if (baseline_load(&pool->baseline, host->ip, &host->baseline) == false)
+      host->baseline = (NMAP_PortMap){0};
+  }
+  if (group == NULL || group->hosts == NULL || array_pushBack(pool->groups, &group, 1)) {
+    perror("malloc");
+    group_destroy(group);
+    atomic_store(&pool->error, true);
     return NULL;
   }
-  for (uint64_t i = 0; i < array_size(thread_result); ++i) {
-    // tmp_result == Array<t_host>
-    Array* tmp_result = *(Array**)array_get(thread_result, i);
-    for (uint64_t j = 0; j < array_size(tmp_result); ++j) {
-      t_host* host_tmp = array_get(tmp_result, j);
-      if (array_anyIf(result, ArrayFn_hostFind, host_tmp) == false) {
-        // Its the first time we see this host_tmp so we simply push it
-        array_pushBack(result, host_tmp, 1);
-        continue;
-      }
-      // We already have a result for this host_tmp so we need to merge both result
-      // Find the actual instance of host in thread_result
-      const t_host* host_result = array_findIf(result, ArrayFn_hostFind, host_tmp);
-      // merge result for all ports
-      for (uint64_t x = 0; x < array_size(host_tmp->ports); ++x) {
-        const t_port* port_tmp = array_get(host_tmp->ports, x);
-        t_port* port_result = array_get(host_result->ports, x);
-        if (port_result->result == NMAP_OPEN)
-          continue;
-        if (port_tmp->result == NMAP_CLOSE)
-          port_result->result = NMAP_CLOSE;
-        port_result->result = port_tmp->result;
+  group->probesSent = atomic_load(&pool->engine->signals.probesSent);
+  group->losses = atomic_load(&pool->engine->signals.losses);
+  pool->groupsOpened += 1;
+  return group;
+}
+
+/**
+ * @brief open a group with the next live targets of the generator. A group whose targets are all dead is done as
+ * soon as it is open, the next one is opened in its place.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked (released while the targets are discovered).
+ * @return {NMAP_HostGroup*} - The group, pushed at the back of pool->groups. NULL when the generator is exhausted or
+ * on allocation failure (pool->error is then set).
+ */
+static NMAP_HostGroup* pool_openGroup(NMAP_WorkerPool* pool) {
+  Array* const ips = array(sizeof(in_addr_t), 0, 0, NULL, NULL);
+  Array* const rtts = array(sizeof(uint32_t), 0, 0, NULL, NULL);
+  NMAP_HostGroup* group = NULL;
+  uint32_t pulled;
+
+  if (ips == NULL || rtts == NULL) {
+    perror("malloc");
+    atomic_store(&pool->error, true);
+  }
+  while (group == NULL && ips && rtts && (pulled = pool_pullTargets(pool, ips, rtts))) {
+    group = pool_pushGroup(pool, ips, rtts, pulled);
+    if (group == NULL || array_empty(group->hosts) == false)
+      break;
+    // Its targets are still checkpointed, in order
+    group->handedOut = group->scanned = array_size(pool->chunks);
+    group = NULL;
+    pool_flushGroups(pool, false);
+  }
+  array_destroy(ips);
+  array_destroy(rtts);
+  return group;
+}
+
+/**
+ * @brief hand out the next port slice to scan, opening a new group once every slice of the last one is handed out:
+ * a group starts as soon as the workers are done with the slices of the previous one.
+ * @param pool {NMAP_WorkerPool*} - Shared work.
+ * @param chunk {uint64_t*} - Set to the index of the port slice to scan.
+ * @return {NMAP_HostGroup*} - Group to scan the slice for, NULL when every target has been handed out.
+ */
+static NMAP_HostGroup* pool_nextChunk(NMAP_WorkerPool* pool, uint64_t* chunk) {
+  NMAP_HostGroup* group = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  // The next group is being discovered, its slices are handed out once it is open
+  while (pool->discovering)
+    pthread_cond_wait(&pool->discovered, &pool->lock);
+  if (array_empty(pool->groups) == false)
+    group = *(NMAP_HostGroup**)array_back(pool->groups);
+  if (group == NULL || group->handedOut == array_size(pool->chunks))
+    group = pool_openGroup(pool);
+  if (group)
+    *chunk = group->handedOut++;
+  pthread_mutex_unlock(&pool->lock);
+  return group;
+}
+
+/**
+ * @brief number of chunks that can still be handed out, counting one group worth of chunks while targets are left.
+ * @param pool {NMAP_WorkerPool*} - Shared work.
+ * @return {uint64_t} - 0 once every target has been handed out.
+ */
+static uint64_t pool_chunksLeft(NMAP_WorkerPool* pool) {
+  uint64_t left = 0;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->options->targets->exhausted == false || pool->discovering)
+    left += array_size(pool->chunks);
+  if (array_empty(pool->groups) == false)
+    left += array_size(pool->chunks) - (*(NMAP_HostGroup**)array_back(pool->groups))->handedOut;
+  pthread_mutex_unlock(&pool->lock);
+  return left;
+}
+
+/**
+ * @brief hand the open ports of a host to the writer, in numeric order.
+ * @param pool {NMAP_WorkerPool*} - Shared work.
+ * @param host {const t_host*} - Host.
+ */
+static void NMAP_reportPorts(NMAP_WorkerPool* pool, const t_host* host) {
+  NMAP_OutputRecord record = {.ip = host->ip, .type = OUTPUT_PORT, .status = NMAP_OPEN};
+
+  for (uint32_t i = 0; i < host->results.count; ++i) {
+    const uint32_t x = pool->byPort[i];
+    if (portMap_get(&host->results, x) != NMAP_OPEN)
+      continue;
+    record.port = *(const uint16_t*)array_cGet(pool->options->ports, x);
+    output_push(&pool->output, &record);
+  }
+}
+
+/**
+ * @brief whether a port changed since the baseline: newly open, or open in the baseline and not anymore.
+ * @param status {NMAP_PortStatus} - Result of the port.
+ * @param previous {NMAP_PortStatus} - Status of the port in the baseline.
+ * @return {bool} - false for a port without a result, or with the same state.
+ */
+static bool NMAP_hasChanged(const NMAP_PortStatus status, const NMAP_PortStatus previous) {
+  return status != NMAP_UNKNOWN && (status == NMAP_OPEN) != (previous == NMAP_OPEN);
+}
+
+/**
+ * @brief hand the ports of a host that changed since the baseline to the writer, in numeric order.
+ * @param pool {NMAP_WorkerPool*} - Shared work, the baseline of the host loaded in its scratch map.
+ * @param host {const t_host*} - Host.
+ */
+static void NMAP_reportChanges(NMAP_WorkerPool* pool, const t_host* host) {
+  NMAP_OutputRecord record = {.ip = host->ip, .type = OUTPUT_CHANGE};
+
+  for (uint32_t i = 0; i < host->results.count; ++i) {
+    const uint32_t x = pool->byPort[i];
+    record.status = portMap_get(&host->results, x);
+    record.previous = portMap_get(&pool->baseline.scratch, x);
+    if (NMAP_hasChanged(record.status, record.previous) == false)
+      continue;
+    record.port = *(const uint16_t*)array_cGet(pool->options->ports, x);
+    output_push(&pool->output, &record);
+  }
+}
+
+/**
+ * @brief hand the final results of a host group to the writer: a summary per host, preceded (streamed formats) or
+ * followed (text report) by its open ports and, with a baseline, the ports that changed since.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked or not shared yet.
+ * @param hosts {const Array<t_host>*} - Result store of the group.
+ * @param streamed {bool} - The open ports were already streamed as each chunk completed (streamed formats only).
+ */
+static void NMAP_reportHosts(NMAP_WorkerPool* pool, const Array* hosts, const bool streamed) {
+  const bool text = output_isStreamed(pool->output.format) == false;
+  NMAP_Baseline* const baseline = &pool->baseline;
+
+  for (uint64_t i = 0; i < array_size(hosts); ++i) {
+    const t_host* host = array_cGet(hosts, i);
+    NMAP_OutputRecord record = {.ip = host->ip, .type = OUTPUT_HOST, .diff = baseline->open};
+    // A host new to the baseline is compared to an empty one: all its open ports are new
+    if (record.diff)
+      baseline_load(baseline, host->ip, &baseline->scratch);
+    // A port of a chunk that failed stays unknown
+    for (uint32_t x = 0; x < host->results.count; ++x) {
+      const NMAP_PortStatus status = portMap_get(&host->results, x);
+      record.analyzed += status != NMAP_UNKNOWN;
+      if (record.diff && NMAP_hasChanged(status, portMap_get(&baseline->scratch, x))) {
+        record.opened += status == NMAP_OPEN;
+        record.closed += status != NMAP_OPEN;
       }
-      array_destroy(host_tmp->ports);
     }
+    if (text == false && streamed == false)
+      NMAP_reportPorts(pool, host);
+    if (text == false && record.diff)
+      NMAP_reportChanges(pool, host);
+    output_push(&pool->output, &record);
+    if (text)
+      NMAP_reportPorts(pool, host);
+    if (text && record.diff)
+      NMAP_reportChanges(pool, host);
   }
-  return result;
 }
 
 /**
- * @brief - Merge the result of all thread together
- * @param all_result {Array<Array<t_host>>} - An array of the result of  all the thread
- * @return {Array<t_host>} - An array with the result of all analyzed port for all host
+ * @brief stream the open ports of a chunk that was just scanned, its results are final since every scan type of the
+ * chunk ports is done.
+ * @param output {NMAP_Output*} - Writer.
+ * @param hosts {const Array<t_host>*} - Result store of the group the chunk was scanned for.
+ * @param chunk {const NMAP_WorkerOptions*} - Chunk.
  */
-Array* merge_final_result(Array* all_result) {
-  (void)all_result;
-  Array* result = array(sizeof(t_host), 0, 0, NULL, NULL);
-  for (uint64_t i = 0; i < array_size(all_result); ++i) {
-    Array* tmp_arr = *(Array**)array_get(all_result, i);
-    for (uint64_t j = 0; j < array_size(tmp_arr); ++j) {
-      t_host* host_tmp = array_get(tmp_arr, j);
-      if (array_anyIf(result, ArrayFn_hostFind, host_tmp) == false) {
-        array_pushBack(result, host_tmp, 1);
+static void NMAP_streamChunk(NMAP_Output* output, const Array* hosts, const NMAP_WorkerOptions* chunk) {
+  NMAP_OutputRecord record = {.type = OUTPUT_PORT, .status = NMAP_OPEN};
+
+  for (uint32_t j = 0; j < array_size(chunk->ports); ++j) {
+    const uint32_t idx = permutation_at(chunk->portOrder, chunk->portOffset + j);
+    record.port = *(const uint16_t*)array_cGet(chunk->ports, j);
+    for (uint64_t i = 0; i < array_size(hosts); ++i) {
+      const t_host* host = array_cGet(hosts, i);
+      if (portMap_get(&host->results, idx) != NMAP_OPEN)
         continue;
-      }
-      const t_host* host_result = array_findIf(result, ArrayFn_hostFind, host_tmp);
-      array_pushBack(host_result->ports, array_data(host_tmp->ports), array_size(host_tmp->ports));
+      record.ip = host->ip;
+      output_push(output, &record);
     }
   }
-  return result;
+}
+
+/**
+ * @brief size the next group from the loss rate seen while a group was scanned: double it while the scan is healthy,
+ * halve it as soon as probes get lost, within the host group bounds.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked.
+ * @param group {const NMAP_HostGroup*} - Group that was just scanned.
+ */
+static void pool_adaptGroupSize(NMAP_WorkerPool* pool, const NMAP_HostGroup* group) {
+  const uint64_t sent = atomic_load(&pool->engine->signals.probesSent) - group->probesSent;
+  // A retry to a silently filtered port is not a loss, a group of firewalled hosts is not an unhealthy one
+  const uint64_t losses = atomic_load(&pool->engine->signals.losses) - group->losses;
+  const double lossRate = sent ? (double)losses / sent : 0;
+
+  if (lossRate > ELASTIC_MAX_LOSS)
+    pool->groupSize = pool->groupSize / 2 > pool->options->minHostgroup ? pool->groupSize / 2
+                                                                        : pool->options->minHostgroup;
+  else if (lossRate <= ELASTIC_MAX_LOSS / 2)
+    pool->groupSize = pool->groupSize < pool->options->maxHostgroup / 2 ? pool->groupSize * 2
+                                                                        : pool->options->maxHostgroup;
+}
+
+static int ArrayFn_archiveHost(unused const Array* arr, unused size_t i, const void* value, void* param) {
+  resultWriter_addHost(param, value);
+  return 0;
+}
+
+/**
+ * @brief report a group recovered from the checkpoint as if it had just been scanned.
+ * @param hosts {const Array<t_host>*} - Hosts of the group, with their results.
+ * @param param {void*} - Shared work.
+ */
+static void pool_replayGroup(const Array* hosts, void* param) {
+  NMAP_WorkerPool* const pool = param;
+
+  NMAP_reportHosts(pool, hosts, false);
+  if (pool->options->resultPath)
+    array_cForEach(hosts, ArrayFn_archiveHost, &pool->archive);
+}
+
+/**
+ * @brief report and free the scanned groups at the front of the queue, so that hosts are reported in target order.
+ * @param pool {NMAP_WorkerPool*} - Shared work, locked.
+ * @param force {bool} - Report every open group, even partially scanned (once the workers are joined).
+ */
+static void pool_flushGroups(NMAP_WorkerPool* pool, const bool force) {
+  while (array_empty(pool->groups) == false) {
+    NMAP_HostGroup* group = *(NMAP_HostGroup**)array_front(pool->groups);
+    if (force == false && group->scanned != array_size(pool->chunks))
+      break;
+    pool_adaptGroupSize(pool, group);
+    NMAP_reportHosts(pool, group->hosts, true);
+    if (pool->options->resultPath)
+      array_cForEach(group->hosts, ArrayFn_archiveHost, &pool->archive);
+    // A group left unfinished by a failure is scanned again by a resumed scan
+    if (pool->options->checkpointPath && group->scanned == array_size(pool->chunks) &&
+        atomic_load(&pool->error) == false)
+      checkpoint_addGroup(&pool->checkpoint, group->hosts, group->targets);
+    group_destroy(group);
+    array_popFront(pool->groups, 1, NULL);
+  }
 }
 
 static void* NMAP_workerMain(void* arg) {
-  const NMAP_WorkerOptions* const options = arg;
-  Array* thread_result = array(sizeof(Array*), array_size(options->ips), 0, NULL, NULL);
-  // thread_result == Array<Array<t_host>>
-  if (thread_result == NULL)
-    return NULL;
-  if (options->scan & NMAP_SCAN_SYN)
-    ultra_scan(options->ips, options->ports, NMAP_SCAN_SYN, thread_result);
-  if (options->scan & NMAP_SCAN_NULL)
-    ultra_scan(options->ips, options->ports, NMAP_SCAN_NULL, thread_result);
-  if (options->scan & NMAP_SCAN_ACK)
-    ultra_scan(options->ips, options->ports, NMAP_SCAN_ACK, thread_result);
-  if (options->scan & NMAP_SCAN_FIN)
-    ultra_scan(options->ips, options->ports, NMAP_SCAN_FIN, thread_result);
-  if (options->scan & NMAP_SCAN_XMAS)
-    ultra_scan(options->ips, options->ports, NMAP_SCAN_XMAS, thread_result);
-  Array* result = merge_thread_result(thread_result);
-  for (uint64_t i = 0; i < array_size(thread_result); ++i) {
-    Array* arr = *(Array**)array_get(thread_result, i);
-    array_destroy(arr);
-  }
-  array_destroy(thread_result);
-  return result;
-}
-
-static void workerDataDestructor(Array* arr, void* data, size_t n) {
-  (void)arr;
-  const NMAP_WorkerData* const workers = data;
-  for (size_t i = 0; i < n; ++i) {
-    array_destroy(workers[i].options.ports);
-    Array* tmp = workers[i].result;
-    for (uint64_t j = 0; j < array_size(tmp); ++j) {
-      t_host* host = array_get(tmp, j);
-      array_destroy(host->ports);
-    }
-    array_destroy(workers[i].result);
+  NMAP_WorkerData* const worker = arg;
+  NMAP_WorkerPool* const pool = worker->pool;
+  uint64_t i;
+
+  while (atomic_load(&worker->retire) == false && atomic_load(&pool->error) == false) {
+    NMAP_HostGroup* const group = pool_nextChunk(pool, &i);
+    if (group == NULL)
+      break;
+    NMAP_WorkerOptions chunk = *(NMAP_WorkerOptions*)array_get(pool->chunks, i);
+    chunk.hosts = group->hosts;
+    if (ultra_scan(&chunk))
+      atomic_store(&pool->error, true);
+    // Pushed before the chunk is counted, so the summary of its hosts comes after their ports
+    if (output_isStreamed(pool->output.format))
+      NMAP_streamChunk(&pool->output, group->hosts, &chunk);
+    pthread_mutex_lock(&pool->lock);
+    group->scanned += 1;
+    if (group->scanned == array_size(pool->chunks))
+      pool_flushGroups(pool, false);
+    pthread_mutex_unlock(&pool->lock);
   }
+  atomic_store(&worker->finished, true);
+  return NULL;
 }
 
-static void destroyWorkers(int status, void* arg) {
+static void chunkDestructor(unused Array* arr, void* data, const size_t n) {
+  const NMAP_WorkerOptions* const chunks = data;
+  for (size_t i = 0; i < n; ++i)
+    array_destroy(chunks[i].ports);
+}
+
+static void groupsDestructor(unused Array* arr, void* data, const size_t n) {
+  NMAP_HostGroup** const groups = data;
+  for (size_t i = 0; i < n; ++i)
+    group_destroy(groups[i]);
+}
+
+static void destroyPool(int status, void* arg) {
   (void)status;
-  array_destroy(arg);
+  NMAP_WorkerPool* const pool = arg;
+
+  array_destroy(pool->chunks);
+  array_destroy(pool->groups);
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->discovered);
+  output_stop(&pool->output);
+  output_destroy(&pool->output);
+  resultWriter_close(&pool->archive);
+  checkpoint_close(&pool->checkpoint);
+  baseline_close(&pool->baseline);
+  discovery_destroy(&pool->discovery);
+  free(pool->byPort);
+}
+
+static void destroyEngine(int status, void* arg) {
+  (void)status;
+  engine_destroy(arg);
 }
 
 typedef struct s_worker_setup_param {
-  const uint16_t minPortsPerWorker;
+  const uint32_t minPortsPerWorker;
   const uint16_t scan;
-  uint16_t remainder;
-  uint16_t portsLeft;
-  const Array* const ips;
+  uint32_t remainder;
+  uint32_t portsLeft;
   const Array* const ports;
+  const NMAP_Permutation* const order;
+  const bool randomize;
+  const uint64_t seed;
+  NMAP_Engine* const engine;
 } WorkerSetupParam;
 
-static int ArrayFn_setupWorkerOptions(unused Array* arr, unused size_t i, void* value, void* param) {
+static int ArrayFn_setupWorkerOptions(unused Array* arr, const size_t i, void* value, void* param) {
   WorkerSetupParam* const setup = param;
-  NMAP_WorkerData* const worker = value;
-  const ptrdiff_t from = -setup->portsLeft;
-  const ptrdiff_t to = array_size(setup->ports) - setup->portsLeft + setup->minPortsPerWorker + !!setup->remainder;
+  NMAP_WorkerOptions* const options = value;
+  const uint32_t from = array_size(setup->ports) - setup->portsLeft;
+  const uint32_t count = setup->minPortsPerWorker + !!setup->remainder;
 
-  worker->options.scan = setup->scan;
-  worker->options.ips = setup->ips;
-  worker->options.ports = array_sliced(setup->ports, from, to);
-  if (worker->options.ports == NULL) {
+  options->scan = setup->scan;
+  options->hosts = NULL; // set to the group the chunk is handed out for
+  options->portOffset = from;
+  options->portOrder = setup->order;
+  options->engine = setup->engine;
+  options->randomize = setup->randomize;
+  options->seed = permutation_mix(setup->seed + i);
+  options->ports = array(sizeof(uint16_t), 0, count, NULL, NULL);
+  if (options->ports == NULL) {
     perror("ft_nmap");
     return 1;
   }
-  setup->portsLeft -= array_size(worker->options.ports);
+  // The chunk takes the next positions of the port order: a slice of the ports, or a random subset of them
+  for (uint32_t j = 0; j < count; ++j)
+    *(uint16_t*)array_get(options->ports, j) =
+        *(const uint16_t*)array_cGet(setup->ports, permutation_at(setup->order, from + j));
+  setup->portsLeft -= count;
   if (setup->remainder)
     --setup->remainder;
   return 0;
 }
 
-static int ArrayFn_cancelWorkerThread(unused const Array* arr, unused size_t i, const void* value, unused void* param) {
-  const NMAP_WorkerData* const worker = value;
+static void NMAP_joinWorker(NMAP_WorkerData* worker) {
+  if (worker->running == false)
+    return;
+  if (pthread_join(worker->thread, NULL))
+    perror("ft_nmap: failed to join a thread");
+  worker->running = false;
+}
 
-  pthread_cancel(worker->thread);
+static int NMAP_spawnWorker(NMAP_WorkerData* worker, NMAP_WorkerPool* pool) {
+  worker->pool = pool;
+  worker->cpuNs = 0;
+  atomic_store(&worker->retire, false);
+  atomic_store(&worker->finished, false);
+  if (pthread_create(&worker->thread, NULL, NMAP_workerMain, worker)) {
+    perror("ft_nmap: failed to spawn a thread");
+    return 1;
+  }
+  worker->running = true;
   return 0;
 }
 
-static int ArrayFn_joinWorkerThread(unused Array* arr, unused size_t i, void* value, void* param) {
-  bool* const threadError = param;
+static int ArrayFn_cancelWorkerThread(unused Array* arr, unused size_t i, void* value, unused void* param) {
   NMAP_WorkerData* const worker = value;
 
-  if (pthread_join(worker->thread, &worker->result)) {
-    if (threadError)
-      *threadError = true;
-    perror("ft_nmap: failed to join a thread");
-  }
-  else if (worker->result == NULL) {
-    if (threadError)
-      *threadError = true;
-    fputs("ft_nmap: an error occured in a worker thread\n", stderr);
-  }
+  if (worker->running)
+    pthread_cancel(worker->thread);
+  NMAP_joinWorker(worker);
   return 0;
 }
 
-static int ArrayFn_spawnWorkerThread(Array* arr, size_t i, void* value, unused void* param) {
-  NMAP_WorkerData* const worker = value;
+static int ArrayFn_joinWorkerThread(unused Array* arr, unused size_t i, void* value, unused void* param) {
+  NMAP_joinWorker(value);
+  return 0;
+}
 
-  if (pthread_create(&worker->thread, NULL, NMAP_workerMain, &worker->options)) {
-    array_cForEachWithin(arr, 0, i, ArrayFn_cancelWorkerThread, NULL);
-    array_forEachWithin(arr, 0, i, ArrayFn_joinWorkerThread, NULL);
-    perror("ft_nmap: failed to spawn a thread");
-    return 1;
+static uint64_t monotonicNs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Snapshot of the pool signals taken at each elastic controller tick.
+ */
+typedef struct s_elastic_sample {
+  uint64_t wallNs;
+  uint64_t probesSent;
+  uint64_t losses;
+  uint64_t sendErrors;
+  uint64_t captureDrops;
+} ElasticSample;
+
+static ElasticSample elastic_sample(const NMAP_WorkerPool* pool) {
+  const NMAP_PoolSignals* const signals = &pool->engine->signals;
+  return (ElasticSample){
+    .wallNs = monotonicNs(),
+    .probesSent = atomic_load(&signals->probesSent),
+    .losses = atomic_load(&signals->losses),
+    .sendErrors = atomic_load(&signals->sendErrors),
+    .captureDrops = atomic_load(&signals->captureDrops),
+  };
+}
+
+/**
+ * @brief average CPU utilisation of the live workers since the previous tick.
+ * @param workers {Array<NMAP_WorkerData>} - All the worker slots.
+ * @param wallNs {uint64_t} - Wall time elapsed since the previous tick.
+ * @return {double} - Utilisation in [0, 1] (0 when no worker is alive).
+ */
+static double elastic_cpuUtilisation(Array* workers, const uint64_t wallNs) {
+  double total = 0;
+  uint64_t alive = 0;
+
+  for (uint64_t i = 0; i < array_size(workers); ++i) {
+    NMAP_WorkerData* const worker = array_get(workers, i);
+    clockid_t clock;
+    struct timespec ts;
+    if (worker->running == false || atomic_load(&worker->finished) ||
+        pthread_getcpuclockid(worker->thread, &clock) || clock_gettime(clock, &ts))
+      continue;
+    const uint64_t cpuNs = ts.tv_sec * 1'000'000'000ULL + ts.tv_nsec;
+    if (worker->cpuNs && wallNs) {
+      total += (double)(cpuNs - worker->cpuNs) / wallNs;
+      ++alive;
+    }
+    worker->cpuNs = cpuNs;
   }
-  return 0;
+  return alive ? total / alive : 0;
+}
+
+/**
+ * @brief Control loop of the elastic mode: grow the pool while the scan is healthy and the workers are not
+ * CPU bound, shrink it as soon as probes get lost or the TX/RX paths overflow.
+ * @param options {const NMAP_Options*} - Global options (min/max number of workers, stats).
+ * @param pool {NMAP_WorkerPool*} - Shared work.
+ * @param workers {Array<NMAP_WorkerData>} - maxSpeedup worker slots, minSpeedup of them already running.
+ */
+static void NMAP_elasticControl(const NMAP_Options* options, NMAP_WorkerPool* pool, Array* workers) {
+  ElasticSample last = elastic_sample(pool);
+  uint64_t active = options->minSpeedup;
+  uint64_t peak = active, grown = 0, shrunk = 0;
+
+  uint64_t chunksLeft;
+  while ((chunksLeft = pool_chunksLeft(pool)) && atomic_load(&pool->error) == false) {
+    usleep(ELASTIC_TICK_US);
+    const ElasticSample now = elastic_sample(pool);
+    const uint64_t sent = now.probesSent - last.probesSent;
+    const double lossRate = sent ? (double)(now.losses - last.losses) / sent : 0;
+    const bool overflow = now.sendErrors != last.sendErrors || now.captureDrops != last.captureDrops;
+    const double cpu = elastic_cpuUtilisation(workers, now.wallNs - last.wallNs);
+    last = now;
+
+    active = 0;
+    for (uint64_t i = 0; i < array_size(workers); ++i) {
+      NMAP_WorkerData* const worker = array_get(workers, i);
+      if (worker->running && atomic_load(&worker->finished))
+        NMAP_joinWorker(worker);
+      active += worker->running && atomic_load(&worker->retire) == false;
+    }
+    if ((overflow || lossRate > ELASTIC_MAX_LOSS || cpu > ELASTIC_MAX_CPU) && active > options->minSpeedup) {
+      for (int64_t i = array_size(workers) - 1; i >= 0; --i) {
+        NMAP_WorkerData* const worker = array_get(workers, i);
+        if (worker->running && atomic_load(&worker->retire) == false) {
+          atomic_store(&worker->retire, true);
+          ++shrunk;
+          break;
+        }
+      }
+    }
+    else if (overflow == false && lossRate <= ELASTIC_MAX_LOSS / 2 && cpu <= ELASTIC_MAX_CPU &&
+             active < options->maxSpeedup && active < chunksLeft) {
+      for (uint64_t i = 0; i < array_size(workers); ++i) {
+        NMAP_WorkerData* const worker = array_get(workers, i);
+        if (worker->running == false) {
+          if (NMAP_spawnWorker(worker, pool) == 0 && ++grown && ++active > peak)
+            peak = active;
+          break;
+        }
+      }
+    }
+  }
+  if (options->stats)
+    fprintf(stderr, "elastic pool: %u-%u workers, peak %lu, grown %lu times, shrunk %lu times\n",
+            options->minSpeedup, options->maxSpeedup, peak, grown, shrunk);
 }
 
 int NMAP_spawnWorkers(const NMAP_Options* options) {
   const size_t nPorts = array_size(options->ports);
-  const uint16_t nThreads = options->speedup <= nPorts ? options->speedup : nPorts;
+  const bool elastic = options->maxSpeedup != 0;
+  const uint16_t maxThreads = elastic ? options->maxSpeedup : options->speedup;
+  const uint16_t nThreads = elastic ? options->minSpeedup : options->speedup <= nPorts ? options->speedup : nPorts;
+  // In elastic mode the ports are cut in more chunks than workers so that the pool can be resized between chunks
+  const size_t wantedChunks = elastic ? (size_t)maxThreads * ELASTIC_CHUNKS_PER_WORKER : nThreads;
+  const size_t nChunks = wantedChunks <= nPorts ? wantedChunks : nPorts;
+  static NMAP_Engine engine;
+  static NMAP_WorkerPool pool;
+  on_exit(destroyEngine, &engine);
+  if (engine_init(&engine, options))
+    return NMAP_FAILURE;
+  pool.engine = &engine;
+  pool.options = options;
+  pool.groupSize = options->minHostgroup;
+  permutation_init(&pool.portOrder, nPorts, options->randomize, options->seed);
   WorkerSetupParam setup = {
-    .minPortsPerWorker = nPorts / nThreads,
+    .minPortsPerWorker = nPorts / nChunks,
     .scan = options->scan,
-    .remainder = nPorts % nThreads,
+    .remainder = nPorts % nChunks,
     .portsLeft = nPorts,
-    .ips = options->ips,
     .ports = options->ports,
+    .order = &pool.portOrder,
+    .randomize = options->randomize,
+    .seed = options->seed,
+    .engine = &engine,
   };
-  ArrayFactory workersFactory = {
-    .destructor = workerDataDestructor,
-  };
-  Array* const workers = array(sizeof(NMAP_WorkerData), 0, nThreads, NULL, &workersFactory);
-  if (workers == NULL) {
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.discovered, NULL);
+  pool.chunks = array(sizeof(NMAP_WorkerOptions), 0, nChunks, NULL, &(ArrayFactory){.destructor = chunkDestructor});
+  pool.groups = array(sizeof(NMAP_HostGroup*), 0, 0, NULL, &(ArrayFactory){.destructor = groupsDestructor});
+  on_exit(destroyPool, &pool);
+  pool.byPort = resultFile_sortPorts(options->ports);
+  if (pool.byPort == NULL) {
     perror("malloc");
     return NMAP_FAILURE;
   }
-  on_exit(destroyWorkers, workers);
-  if (array_forEach(workers, ArrayFn_setupWorkerOptions, &setup) ||
-      array_forEach(workers, ArrayFn_spawnWorkerThread, NULL))
+  if (output_init(&pool.output, options->outputPath, options->outputFormat, scan_protocol(options->scan)) ||
+      output_start(&pool.output))
     return NMAP_FAILURE;
-
-  bool threadError = false;
-
-  array_forEach(workers, ArrayFn_joinWorkerThread, &threadError);
-  // all_result == Array<Array<t_host>>
-  Array* all_result = array(sizeof(Array*), 0, 0, NULL, NULL);
-  if (all_result == NULL)
+  if (options->baselinePath && baseline_open(&pool.baseline, options->baselinePath, options->ports))
+    return NMAP_FAILURE;
+  if (options->discovery && discovery_init(&pool.discovery, &engine, options->discovery))
+    return NMAP_FAILURE;
+  if (options->resultPath && resultWriter_open(&pool.archive, options->resultPath, options->ports, options->scan))
+    return NMAP_FAILURE;
+  if (options->checkpointPath && (checkpoint_open(&pool.checkpoint, options, pool_replayGroup, &pool) ||
+                                  checkpoint_start(&pool.checkpoint)))
+    return NMAP_FAILURE;
+  Array* const workers = array(sizeof(NMAP_WorkerData), 0, maxThreads, NULL, NULL);
+  if (pool.chunks == NULL || pool.groups == NULL || workers == NULL) {
+    perror("malloc");
     return NMAP_FAILURE;
-  for (uint64_t i = 0; i < array_size(workers); ++i) {
-    const NMAP_WorkerData* data = array_get(workers, i);
-    array_pushBack(all_result, &data->result, 1);
   }
-  Array* final_result = merge_final_result(all_result);
-  if (final_result == NULL)
+  on_exit(destroyWorkers, workers);
+  if (array_forEach(pool.chunks, ArrayFn_setupWorkerOptions, &setup))
     return NMAP_FAILURE;
-  for (uint64_t i = 0; i < array_size(final_result); ++i) {
-    t_host* host = array_get(final_result, i);
-    printf("host(%s), %ld port have been analyzed\n", inet_ntoa(host->ip), array_size(host->ports));
-    for (uint64_t x = 0; x < array_size(host->ports); ++x) {
-      const t_port* port = array_get(host->ports, x);
-      if (port->result != NMAP_OPEN)
-        continue;
-      const struct servent* serv = getservbyport(htons(port->port), NULL);
-      if (serv)
-        printf("\t%u/%s %s %s\n", port->port, serv->s_proto, port_status_to_string(port->result), serv->s_name);
+  for (uint16_t i = 0; i < nThreads; ++i) {
+    if (NMAP_spawnWorker(array_get(workers, i), &pool)) {
+      array_forEach(workers, ArrayFn_cancelWorkerThread, NULL);
+      return NMAP_FAILURE;
     }
   }
-  array_destroy(final_result);
-  array_destroy(all_result);
+  if (elastic)
+    NMAP_elasticControl(options, &pool, workers);
+  array_forEach(workers, ArrayFn_joinWorkerThread, NULL);
+
+  const bool threadError = atomic_load(&pool.error);
   if (threadError)
+    fputs("ft_nmap: an error occured in a worker thread\n", stderr);
+  // Groups left open by a failure are reported with their unscanned ports unknown
+  pool_flushGroups(&pool, true);
+  const bool outputError = output_stop(&pool.output);
+  const bool archiveError = options->resultPath && resultWriter_close(&pool.archive);
+  const uint64_t checkpointed = pool.checkpoint.records;
+  const uint64_t resumed = pool.checkpoint.resumed;
+  const bool checkpointError = checkpoint_close(&pool.checkpoint);
+  if (options->stats) {
+    engine_printStats(&engine, stderr);
+    if (options->randomize)
+      fprintf(stderr, "random order: seed %lu\n", options->seed);
+    fprintf(stderr, "host groups: %lu opened, size %u-%u, peak %u, %lu targets\n", pool.groupsOpened,
+            options->minHostgroup, options->maxHostgroup, pool.peakGroupSize, options->targets->generated);
+    if (options->targets->resolver->lookups)
+      resolver_printStats(options->targets->resolver, stderr);
+    if (options->discovery)
+      discovery_printStats(&pool.discovery, stderr);
+    if (options->checkpointPath)
+      fprintf(stderr, "checkpoint: %lu targets resumed, %lu host groups saved\n", resumed, checkpointed);
+  }
+  if (threadError || outputError || archiveError || checkpointError)
     return NMAP_FAILURE;
   return NMAP_SUCCESS;
 }
@@ -0,0 +1,42 @@
+//
+// Created by loumouli on 5/1/24.
+//
+
+// Builds the capture filter of the discovery from the filter of the engine, with and without UDP scanned: the UDP
+// filter of the engine is the longest one, the discovery filter has to hold all of it.
+
+#include "ft_nmap.h"
+
+/**
+ * @brief build the filters of an engine on the longest interface address, and compare the discovery one.
+ * @param udpSock {int32_t} - UDP socket of the engine, -1 when UDP is not scanned.
+ * @param expected {const char*} - Expected discovery filter.
+ * @return {int} - 0 if the filter is the expected one, 1 otherwise.
+ */
+static int test_filter(const int32_t udpSock, const char* expected) {
+  NMAP_Engine engine = {.udpSock = udpSock};
+  int error = 0;
+
+  inet_pton(AF_INET, "255.255.255.255", &engine.inter_ip);
+  engine.filter = engine_buildFilter(&engine);
+  if (engine.filter == NULL)
+    return 1;
+  char* filter = discovery_buildFilter(&engine);
+  if (filter == NULL || strcmp(filter, expected)) {
+    fprintf(stderr, "FAIL: discovery filter \"%s\"\n  expected \"%s\"\n", filter ? filter : "(null)", expected);
+    error = 1;
+  }
+  free(filter);
+  free(engine.filter);
+  return error;
+}
+
+int main(void) {
+  int error = 0;
+
+  error |= test_filter(-1, "(dst host 255.255.255.255 and (icmp or tcp)) or (arp and arp[6:2] = 2)");
+  error |= test_filter(0, "(dst host 255.255.255.255 and (icmp or tcp or (udp and dst port 49152))) "
+                          "or (arp and arp[6:2] = 2)");
+  printf("discovery filter: %s\n", error ? "failed" : "ok");
+  return error;
+}
@@ -0,0 +1,99 @@
+//
+// Created by loumouli on 5/1/24.
+//
+
+// Resolves the hostnames of the targets through a stub resolver answering after a delay: the lookups have to overlap,
+// a hostname listed again has to be looked up once, and the addresses have to come out in the order of the targets.
+
+#include "ft_nmap.h"
+
+#define TEST_HOSTS 64
+#define TEST_REPEATS 3
+#define TEST_THREADS 16
+#define TEST_DELAY_US 20'000
+
+static _Atomic uint32_t calls;
+static _Atomic uint32_t inFlight;
+static _Atomic uint32_t peak;
+
+/**
+ * @brief stub of getaddrinfo: "host<N>.test" is 10.0.0.<N>, after TEST_DELAY_US.
+ * @param name {const char*} - Hostname.
+ * @return {in_addr_t} - Its address, INADDR_NONE for any other name.
+ */
+static in_addr_t stub_resolve(const char* name) {
+  const uint32_t current = atomic_fetch_add(&inFlight, 1) + 1;
+  uint32_t previous = atomic_load(&peak);
+  uint32_t host;
+  char end;
+
+  atomic_fetch_add(&calls, 1);
+  while (current > previous && atomic_compare_exchange_weak(&peak, &previous, current) == false)
+    ;
+  usleep(TEST_DELAY_US);
+  atomic_fetch_sub(&inFlight, 1);
+  if (sscanf(name, "host%u.tes%c", &host, &end) != 2 || end != 't' || host > UINT8_MAX)
+    return INADDR_NONE;
+  return htonl(0x0A000000 | host);
+}
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(void) {
+  NMAP_Targets* targets = targets_create();
+  in_addr_t ips[TEST_HOSTS * TEST_REPEATS + 1];
+  uint32_t order[TEST_HOSTS];
+  char name[32];
+  int error = 0;
+
+  if (targets == NULL)
+    return 1;
+  // The hosts are listed in a scrambled order, every round lists all of them again
+  for (uint32_t i = 0; i < TEST_HOSTS; ++i)
+    order[i] = i * 37 % TEST_HOSTS;
+  for (uint32_t round = 0; round < TEST_REPEATS; ++round) {
+    for (uint32_t i = 0; i < TEST_HOSTS; ++i) {
+      snprintf(name, sizeof(name), "host%u.test", order[i]);
+      if (targets_addSpec(targets, name))
+        return 1;
+    }
+  }
+  targets_setResolver(targets, stub_resolve, TEST_THREADS);
+
+  const double start = now();
+  const uint64_t count = targets_next(targets, ips, COUNTOF(ips));
+  const double elapsed = now() - start;
+
+  if (count != TEST_HOSTS) {
+    fprintf(stderr, "FAIL: %lu addresses generated, %u expected\n", count, TEST_HOSTS);
+    error = 1;
+  }
+  for (uint64_t i = 0; i < count && i < TEST_HOSTS; ++i) {
+    if (ips[i] != htonl(0x0A000000 | order[i])) {
+      fprintf(stderr, "FAIL: address %lu is %s, not host%u.test\n", i, inet_ntoa((struct in_addr){ips[i]}), order[i]);
+      error = 1;
+      break;
+    }
+  }
+  if (atomic_load(&calls) != TEST_HOSTS || targets->resolver->lookups != TEST_HOSTS) {
+    fprintf(stderr, "FAIL: %u calls to the resolver for %u hostnames\n", atomic_load(&calls), TEST_HOSTS);
+    error = 1;
+  }
+  if (targets->resolver->hits != TEST_HOSTS * (TEST_REPEATS - 1)) {
+    fprintf(stderr, "FAIL: %lu cache hits, %u expected\n", targets->resolver->hits, TEST_HOSTS * (TEST_REPEATS - 1));
+    error = 1;
+  }
+  // The lookups running at once measure the parallelism, a wall-clock bound would depend on the load of the machine
+  if (atomic_load(&peak) < 2) {
+    fprintf(stderr, "FAIL: %u lookup at most in flight for %u hostnames\n", atomic_load(&peak), TEST_HOSTS);
+    error = 1;
+  }
+  printf("resolver: %u hostnames, %u lookups at most in flight, %.0f ms\n", TEST_HOSTS, atomic_load(&peak),
+         elapsed * 1e3);
+  targets_destroy(targets);
+  return error;
+}
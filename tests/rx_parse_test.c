@@ -0,0 +1,123 @@
+//
+// Created by loumouli on 5/1/24.
+//
+
+// Parses ICMP errors sent by a router on the way to a target: the reply is about the target the quoted probe was
+// sent to, and an error quoting a packet that is not a probe (another source port) is not a reply. Neither is a TCP
+// segment of the target to another port than the one of the probes.
+
+#include "ft_nmap.h"
+
+#define TEST_ROUTER "10.0.0.1"
+#define TEST_TARGET "192.0.2.7"
+
+typedef struct {
+  struct ether_header ether;
+  struct iphdr ip;
+  struct icmphdr icmp;
+  struct iphdr quotedIp;
+  uint8_t quoted[8];
+} __attribute__((packed)) TEST_IcmpError;
+
+/**
+ * @brief parse an ICMP error of the router quoting a probe to the target.
+ * @param scanType {NMAP_ScanType} - Scan type of the probe.
+ * @param code {uint8_t} - Code of the destination unreachable error.
+ * @param source {uint16_t} - Source port of the quoted probe.
+ * @param port {uint16_t} - Destination port of the quoted probe.
+ * @param reply {NMAP_Reply*} - Parsed reply.
+ * @return {bool} - The result of rx_parse.
+ */
+static bool test_parseError(const NMAP_ScanType scanType, const uint8_t code, const uint16_t source,
+                            const uint16_t port, NMAP_Reply* reply) {
+  TEST_IcmpError packet = {0};
+  const struct pcap_pkthdr head = {.caplen = sizeof(packet), .len = sizeof(packet)};
+  const uint16_t ports[2] = {htons(source), htons(port)};
+
+  packet.ip = (struct iphdr){.ihl = 5, .version = 4, .protocol = IPPROTO_ICMP};
+  inet_pton(AF_INET, TEST_ROUTER, &packet.ip.saddr);
+  packet.icmp = (struct icmphdr){.type = ICMP_DEST_UNREACH, .code = code};
+  packet.quotedIp = (struct iphdr){.ihl = 5, .version = 4};
+  packet.quotedIp.protocol = scanType == NMAP_SCAN_UDP ? IPPROTO_UDP : IPPROTO_TCP;
+  inet_pton(AF_INET, TEST_TARGET, &packet.quotedIp.daddr);
+  // UDP and TCP headers both start with the source and destination ports
+  memcpy(packet.quoted, ports, sizeof(ports));
+  return rx_parse(scanType, &head, (const uint8_t*)&packet, reply);
+}
+
+/**
+ * @brief parse a RST of the target.
+ * @param dest {uint16_t} - Destination port of the RST.
+ * @param port {uint16_t} - Source port of the RST, the port of the target.
+ * @param reply {NMAP_Reply*} - Parsed reply.
+ * @return {bool} - The result of rx_parse on a SYN scan.
+ */
+static bool test_parseRst(const uint16_t dest, const uint16_t port, NMAP_Reply* reply) {
+  struct {
+    struct ether_header ether;
+    struct iphdr ip;
+    struct tcphdr tcp;
+  } __attribute__((packed)) packet = {0};
+  const struct pcap_pkthdr head = {.caplen = sizeof(packet), .len = sizeof(packet)};
+
+  packet.ip = (struct iphdr){.ihl = 5, .version = 4, .protocol = IPPROTO_TCP};
+  inet_pton(AF_INET, TEST_TARGET, &packet.ip.saddr);
+  packet.tcp = (struct tcphdr){.source = htons(port), .dest = htons(dest), .doff = 5, .rst = 1, .ack = 1};
+  return rx_parse(NMAP_SCAN_SYN, &head, (const uint8_t*)&packet, reply);
+}
+
+/**
+ * @brief check a parsed reply is about a port of the target.
+ * @param name {const char*} - Name of the case.
+ * @param parsed {bool} - Result of rx_parse.
+ * @param reply {const NMAP_Reply*} - Parsed reply.
+ * @param port {uint16_t} - Expected port.
+ * @param result {NMAP_PortStatus} - Expected status.
+ * @return {int} - 0 if the reply is the expected one, 1 otherwise.
+ */
+static int test_expect(const char* name, const bool parsed, const NMAP_Reply* reply, const uint16_t port,
+                       const NMAP_PortStatus result) {
+  struct in_addr target;
+
+  inet_pton(AF_INET, TEST_TARGET, &target);
+  if (parsed == false) {
+    fprintf(stderr, "FAIL: %s: not parsed as a reply\n", name);
+    return 1;
+  }
+  if (reply->ip.s_addr != target.s_addr || reply->port != port || reply->result != result) {
+    fprintf(stderr, "FAIL: %s: reply about %s:%u (%d), %s:%u (%d) expected\n", name, inet_ntoa(reply->ip),
+            reply->port, reply->result, TEST_TARGET, port, result);
+    return 1;
+  }
+  return 0;
+}
+
+int main(void) {
+  NMAP_Reply reply;
+  int error = 0;
+
+  error |= test_expect("udp, admin prohibited",
+                       test_parseError(NMAP_SCAN_UDP, ICMP_PKT_FILTERED, UDP_SOURCE_PORT, 53, &reply), &reply, 53,
+                       NMAP_FILTERED);
+  error |= test_expect("udp, host unreachable",
+                       test_parseError(NMAP_SCAN_UDP, ICMP_HOST_UNREACH, UDP_SOURCE_PORT, 161, &reply), &reply, 161,
+                       NMAP_FILTERED);
+  error |= test_expect("syn, admin prohibited",
+                       test_parseError(NMAP_SCAN_SYN, ICMP_PKT_FILTERED, TCP_SOURCE_PORT, 80, &reply), &reply, 80,
+                       NMAP_FILTERED);
+  if (test_parseError(NMAP_SCAN_UDP, ICMP_PKT_FILTERED, 5353, 53, &reply)) {
+    fprintf(stderr, "FAIL: udp: error about local traffic parsed as a reply\n");
+    error = 1;
+  }
+  if (test_parseError(NMAP_SCAN_SYN, ICMP_PKT_FILTERED, 40000, 80, &reply)) {
+    fprintf(stderr, "FAIL: syn: error about local traffic parsed as a reply\n");
+    error = 1;
+  }
+  error |= test_expect("syn, rst", test_parseRst(TCP_SOURCE_PORT, 22, &reply), &reply, 22, NMAP_CLOSE);
+  if (test_parseRst(40000, 22, &reply)) {
+    fprintf(stderr, "FAIL: syn: RST of a local connection parsed as a reply\n");
+    error = 1;
+  }
+  printf("rx parse: %s\n", error ? "failed" : "ok");
+  return error;
+}
@@ -0,0 +1,124 @@
+//
+// Created by loumouli on 5/1/24.
+//
+
+// Runs the TX loop of ultra_scan on a UDP scan no port answers: every probe times out. The timeouts have to give the
+// places of their probes in the congestion window back, or the host can never send again and the scan never ends,
+// and the silence must not shrink the window: every port ends open|filtered after udpMaxRetries probes.
+
+#include "ft_nmap.h"
+
+#define TEST_PORTS 64
+#define TEST_TIMEOUT_US 2'000
+#define TEST_DEADLINE_S 5
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief scan like us_run, without the RX stage: nothing ever answers.
+ * @param us {NMAP_UltraScan*} - UltraScan structure of the scan.
+ * @return {int64_t} - 0 if the scan ended, 1 on error or when it is still running after TEST_DEADLINE_S.
+ */
+static int64_t test_run(NMAP_UltraScan* us) {
+  const double deadline = now() + TEST_DEADLINE_S;
+  t_host* host = array_get(us->hosts, 0);
+
+  while (host->done == false) {
+    if (now() > deadline) {
+      fprintf(stderr, "FAIL: scan still running after %ds, %u probes in flight, %u ports in the slab\n",
+              TEST_DEADLINE_S, atomic_load(&host->timing->inFlight), host->inSlab);
+      return 1;
+    }
+    if (doAnyOustandingRetransmit(us) || doAnyNewProbe(us))
+      return 1;
+    usleep(US_IDLE_US);
+    if (host_hasPortLeft(host) == false)
+      host->done = true;
+  }
+  return 0;
+}
+
+int main(void) {
+  static NMAP_Engine engine;
+  const in_addr_t localhost = htonl(INADDR_LOOPBACK);
+  Array* ips = array(sizeof(in_addr_t), 0, 0, NULL, NULL);
+  Array* ports = array(sizeof(uint16_t), 0, 0, NULL, NULL);
+  NMAP_Permutation portOrder;
+  int error = 0;
+
+  engine.hostTable = hostTable_create();
+  engine.udpSock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (ips == NULL || ports == NULL || engine.hostTable == NULL || engine.udpSock < 0)
+    return 1;
+  credits_init(&engine.credits, 0);
+  gettimeofday(&engine.start, NULL);
+  array_pushBack(ips, &localhost, 1);
+  for (uint16_t i = 0; i < TEST_PORTS; ++i)
+    array_pushBack(ports, (uint16_t[]){40'000 + i}, 1);
+  permutation_init(&portOrder, TEST_PORTS, false, 0);
+
+  Array* timings = hostTable_createTimings(ips);
+  Array* store = timings ? host_createArray(ips, timings, TEST_PORTS, false) : NULL;
+  if (store == NULL)
+    return 1;
+  const NMAP_WorkerOptions options = {
+    .scan = NMAP_SCAN_UDP, .hosts = store, .ports = ports, .portOrder = &portOrder, .engine = &engine};
+  NMAP_UltraScan us = {.engine = &engine,
+                       .udpSock = engine.udpSock,
+                       .hostTable = engine.hostTable,
+                       .credits = &engine.credits,
+                       .signals = &engine.signals,
+                       .scanType = NMAP_SCAN_UDP};
+  us_default_init(&us);
+  if (us_createHost(&us, &options))
+    return 1;
+  NMAP_HostTiming* timing = array_get(timings, 0);
+  atomic_store(&timing->timeout, TEST_TIMEOUT_US);
+
+  const double start = now();
+  if (test_run(&us))
+    error = 1;
+  const double elapsed = now() - start;
+
+  if (atomic_load(&timing->inFlight) || atomic_load(&engine.credits.inFlight) || us.slab.used) {
+    fprintf(stderr, "FAIL: %u probes in flight for the host, %u credits taken, %u slots used after the scan\n",
+            atomic_load(&timing->inFlight), atomic_load(&engine.credits.inFlight), us.slab.used);
+    error = 1;
+  }
+  if (atomic_load(&timing->cwnd) != HOST_INITIAL_CWND) {
+    fprintf(stderr, "FAIL: congestion window of %.1f, %.1f expected\n", atomic_load(&timing->cwnd),
+            HOST_INITIAL_CWND);
+    error = 1;
+  }
+  const t_host* host = array_cGet(store, 0);
+  for (uint32_t i = 0; i < TEST_PORTS && error == 0; ++i) {
+    if (portMap_get(&host->results, i) != NMAP_OPEN_FILTERED) {
+      fprintf(stderr, "FAIL: port %u is %d, not open|filtered\n", 40'000 + i, portMap_get(&host->results, i));
+      error = 1;
+    }
+  }
+  // The retries to silent ports are no sign of load for the pool controllers
+  if (atomic_load(&engine.signals.losses)) {
+    fprintf(stderr, "FAIL: %lu probes lost for %lu retransmits\n", atomic_load(&engine.signals.losses),
+            atomic_load(&engine.signals.retransmits));
+    error = 1;
+  }
+  if (error == 0 && us.packet_sent != TEST_PORTS * us.udpMaxRetries) {
+    fprintf(stderr, "FAIL: %lu probes sent, %lu expected\n", us.packet_sent, TEST_PORTS * us.udpMaxRetries);
+    error = 1;
+  }
+  printf("udp silence: %u ports, %lu probes, %.0f ms\n", TEST_PORTS, us.packet_sent, elapsed * 1e3);
+  probeSlab_destroy(&us.slab);
+  array_destroy(us.hosts);
+  host_destroyArray(store);
+  array_destroy(timings);
+  array_destroy(ports);
+  array_destroy(ips);
+  hostTable_destroy(engine.hostTable);
+  close(engine.udpSock);
+  return error;
+}